@@ -6,7 +6,28 @@
 #include <map>
 #include <unordered_map>
 #include <functional>
+#include <cstdint>
 #include "log_entry.h"
+#include "time_utils.h"
+#include "json_parser.h"
+#include "log_index.h"
+#include "ngram_index.h"
+#include "path_trie.h"
+#include "cidr_tree.h"
+#include "query.h"
+#include "columns.h"
+#include "rate_detector.h"
+#include "group_by.h"
+#include "rollup_cube.h"
+#include "sessionizer.h"
+#include "error_rate_detector.h"
+#include "result_cache.h"
+#include "sampler.h"
+#include "partial_aggregate.h"
+#include "csv_writer.h"
+#include "json_writer.h"
+#include "arrow_writer.h"
+#include "source_export.h"
 
 // Класс для анализа логов веб-сервера
 
@@ -14,19 +35,6 @@ class LogAnalyzer {
 private:
     std::vector<LogEntry> logs;
 
-    // Оптимизированная хэш-функция для Windows
-    struct WindowsStringHash {
-        size_t operator()(const std::string& s) const {
-            // FNV-1a hash - эффективная для Windows
-            size_t hash = 2166136261U;
-            for (char c : s) {
-                hash ^= static_cast<unsigned char>(c);
-                hash *= 16777619U;
-            }
-            return hash;
-        }
-    };
-
     // Использование оптимизированной хэш-таблицы
     using FastHashMap = std::unordered_map<std::string, int, WindowsStringHash>;
 
@@ -34,10 +42,33 @@ public:
     // Конструкторы
     LogAnalyzer() = default;
     explicit LogAnalyzer(const std::vector<LogEntry>& logEntries);
+    explicit LogAnalyzer(std::vector<LogEntry>&& logEntries);
 
     // Загрузка данных
     bool loadFromJson(const JsonValue& json);
-    bool loadFromFile(const std::string& filename);
+    // keepSourceSpans - запомнить положение каждой записи в файле для
+    // экспорта выборок исходными байтами (exportOriginal)
+    bool loadFromFile(const std::string& filename, bool keepSourceSpans = false);
+
+    // Положения записей в исходном файле (spans[i] - запись i), например
+    // из JsonParser::loadLogEntries; сбрасываются при загрузке других данных
+    void attachSourceSpans(const std::string& filename, std::vector<RecordSpan> spans);
+    bool hasSourceSpans() const { return !sourceSpans.empty(); }
+
+    // Несколько файлов: директория (все *.json), маска ("logs\\web-*.json")
+    // или список. Файлы читаются параллельно и сливаются по времени
+    // (см. log_loader.h); записи прочитанных файлов загружаются, даже если
+    // часть файлов не прочиталась - тогда результат false
+    bool loadFromFiles(const std::string& pathOrPattern, unsigned threads = 0);
+    bool loadFromFiles(const std::vector<std::string>& files, unsigned threads = 0);
+
+    // Двоичный снимок (см. snapshot_file.h): загрузка без разбора JSON;
+    // вместе с записями сохраняется куб счётчиков. Записи копируются из
+    // снимка в память анализатора, индексы (кроме времени и куба) строятся
+    // заново, поэтому время загрузки растёт с числом записей. verify -
+    // проверка контрольных сумм при открытии
+    bool saveSnapshot(const std::string& filename, bool withRollup = true) const;
+    bool loadSnapshot(const std::string& filename, bool verify = true);
 
     // Основные операции анализа
     std::vector<std::pair<std::string, int>> getTopIPs(int n = 10);
@@ -51,13 +82,101 @@ public:
     std::vector<LogEntry> filterByIP(const std::string& ip) const;
     std::vector<LogEntry> filterByURL(const std::string& urlPattern) const;
 
-    // Комбинированные фильтры
-    std::vector<LogEntry> filter(const std::function<bool(const LogEntry&)>& predicate) const;
+    // Триграммный индекс уникальных URL: строится при первом поиске
+    // подстроки и используется filterByURL и составными запросами
+    const NGramIndex& getURLNGramIndex() const;
+
+    // Записи, путь URL которых лежит под префиксом ("/api/v1" включает
+    // "/api/v1/users?id=1", но не "/api/v10"); число запросов и классов
+    // статусов по префиксу - getPathTrie().prefixCounts(prefix)
+    std::vector<LogEntry> filterByURLPrefix(const std::string& prefix) const;
+    const PathTrie& getPathTrie() const { ensureIndexesBuilt(); return pathTrie; }
+
+    // Подсети: "192.168.1.0/24", "2001:db8::/32" (некорректная запись - пустой результат).
+    // Адреса хранятся целыми числами в префиксном дереве.
+    std::vector<LogEntry> filterByCIDR(const std::string& cidr) const;
+    std::vector<std::pair<std::string, int>> getTopSubnets(int ipv4Prefix = 24, int n = 10,
+        int ipv6Prefix = 64) const;
+    const SubnetIndex& getSubnetIndex() const { ensureIndexesBuilt(); return subnetIndex; }
+
+    // Именованные диапазоны адресов (облака, провайдеры): строка файла "CIDR имя",
+    // адрес относится к диапазону с самым длинным префиксом
+    bool addNamedRange(const std::string& cidr, const std::string& name);
+    size_t loadNamedRanges(const std::string& filename);
+    std::string findNamedRange(const std::string& ip) const;  // "" - вне диапазонов
+    std::vector<std::pair<std::string, int>> getTopNamedRanges(int n = 10) const;
+
+    // Комбинированные фильтры (лямбда или std::function; вызов встраивается в цикл)
+    template<typename Predicate>
+    std::vector<LogEntry> filter(Predicate&& predicate) const;
+
+    // Условия-выражения из predicate.h, проверяемые поблочно по колонкам:
+    // analyzer.where(Status() >= 500 && Method() == "POST")
+    template<typename Expr>
+    Selection where(const Expr& expr) const;
+    template<typename Expr>
+    size_t count(const Expr& expr) const;
+
+    // Колонки статуса, метода и времени для вычисления выражений
+    ColumnView columnView() const;
+
+    // Битовые индексы по статусу и методу: условия вида
+    // "status >= 500 AND method = POST" считаются операциями над картами,
+    // а записи копируются только при необходимости
+    const BitmapIndex& getBitmapIndex() const { ensureIndexesBuilt(); return bitmapIndex; }
+    std::vector<LogEntry> filterByBitmap(const RoaringBitmap& rows) const;
+
+    // Составные запросы: все условия выполняются одним планом за один проход,
+    // результат - выборка номеров записей без копирования самих записей
+    Selection select(const LogQuery& query) const;
+    Selection selectAll() const;
+    QueryPlan planQuery(const LogQuery& query) const;
+
+    // Агрегаты по выборке
+    std::vector<std::pair<std::string, int>> getTopIPs(const Selection& rows, int n = 10) const;
+    std::vector<std::pair<std::string, int>> getTopURLs(const Selection& rows, int n = 10) const;
+    std::map<int, int> getStatusDistribution(const Selection& rows) const;
+    std::map<std::string, int> getMethodDistribution(const Selection& rows) const;
+
+    // Куб счётчиков минута/час/сутки x класс статуса x метод:
+    // запросы за интервал времени без прохода по записям
+    const RollupCube& getRollup() const { ensureIndexesBuilt(); return rollup; }
+    // Границы - как у findTimeSpan; не время - нулевые счётчики
+    RollupCube::Counts getRollupCounts(const std::string& startTime,
+        const std::string& endTime) const;
+
+    // Частичные агрегаты для анализа по частям (см. partial_aggregate.h):
+    // точные счётчики, куб и сводки топов из sketchSize значений
+    PartialAggregate getPartialAggregate(size_t sketchSize = 1024) const;
+
+    // Приблизительные ответы по выборке записей (см. sampler.h) с
+    // доверительным интервалом; QueryMode::Exact - по всем записям.
+    // Выборка строится при первом обращении и пополняется в addLog
+    void setSampling(size_t capacity, bool stratified = false, double confidence = 0.95);
+    const LogSampler& getSampler() const;
+    template<typename Predicate>
+    Estimate estimateCount(Predicate&& predicate, QueryMode mode = QueryMode::Sampled) const;
+    std::vector<std::pair<std::string, Estimate>> estimateTopIPs(int n = 10,
+        QueryMode mode = QueryMode::Sampled) const;
+    std::vector<std::pair<std::string, Estimate>> estimateTopURLs(int n = 10,
+        QueryMode mode = QueryMode::Sampled) const;
+    std::map<int, Estimate> estimateStatusDistribution(QueryMode mode = QueryMode::Sampled) const;
+
+    // Группировка по ключам с агрегатами (см. group_by.h): все записи или выборка
+    GroupTable groupBy(const GroupBy& query) const;
+    GroupTable groupBy(const GroupBy& query, const Selection& rows) const;
 
     // Статистика
     int getTotalRequests() const { return static_cast<int>(logs.size()); }
     std::pair<std::string, std::string> getTimeRange() const;
 
+    // Диапазон позиций в упорядоченном по времени индексе. Границы
+    // включительно; неполная граница ("2025-03-14") - весь её период,
+    // пустая - без ограничения, не время - пустой диапазон
+    TimeIndex::Span findTimeSpan(const std::string& startTime,
+        const std::string& endTime) const;
+    const TimeIndex& getTimeIndex() const { ensureIndexesBuilt(); return timeIndex; }
+
     std::map<int, int> getStatusDistribution() const;
     std::map<std::string, int> getMethodDistribution() const;
 
@@ -78,12 +197,43 @@ public:
     // Анализ аномалий
     std::vector<LogEntry> findFailedRequests(int threshold = 400) const; // статус >= threshold
     std::vector<std::string> findSuspiciousIPs(int threshold = 100) const; // IP с > threshold запросов
+    // IP, сделавшие больше maxRequests запросов за какие-либо windowSeconds секунд
+    std::vector<std::string> findSuspiciousIPs(int maxRequests, int windowSeconds) const;
+    // То же с наибольшим числом запросов в окне, по убыванию; memoryBudget -
+    // память под потоковое состояние по IP (см. rate_detector.h). При
+    // нехватке бюджета проверяются все IP: результат тот же, но медленнее
+    std::vector<std::pair<std::string, int>> findRequestBursts(int maxRequests,
+        int windowSeconds, size_t memoryBudget = RateDetector::DEFAULT_MEMORY) const;
     std::vector<LogEntry> findSlowPeriods(int windowSeconds = 60,
         int threshold = 1000) const; // периоды высокой нагрузки
+    // Интервалы, когда доля ошибок заметно выше обычной (см. error_rate_detector.h);
+    // topURLs > 0 - также отдельные ряды для самых частых URL
+    std::vector<AnomalyInterval> findErrorRateAnomalies(
+        const ErrorRateOptions& options = ErrorRateOptions(), int topURLs = 0) const;
+
+    // Сессии посещений: пауза дольше gapSeconds начинает новую сессию IP.
+    // Один проход по записям в порядке времени (см. sessionizer.h)
+    void forEachSession(int gapSeconds, const Sessionizer::Sink& sink) const;
+    std::vector<Session> getSessions(int gapSeconds = 1800) const;
+    SessionStats getSessionStats(int gapSeconds = 1800) const;
 
-    // Экспорт результатов
-    bool exportToCSV(const std::string& filename) const;
-    bool exportToJson(const std::string& filename) const;
+    // Экспорт результатов: CSV по RFC 4180 (см. csv_writer.h) - все записи или выборка
+    bool exportToCSV(const std::string& filename, const CsvOptions& options = CsvOptions()) const;
+    bool exportToCSV(const std::string& filename, const Selection& rows,
+        const CsvOptions& options = CsvOptions()) const;
+    // JSON потоково, без дерева JsonValue: массив или NDJSON (см. json_writer.h)
+    bool exportToJson(const std::string& filename,
+        const JsonExportOptions& options = JsonExportOptions()) const;
+    bool exportToJson(const std::string& filename, const Selection& rows,
+        const JsonExportOptions& options = JsonExportOptions()) const;
+    // Arrow IPC / Feather v2 (см. arrow_writer.h): время и статус - прямо
+    // из колонок индексов, строки кодируются словарями при записи
+    bool exportToArrow(const std::string& filename, const ArrowOptions& options = ArrowOptions()) const;
+    bool exportToArrow(const std::string& filename, const Selection& rows,
+        const ArrowOptions& options = ArrowOptions()) const;
+    // Выборка байтами исходного файла, без повторного форматирования
+    // (см. source_export.h); нужны положения записей (loadFromFile)
+    bool exportOriginal(const std::string& filename, const Selection& rows) const;
 
     // Windows-специфичные методы
     bool exportToExcel(const std::string& filename) const; // через CSV
@@ -91,13 +241,33 @@ public:
 
     // Доступ к данным
     const std::vector<LogEntry>& getLogs() const { return logs; }
-    void clear() { logs.clear(); }
-    void addLog(const LogEntry& entry) { logs.push_back(entry); }
+    const HashIndex& getIPIndex() const { ensureIndexesBuilt(); return ipIndex; }
+    const HashIndex& getURLIndex() const { ensureIndexesBuilt(); return urlIndex; }
+
+    // Построение всех индексов заранее (включая ленивые). После этого
+    // константные методы изменяют только кэш результатов (он под мьютексом),
+    // и пока записи не добавляются, их можно вызывать из нескольких потоков
+    // одновременно (см. LogStore)
+    void buildIndexes() const;
+    void clear() { logs.clear(); clearSourceSpans(); indexesBuilt = false; sampleBuilt = false; dataVersion++; }
+
+    // Кэш повторяемых запросов (распределения, статистика, подозрительные IP,
+    // топы подсетей): ключ - запрос с параметрами и версия данных, которая
+    // растёт при каждом изменении записей
+    const ResultCache& getResultCache() const { return resultCache; }
+    void setResultCacheBudget(size_t bytes) { resultCache.setBudget(bytes); }
+    uint64_t getDataVersion() const { return dataVersion; }
+
+    // Добавление записей: уже построенные индексы, счётчики и кэши топов
+    // дополняются за амортизированное O(1) на запись, без перестроения
+    void addLog(const LogEntry& entry);
+    void addLogs(const std::vector<LogEntry>& entries);
 
     // Вспомогательные методы
     static bool isInTimeRange(const std::string& timestamp,
         const std::string& start,
         const std::string& end);
+    // Копии частей URL; без выделения памяти - urlDomainView/urlPathView
     static std::string extractDomain(const std::string& url);
     static std::string extractPath(const std::string& url);
 
@@ -106,17 +276,129 @@ private:
     void buildIPIndex() const;
     void buildURLIndex() const;
     void buildTimeIndex() const;
+    void buildBitmapIndex() const;
+    void buildColumns() const;
+    void buildPathTrie() const;
+    void buildSubnetIndex() const;
+    void buildRollup() const;
+    void clearSourceSpans() { sourceSpans.clear(); sourceFile.clear(); }
 
-    // Кэши для производительности
-    mutable std::map<std::string, std::vector<size_t>> ipIndex;
-    mutable std::map<std::string, std::vector<size_t>> urlIndex;
-    mutable std::map<std::string, std::vector<size_t>> timeIndex;
+    // Кэши для производительности: значение -> сжатый список записей
+    mutable HashIndex ipIndex;
+    mutable HashIndex urlIndex;
+    mutable TimeIndex timeIndex;
+    mutable BitmapIndex bitmapIndex;
+    mutable LogColumns columns;
+    mutable PathTrie pathTrie;
+    mutable SubnetIndex subnetIndex;
+    mutable RollupCube rollup;
+    NamedRanges namedRanges;
+    std::vector<RecordSpan> sourceSpans;     // пусто - положения не известны
+    std::string sourceFile;
     mutable bool indexesBuilt = false;
+    mutable NGramIndex urlNGrams;
+    mutable bool urlNGramsBuilt = false;
+
+    // Кэши топ-N для getTopIPs/getTopURLs
+    mutable TopKCache topIPsCache;
+    mutable TopKCache topURLsCache;
+
+    // Выборка для приблизительных ответов
+    mutable LogSampler sampler;
+    mutable bool sampleBuilt = false;
+
+    // Результаты остальных запросов по версии данных
+    mutable ResultCache resultCache;
+    uint64_t dataVersion = 0;
+
+    // Сохранение вычисленного результата в кэш текущей версии
+    template<typename T>
+    T remember(const std::string& key, T result) const {
+        resultCache.store(key, dataVersion, result, resultBytes(result));
+        return result;
+    }
 
     void ensureIndexesBuilt() const;
+
+    // Завершение построения индексов: сброс зависящих от них кэшей
+    void finishIndexBuild() const;
+
+    // Колонки и словари для группировки
+    GroupSource groupSource() const;
+
+    // Дополнение всех индексов записью row (индексы уже построены)
+    void appendToIndexes(RowId row);
+
+    // Копирование записей по списку номеров (номера по возрастанию)
+    std::vector<LogEntry> collectRows(const std::vector<RowId>& rows) const;
+
+    // Выбор источника кандидатов; bitmap получает карту статуса/метода
+    QueryPlan makePlan(const LogQuery& query, RoaringBitmap& bitmap) const;
+    RoaringBitmap statusMethodBitmap(const LogQuery& query) const;
+
+    // Поблочный обход выражения: fn(номер записи) для каждой подходящей
+    template<typename Expr, typename Fn>
+    void scanExpression(const Expr& expr, Fn&& fn) const;
 };
 
-// Утилиты для работы со временем (Windows-совместимые)
+template<typename Predicate>
+Estimate LogAnalyzer::estimateCount(Predicate&& predicate, QueryMode mode) const {
+    if (mode == QueryMode::Exact) {
+        size_t matched = 0;
+        for (const auto& log : logs) {
+            if (predicate(log)) matched++;
+        }
+        return Estimate::exactly(static_cast<double>(matched));
+    }
+    return getSampler().estimateCount(logs, predicate);
+}
+
+template<typename Predicate>
+std::vector<LogEntry> LogAnalyzer::filter(Predicate&& predicate) const {
+    std::vector<LogEntry> result;
+
+    for (const auto& log : logs) {
+        if (predicate(log)) {
+            result.push_back(log);
+        }
+    }
+
+    return result;
+}
+
+template<typename Expr, typename Fn>
+void LogAnalyzer::scanExpression(const Expr& expr, Fn&& fn) const {
+    ColumnView view = columnView();
+    uint8_t mask[PREDICATE_BLOCK];
+
+    for (size_t begin = 0; begin < view.size; begin += PREDICATE_BLOCK) {
+        size_t n = view.size - begin < PREDICATE_BLOCK ? view.size - begin : PREDICATE_BLOCK;
+        expr.evalBlock(view, begin, n, mask);
+
+        for (size_t i = 0; i < n; i++) {
+            if (mask[i]) {
+                fn(static_cast<RowId>(begin + i));
+            }
+        }
+    }
+}
+
+template<typename Expr>
+Selection LogAnalyzer::where(const Expr& expr) const {
+    std::vector<RowId> rows;
+    scanExpression(expr, [&rows](RowId row) { rows.push_back(row); });
+    return Selection(logs, std::move(rows));
+}
+
+template<typename Expr>
+size_t LogAnalyzer::count(const Expr& expr) const {
+    size_t total = 0;
+    scanExpression(expr, [&total](RowId) { total++; });
+    return total;
+}
+
+// Утилиты для работы со временем (Windows-совместимые); преобразование
+// в секунды от 1970-01-01 - в time_utils.h
 namespace TimeUtils {
     // Парсинг ISO 8601 timestamp
     std::tm parseISOTimestamp(const std::string& timestamp);
@@ -0,0 +1,118 @@
+﻿#ifndef ARROW_WRITER_H
+#define ARROW_WRITER_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstddef>
+#include <cstdint>
+#include "log_entry.h"
+#include "log_index.h"
+
+class SnapshotFile;
+
+// Экспорт в формат Apache Arrow IPC (файл Feather v2) без библиотеки
+// Arrow: pandas, polars и DuckDB читают его без разбора текста.
+//
+// Колонки: ts - timestamp[s, UTC] (int64), ip, method, url - строки со
+// словарём (номера int32, значения large_string), status - uint16.
+// Словари пишутся один раз перед пакетами записей (record batch) по
+// batchRows строк. Метаданные - flatbuffers, собранные вручную; колонки
+// без пропусков, поэтому битовые карты null не пишутся.
+//
+// Колонки отображённого снимка (fromSnapshot) пишутся прямо из
+// отображения без копирования. Для записей анализатора время и статус
+// берутся из его колонок, а словари строк собираются заново
+// (ArrowDictionaryColumn): для IP и URL - из ключей индексов, без
+// хэширования каждой записи. Выборка строк собирается в буферы по
+// одному пакету. Для потоков записей неизвестной
+// длины - ArrowStreamWriter.
+
+// Строковая колонка: номер значения для каждой записи и словарь
+// (count + 1 смещений от bytes, первое равно 0)
+struct ArrowStringColumn {
+    const uint32_t* ids = nullptr;
+    const uint64_t* offsets = nullptr;
+    const char* bytes = nullptr;
+    size_t count = 0;
+};
+
+// Колонки для записи (без владения)
+struct ArrowTable {
+    size_t rows = 0;
+    const int64_t* epochs = nullptr;
+    const uint16_t* statuses = nullptr;
+    ArrowStringColumn ips;
+    ArrowStringColumn methods;
+    ArrowStringColumn urls;
+};
+
+// Словарное кодирование строковой колонки записей в памяти
+struct ArrowDictionaryColumn {
+    std::vector<uint32_t> ids;
+    std::vector<uint64_t> offsets;
+    std::string bytes;
+
+    // Значения в порядке первого появления; rows = nullptr - все записи
+    void encode(const std::vector<LogEntry>& logs, std::string LogEntry::* column,
+        const std::vector<RowId>* rows = nullptr);
+
+    // То же для всех записей, но значения - ключи индекса (в порядке
+    // первого появления по началу списка), номера - из списков записей;
+    // индекс должен покрывать все rows записей
+    void fromIndex(const HashIndex& index, size_t rows);
+    ArrowStringColumn view() const;
+};
+
+struct ArrowOptions {
+    size_t batchRows = 65536;
+};
+
+// Положение сообщения в файле (для оглавления)
+struct ArrowBlock {
+    int64_t offset;             // начало сообщения в файле
+    int32_t metadataLength;     // маркер, длина и метаданные с выравниванием
+    int32_t padding;
+    int64_t bodyLength;
+};
+
+// Запись в тот же формат пакетами по мере поступления записей. Строки
+// без словаря (large_string): словарь пришлось бы держать до конца
+// файла, а так память ограничена одним пакетом. Оглавление пишется
+// в close.
+class ArrowStreamWriter {
+private:
+    std::ofstream out;
+    std::vector<ArrowBlock> batches;
+
+    // Колонки пакета (буферы переиспользуются)
+    std::vector<int64_t> epochs;
+    std::vector<uint16_t> statuses;
+    std::vector<uint64_t> offsets[3];
+    std::string bytes[3];
+
+public:
+    ArrowStreamWriter() = default;
+    ArrowStreamWriter(const ArrowStreamWriter&) = delete;
+    ArrowStreamWriter& operator=(const ArrowStreamWriter&) = delete;
+
+    // Заголовок файла и схема
+    bool open(const std::string& filename);
+    // Пакет записей; пустой пакет не пишется
+    bool write(const std::vector<LogEntry>& batch);
+    // Маркер конца потока и оглавление
+    bool close();
+    bool isOpen() const { return out.is_open(); }
+};
+
+namespace ArrowWriter {
+
+    // Колонки отображённого снимка (действительны, пока он открыт)
+    ArrowTable fromSnapshot(const SnapshotFile& snapshot);
+
+    // Запись строк rows (номера в table); rows = nullptr - все строки
+    bool write(const std::string& filename, const ArrowTable& table,
+        const std::vector<RowId>* rows = nullptr, const ArrowOptions& options = ArrowOptions());
+}
+
+#endif // ARROW_WRITER_H
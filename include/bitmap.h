@@ -0,0 +1,119 @@
+﻿#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Сжатое битовое множество номеров записей в стиле Roaring.
+// Номера делятся на блоки по 65536 (старшие 16 бит - ключ блока).
+// Разреженный блок хранится как отсортированный массив uint16_t,
+// плотный (больше 4096 элементов) - как битовая карта из 1024 слов.
+
+class RoaringBitmap {
+private:
+    struct Container {
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> array;  // разреженный блок
+        std::vector<uint64_t> bits;   // плотный блок (1024 слова)
+
+        bool isBitset() const { return !bits.empty(); }
+        bool contains(uint16_t low) const;
+        void add(uint16_t low);
+        void toBitset();
+        void normalize();  // выбор представления по мощности
+    };
+
+    std::vector<Container> containers;  // по возрастанию key
+
+    static const uint32_t ARRAY_LIMIT = 4096;
+    static const size_t BITSET_WORDS = 1024;
+
+    static Container andContainers(const Container& a, const Container& b);
+    static Container orContainers(const Container& a, const Container& b);
+    static Container andNotContainers(const Container& a, const Container& b);
+
+    Container* findContainer(uint16_t key);
+    const Container* findContainer(uint16_t key) const;
+
+public:
+    RoaringBitmap() = default;
+
+    // Все номера из [0, count)
+    static RoaringBitmap range(uint32_t count);
+
+    // Добавление номера (быстрее всего при добавлении по возрастанию)
+    void add(uint32_t value);
+    bool contains(uint32_t value) const;
+
+    uint64_t cardinality() const;
+    bool empty() const { return containers.empty(); }
+    void clear() { containers.clear(); }
+
+    // Булевы операции
+    RoaringBitmap operator&(const RoaringBitmap& other) const;
+    RoaringBitmap operator|(const RoaringBitmap& other) const;
+    RoaringBitmap andNot(const RoaringBitmap& other) const;
+    RoaringBitmap& operator&=(const RoaringBitmap& other) { return *this = *this & other; }
+    RoaringBitmap& operator|=(const RoaringBitmap& other) { return *this = *this | other; }
+
+    // Дополнение до [0, universe)
+    RoaringBitmap flip(uint32_t universe) const { return range(universe).andNot(*this); }
+
+    // Мощность пересечения без построения результата
+    uint64_t andCardinality(const RoaringBitmap& other) const;
+
+    // Обход номеров по возрастанию
+    template<typename Fn>
+    void forEach(Fn&& fn) const {
+        for (const auto& c : containers) {
+            uint32_t high = static_cast<uint32_t>(c.key) << 16;
+            if (c.isBitset()) {
+                for (size_t w = 0; w < BITSET_WORDS; w++) {
+                    uint64_t word = c.bits[w];
+                    while (word) {
+                        unsigned bit = countTrailingZeros(word);
+                        fn(high | static_cast<uint32_t>(w * 64 + bit));
+                        word &= word - 1;
+                    }
+                }
+            }
+            else {
+                for (uint16_t low : c.array) {
+                    fn(high | low);
+                }
+            }
+        }
+    }
+
+    std::vector<uint32_t> toVector() const;
+    size_t memoryBytes() const;
+
+    bool operator==(const RoaringBitmap& other) const;
+    bool operator!=(const RoaringBitmap& other) const { return !(*this == other); }
+
+    // Аппаратные popcnt/tzcnt (MSVC и MinGW)
+    static unsigned popcount(uint64_t word) {
+#ifdef _MSC_VER
+        return static_cast<unsigned>(__popcnt64(word));
+#else
+        return static_cast<unsigned>(__builtin_popcountll(word));
+#endif
+    }
+
+    static unsigned countTrailingZeros(uint64_t word) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, word);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctzll(word));
+#endif
+    }
+};
+
+#endif // BITMAP_H
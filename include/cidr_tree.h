@@ -0,0 +1,206 @@
+﻿#ifndef CIDR_TREE_H
+#define CIDR_TREE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "log_index.h"
+
+// Подсети IPv4/IPv6: адреса упаковываются в целые числа и хранятся
+// в двоичном сжатом префиксном дереве (Patricia)
+
+// Адрес, выровненный по старшим битам: IPv4 занимает старшие 32 бита hi
+struct IPAddress {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+    bool v6 = false;
+
+    int maxBits() const { return v6 ? 128 : 32; }
+
+    // Бит номер i, считая от старшего
+    int bit(int i) const {
+        return i < 64 ? static_cast<int>((hi >> (63 - i)) & 1)
+            : static_cast<int>((lo >> (127 - i)) & 1);
+    }
+
+    // Первые bits бит, остальные обнулены
+    IPAddress masked(int bits) const;
+
+    // Длина общего префикса двух адресов (0..128)
+    static int commonPrefix(const IPAddress& a, const IPAddress& b);
+
+    bool operator==(const IPAddress& other) const {
+        return hi == other.hi && lo == other.lo && v6 == other.v6;
+    }
+};
+
+// Подсеть: адрес сети и длина префикса (0..32 для IPv4, 0..128 для IPv6)
+struct CIDR {
+    IPAddress network;
+    int prefix = 0;
+
+    bool contains(const IPAddress& address) const {
+        return address.v6 == network.v6 &&
+            IPAddress::commonPrefix(address, network) >= prefix;
+    }
+
+    std::string toString() const;
+};
+
+// Разбор "192.168.1.10", "2001:db8::1", "::ffff:10.0.0.1" (последний - как IPv4)
+bool parseIPAddress(std::string_view text, IPAddress& out);
+std::string formatIPAddress(const IPAddress& address);
+
+// Разбор "10.0.0.0/8", "2001:db8::/32"; адрес без /N - подсеть из одного адреса.
+// Биты адреса за пределами префикса обнуляются.
+bool parseCIDR(std::string_view text, CIDR& out);
+
+// Двоичное префиксное дерево: у внутренних узлов ровно два потомка,
+// цепочки из одного потомка сжаты. Каждый узел хранит сумму весов
+// поддерева и, возможно, значение (номер элемента у вызывающего кода).
+class CIDRTree {
+public:
+    static const int32_t NONE = -1;
+
+    struct Node {
+        IPAddress key;          // префикс узла (биты после bits обнулены)
+        int bits = 0;
+        int32_t child[2] = { NONE, NONE };
+        int32_t value = NONE;
+        uint64_t count = 0;     // сумма весов поддерева
+    };
+
+private:
+    std::vector<Node> nodes;
+
+    int32_t newNode(const IPAddress& key, int bits, uint64_t count);
+
+public:
+    CIDRTree() { clear(); }
+
+    // Узел для префикса (key, bits); weight добавляется ко всем узлам пути
+    int32_t insert(const IPAddress& key, int bits, uint64_t weight = 0);
+    void setValue(int32_t node, int32_t value) { nodes[node].value = value; }
+
+    // Значение самого длинного префикса, содержащего адрес (или NONE)
+    int32_t longestMatch(const IPAddress& address) const;
+
+    // Корень поддерева всех ключей под префиксом (или NONE)
+    int32_t findPrefix(const IPAddress& key, int bits) const;
+
+    // Значения поддерева
+    template<typename Fn>
+    void forEachValue(int32_t root, Fn&& fn) const {
+        if (root == NONE) return;
+        std::vector<int32_t> stack = { root };
+        while (!stack.empty()) {
+            const Node& node = nodes[stack.back()];
+            stack.pop_back();
+            if (node.value != NONE) fn(node.value);
+            for (int32_t c : node.child) {
+                if (c != NONE) stack.push_back(c);
+            }
+        }
+    }
+
+    // Подсети длины bits, в которых есть ключи: fn(сеть, сумма весов).
+    // Узел с bits >= длины префикса покрывает ровно одну такую подсеть.
+    template<typename Fn>
+    void forEachSubnet(int bits, Fn&& fn) const {
+        std::vector<int32_t> stack = { 0 };
+        while (!stack.empty()) {
+            const Node& node = nodes[stack.back()];
+            stack.pop_back();
+            if (node.count == 0) continue;
+            if (node.bits >= bits) {
+                fn(node.key.masked(bits), node.count);
+                continue;
+            }
+            for (int32_t c : node.child) {
+                if (c != NONE) stack.push_back(c);
+            }
+        }
+    }
+
+    const Node& node(int32_t id) const { return nodes[id]; }
+    uint64_t total() const { return nodes[0].count; }
+    size_t size() const { return nodes.size(); }
+    size_t memoryBytes() const { return nodes.capacity() * sizeof(Node); }
+    void clear();
+};
+
+// Индекс подсетей по уникальным IP из HashIndex: значение узла - номер
+// адреса, вес - число его записей. Разные строки одного адреса
+// ("10.0.0.1" и "::ffff:10.0.0.1") попадают в один узел и связаны в
+// цепочку через sameAddress. Указатели на элементы HashIndex
+// действительны, пока тот не перестроен.
+class SubnetIndex {
+public:
+    using Address = HashIndex::Map::value_type;
+
+private:
+    CIDRTree trees[2];  // [0] - IPv4, [1] - IPv6
+    std::vector<const Address*> addresses;
+    std::vector<IPAddress> parsed;
+    std::vector<int32_t> sameAddress;   // следующая строка того же адреса или NONE
+    size_t invalid = 0;  // строки, не являющиеся IP-адресом
+
+    // Новая строка адреса в узле node (в начало цепочки)
+    void attach(CIDRTree& tree, int32_t node, const Address& entry, const IPAddress& address);
+
+public:
+    void build(const HashIndex& ips);
+
+    // Добавление записи с адресом из HashIndex (список уже содержит запись)
+    void add(const Address& address);
+
+    // Записи подсети по возрастанию номеров
+    std::vector<RowId> rows(const CIDR& network) const;
+    uint64_t count(const CIDR& network) const;
+
+    // Подсети с наибольшим числом записей
+    std::vector<std::pair<CIDR, uint64_t>> topSubnets(int ipv4Prefix, int ipv6Prefix,
+        size_t n) const;
+
+    // Обход уникальных адресов: fn(адрес, строка IP, список записей)
+    template<typename Fn>
+    void forEachAddress(Fn&& fn) const {
+        for (size_t i = 0; i < addresses.size(); i++) {
+            fn(parsed[i], addresses[i]->first, addresses[i]->second);
+        }
+    }
+
+    size_t addressCount() const { return addresses.size(); }
+    size_t invalidCount() const { return invalid; }
+    size_t memoryBytes() const;
+    void clear();
+};
+
+// Именованные диапазоны (сети облаков, провайдеров, офисов):
+// адрес относится к диапазону с самым длинным подходящим префиксом
+class NamedRanges {
+private:
+    CIDRTree trees[2];
+    std::vector<std::string> names;
+    std::vector<CIDR> ranges;
+
+public:
+    // Добавление диапазона; повторный CIDR заменяет имя
+    bool add(const std::string& cidr, const std::string& name);
+
+    // Строки файла: "CIDR имя"; пустые строки и строки с # пропускаются.
+    // Возвращает число загруженных диапазонов.
+    size_t loadFromFile(const std::string& filename);
+
+    // Имя диапазона или nullptr
+    const std::string* lookup(const IPAddress& address) const;
+    const std::string* lookup(const std::string& ip) const;
+
+    size_t size() const { return names.size(); }
+    bool empty() const { return names.empty(); }
+    void clear();
+};
+
+#endif // CIDR_TREE_H
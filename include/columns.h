@@ -0,0 +1,56 @@
+﻿#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "log_entry.h"
+
+// Колоночное представление записей: плотные массивы чисел, по которым
+// компилятор может векторизовать проверки условий
+
+// Коды HTTP-методов (порядок совпадает с LogEntry::validateMethod)
+enum class HttpMethod : uint8_t {
+    Other = 0,
+    Get,
+    Post,
+    Put,
+    Delete,
+    Head,
+    Options,
+    Patch,
+    Connect,
+    Trace
+};
+
+// Код метода без учёта регистра; неизвестные методы - HttpMethod::Other
+HttpMethod methodCode(const std::string& method);
+
+// Имя метода в верхнем регистре; для HttpMethod::Other - "OTHER"
+const char* methodName(HttpMethod code);
+
+// Размер блока записей при поблочной проверке условий
+const size_t PREDICATE_BLOCK = 1024;
+
+// Колонки, построенные по вектору LogEntry
+struct LogColumns {
+    std::vector<uint16_t> status;
+    std::vector<uint8_t> method;   // HttpMethod
+
+    void build(const std::vector<LogEntry>& logs);
+    void add(const LogEntry& entry);
+    void clear();
+    size_t size() const { return status.size(); }
+};
+
+// Указатели на колонки для вычисления выражений (без владения)
+struct ColumnView {
+    const LogEntry* rows = nullptr;
+    const uint16_t* status = nullptr;
+    const uint8_t* method = nullptr;
+    const int64_t* epoch = nullptr;
+    size_t size = 0;
+};
+
+#endif // COLUMNS_H
@@ -0,0 +1,43 @@
+﻿#ifndef CSV_WRITER_H
+#define CSV_WRITER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include "log_entry.h"
+#include "log_index.h"
+
+// Экспорт записей в CSV по RFC 4180: поле с разделителем, кавычкой или
+// переводом строки берётся в кавычки, кавычки внутри удваиваются.
+// Строки форматируются в большие буферы (числа - через to_chars),
+// диапазоны строк - параллельно, а в файл пишутся по порядку
+// (см. export_pipeline.h).
+
+struct CsvOptions {
+    char delimiter = ',';
+    bool header = true;
+    std::string lineEnd = "\r\n";   // RFC 4180
+    unsigned threads = 0;           // 0 - по числу ядер
+};
+
+namespace CsvWriter {
+
+    // Нужны ли кавычки (проверка по 16 байт за шаг при наличии SSE2)
+    bool needsQuoting(std::string_view field, char delimiter = ',');
+
+    // Поле в конец буфера, в кавычках при необходимости
+    void appendField(std::string& out, std::string_view field, char delimiter = ',');
+
+    // Заголовок "timestamp,ip,method,url,status" с переводом строки
+    void appendHeader(std::string& out, const CsvOptions& options);
+
+    // Строка записи с переводом строки
+    void appendRow(std::string& out, const LogEntry& entry, const CsvOptions& options);
+
+    // Запись строк rows (номера в logs); rows = nullptr - все записи
+    bool write(const std::string& filename, const std::vector<LogEntry>& logs,
+        const std::vector<RowId>* rows = nullptr, const CsvOptions& options = CsvOptions());
+}
+
+#endif // CSV_WRITER_H
@@ -0,0 +1,99 @@
+﻿#ifndef ERROR_RATE_DETECTOR_H
+#define ERROR_RATE_DETECTOR_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+// Поиск интервалов, когда доля ошибок отклонилась от обычной.
+//
+// Записи подаются по возрастанию времени и считаются по интервалам
+// (bucketSeconds). Для каждого ряда - класса статуса, в целом и по
+// выбранным URL - держится экспоненциально сглаженное среднее и дисперсия
+// доли ошибок (EWMA). Закрытый интервал сравнивается с ними по z-оценке;
+// к дисперсии добавляется биномиальный шум p(1-p)/n, чтобы интервалы с
+// малым числом запросов не давали ложных тревог. Аномальный интервал
+// не сдвигает уже прогретые базы.
+//
+// С сезонностью (seasonBuckets > 0) у каждой фазы периода своя база,
+// например у каждой минуты суток; пока у фазы мало наблюдений,
+// используется общая. Память - O(число рядов x seasonBuckets).
+
+struct ErrorRateOptions {
+    int64_t bucketSeconds = 60;
+    double alpha = 0.1;             // вес нового интервала в EWMA
+    double threshold = 3.0;         // z-оценка, выше которой интервал аномален
+    uint32_t warmupBuckets = 10;    // интервалов до первой оценки
+    uint32_t minRequests = 20;      // интервалы с меньшим числом запросов не оцениваются
+    uint32_t seasonBuckets = 0;     // длина периода в интервалах; 0 - без сезонности
+    uint32_t seasonWarmup = 3;      // наблюдений фазы до перехода на её базу
+    std::vector<int> statusClasses = { 5 };  // 4 - 4xx, 5 - 5xx
+};
+
+// Интервал аномалии [start, end) одного ряда
+struct AnomalyInterval {
+    std::string series;     // "5xx" или "5xx /api/data"
+    int64_t start = 0;      // epoch-секунды
+    int64_t end = 0;
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    double peakRate = 0.0;      // наибольшая доля ошибок в интервале
+    double expectedRate = 0.0;  // ожидаемая доля в момент пика
+    double peakScore = 0.0;     // z-оценка пика
+};
+
+class ErrorRateDetector {
+private:
+    // Экспоненциально сглаженные среднее и дисперсия
+    struct Baseline {
+        double mean = 0.0;
+        double variance = 0.0;
+        uint32_t samples = 0;
+
+        void update(double value, double alpha);
+    };
+
+    struct Series {
+        std::string name;
+        int statusClass = 5;
+        int url = -1;                   // номер URL; -1 - все запросы
+        Baseline global;
+        std::vector<Baseline> seasonal;
+        uint64_t errors = 0;            // в текущем интервале
+        bool open = false;              // идёт аномалия
+        int64_t lastBucket = 0;
+        AnomalyInterval current;
+    };
+
+    ErrorRateOptions options;
+    std::vector<Series> series;
+    std::vector<int> classPosition;     // класс статуса -> номер в options.statusClasses
+    std::unordered_map<std::string, int> urlIds;
+    std::vector<uint64_t> urlRequests;  // в текущем интервале
+    uint64_t requests = 0;
+    int64_t bucket = 0;
+    bool started = false;
+    std::vector<AnomalyInterval> found;
+
+    void closeBucket();
+    void closeInterval(Series& s);
+
+public:
+    // urls - адреса, для которых нужны отдельные ряды (например, топ URL)
+    explicit ErrorRateDetector(const ErrorRateOptions& options,
+        const std::vector<std::string>& urls = {});
+
+    // Запись в момент epoch; время не должно убывать
+    void add(int64_t epoch, int status, const std::string& url);
+
+    // Оценка последнего интервала и закрытие незавершённых аномалий
+    void finish();
+
+    // Найденные интервалы в порядке закрытия
+    const std::vector<AnomalyInterval>& anomalies() const { return found; }
+    size_t seriesCount() const { return series.size(); }
+};
+
+#endif // ERROR_RATE_DETECTOR_H
@@ -0,0 +1,121 @@
+﻿#ifndef ETL_PIPELINE_H
+#define ETL_PIPELINE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include "log_entry.h"
+#include "query.h"
+
+// Потоковое преобразование формата без загрузки в LogAnalyzer:
+// чтение -> разбор и фильтр -> запись. Каждая стадия - свой поток,
+// между стадиями очереди пакетов ограниченной длины, поэтому память
+// не зависит от размера входа: в работе не больше
+// (queueBatches + 1) пакетов на очередь.
+
+// Очередь с ограничением длины: push ждёт места, pop - элемента.
+// close будит всех; после него push отказывает, а pop отдаёт остаток
+template<typename T>
+class BoundedQueue {
+private:
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1) {}
+
+    // false - очередь закрыта
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // false - очередь закрыта и пуста
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+};
+
+// Деление текста на записи верхнего уровня без разбора: объекты вне
+// других объектов. Подходит и для массива записей, и для NDJSON;
+// текст подаётся блоками, запись на границе блоков собирается по частям
+class RecordScanner {
+private:
+    std::string partial;        // начало незавершённой записи
+    int depth = 0;
+    bool inString = false;
+    bool escaped = false;
+
+public:
+    // Завершённые в блоке записи - в конец records
+    void feed(const char* data, size_t size, std::vector<std::string>& records);
+
+    // Остался незавершённый объект
+    bool hasPartial() const { return depth > 0; }
+    void reset();
+};
+
+enum class EtlFormat {
+    Csv,
+    Json,       // массив объектов, как exportToJson
+    Ndjson,     // объект на строку
+    Arrow       // файл Arrow IPC, строки без словаря
+};
+
+struct EtlOptions {
+    EtlFormat format = EtlFormat::Csv;
+    LogQuery filter;                // пустой - все записи
+    size_t batchRows = 4096;        // записей в пакете между стадиями
+    size_t queueBatches = 4;        // длина каждой очереди
+    size_t readBlockBytes = 1 << 20;
+};
+
+struct EtlStats {
+    uint64_t bytesRead = 0;
+    uint64_t records = 0;           // разобранные записи
+    uint64_t written = 0;           // прошедшие фильтр
+    uint64_t skipped = 0;           // не записи лога или с ошибкой разбора
+    std::string error;              // причина отказа
+};
+
+namespace EtlPipeline {
+
+    // Имя формата из командной строки: csv, json, ndjson, arrow
+    bool parseFormat(const std::string& name, EtlFormat& format);
+
+    // Преобразование файлов inputs (по порядку) в output; false - ошибка
+    // чтения или записи (причина в stats.error)
+    bool run(const std::vector<std::string>& inputs, const std::string& output,
+        const EtlOptions& options, EtlStats& stats);
+}
+
+#endif // ETL_PIPELINE_H
@@ -0,0 +1,29 @@
+﻿#ifndef EXPORT_PIPELINE_H
+#define EXPORT_PIPELINE_H
+
+#include <string>
+#include <functional>
+#include <cstddef>
+
+// Параллельное форматирование при экспорте: строки делятся на блоки,
+// блоки форматируются несколькими потоками в свои буферы, а выводятся
+// строго по порядку. Буферов в работе не больше двух на поток, поэтому
+// память не зависит от числа строк.
+
+namespace ExportPipeline {
+
+    // Форматирование строк [begin, end) в конец буфера
+    using FormatFn = std::function<void(size_t begin, size_t end, std::string& buffer)>;
+
+    // Вывод готового блока; false - ошибка записи (остальное не выводится)
+    using WriteFn = std::function<bool(const std::string& block)>;
+
+    // Размер блока по умолчанию: буфер порядка нескольких мегабайт
+    const size_t DEFAULT_BLOCK_ROWS = 65536;
+
+    // threads = 0 - по числу ядер (с учётом chooseThreadCount)
+    bool formatInOrder(size_t rows, const FormatFn& format, const WriteFn& write,
+        unsigned threads = 0, size_t blockRows = DEFAULT_BLOCK_ROWS);
+}
+
+#endif // EXPORT_PIPELINE_H
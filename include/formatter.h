@@ -65,6 +65,13 @@ public:
         const TableConfig& config = TableConfig()
     );
 
+    // Таблица по выборке: копируются только отображаемые строки
+    static std::string formatLogsTable(
+        const Selection& selection,
+        int maxRows = 50,
+        const TableConfig& config = TableConfig()
+    );
+
     static std::string formatTopTable(
         const std::vector<std::pair<std::string, int>>& data,
         const std::string& title,
@@ -73,6 +80,14 @@ public:
         const TableConfig& config = TableConfig()
     );
 
+    // Результат группировки (первые maxRows групп)
+    static std::string formatGroupTable(
+        const GroupTable& table,
+        const std::string& title,
+        int maxRows = 50,
+        const TableConfig& config = TableConfig()
+    );
+
     static std::string formatStatisticsTable(
         const LogAnalyzer::Statistics& stats,
         const TableConfig& config = TableConfig()
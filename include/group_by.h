@@ -0,0 +1,137 @@
+﻿#ifndef GROUP_BY_H
+#define GROUP_BY_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include "columns.h"
+#include "log_index.h"
+
+// Группировка с агрегатами по одной или нескольким колонкам:
+//
+//   GroupBy query;
+//   query.by(GroupKey::URL).by(GroupKey::Hour).count().distinctOf(GroupColumn::IP);
+//   GroupTable table = analyzer.groupBy(query, analyzer.where(Status() >= 500));
+//
+// Каждый ключ сначала кодируется числом (строки - номером в словаре
+// индекса, время - номером интервала), затем блоки записей хэшируются
+// по колонкам кодов. Потоки агрегируют свои диапазоны записей в
+// отдельные таблицы, которые в конце сливаются.
+
+// Ключи группировки
+enum class GroupKey {
+    IP,
+    URL,
+    Path,           // путь URL без домена и параметров
+    Method,
+    Status,
+    StatusClass,    // "2xx" ... "5xx"
+    Minute,         // начало минуты, часа, суток (UTC)
+    Hour,
+    Day
+};
+
+// Колонки агрегатов: Min/Max - для Status и Time (для остальных -
+// исключение invalid_argument), Distinct - для любой
+enum class GroupColumn {
+    IP,
+    URL,
+    Method,
+    Status,
+    Time
+};
+
+enum class AggregateKind {
+    Count,
+    Min,
+    Max,
+    Distinct
+};
+
+struct GroupBy {
+    struct Aggregate {
+        AggregateKind kind;
+        GroupColumn column;
+    };
+
+    std::vector<GroupKey> keys;
+    std::vector<Aggregate> aggregates;
+    unsigned threads = 0;  // 0 - по числу ядер
+
+    // Построение цепочкой вызовов
+    GroupBy& by(GroupKey key) { keys.push_back(key); return *this; }
+    GroupBy& count() { aggregates.push_back({ AggregateKind::Count, GroupColumn::Status }); return *this; }
+    GroupBy& minOf(GroupColumn column) { aggregates.push_back({ AggregateKind::Min, ordered(column) }); return *this; }
+    GroupBy& maxOf(GroupColumn column) { aggregates.push_back({ AggregateKind::Max, ordered(column) }); return *this; }
+    GroupBy& distinctOf(GroupColumn column) { aggregates.push_back({ AggregateKind::Distinct, column }); return *this; }
+    GroupBy& withThreads(unsigned count) { threads = count; return *this; }
+
+    // Колонка, у которой есть порядок значений
+    static GroupColumn ordered(GroupColumn column) {
+        if (column != GroupColumn::Status && column != GroupColumn::Time) {
+            throw std::invalid_argument("Мин./макс. определены только для статуса и времени");
+        }
+        return column;
+    }
+};
+
+// Колонки источника (без владения)
+struct GroupSource {
+    ColumnView columns;
+    const HashIndex* ips = nullptr;
+    const HashIndex* urls = nullptr;
+};
+
+// Результат: строки групп с кодами ключей и значениями агрегатов.
+// Строковые значения ключей хранятся один раз в словаре колонки.
+// По умолчанию группы упорядочены по ключам.
+class GroupTable {
+private:
+    std::vector<std::string> headers;                    // ключи, затем агрегаты
+    std::vector<std::vector<std::string>> dictionaries;  // по колонкам ключей
+    std::vector<uint32_t> keyCodes;                      // группа x ключ
+    std::vector<int64_t> values;                         // группа x агрегат
+    std::vector<char> timeColumns;                       // агрегат - время
+    size_t keyCount = 0;
+    size_t aggregateCount = 0;
+    size_t groups = 0;
+
+    // Перестановка групп: order[i] - прежний номер i-й группы
+    void permute(const std::vector<size_t>& order);
+
+    friend GroupTable executeGroupBy(const GroupBy& query, const GroupSource& source,
+        const std::vector<RowId>* rows);
+
+public:
+    size_t size() const { return groups; }
+    bool empty() const { return groups == 0; }
+    size_t keyColumns() const { return keyCount; }
+    size_t aggregateColumns() const { return aggregateCount; }
+    const std::vector<std::string>& getHeaders() const { return headers; }
+
+    const std::string& key(size_t group, size_t column) const {
+        return dictionaries[column][keyCodes[group * keyCount + column]];
+    }
+    int64_t value(size_t group, size_t aggregate) const {
+        return values[group * aggregateCount + aggregate];
+    }
+
+    // Текст ячейки; column - номер в getHeaders()
+    std::string cell(size_t group, size_t column) const;
+
+    // Сортировка групп по колонке (устойчивая) и отсечение хвоста
+    void sortBy(size_t column, bool descending = true);
+    void truncate(size_t limit);
+
+    // Строки для LogFormatter::formatTable
+    std::vector<std::vector<std::string>> toRows(size_t maxRows = SIZE_MAX) const;
+};
+
+// rows - номера записей по возрастанию; nullptr - все записи источника.
+// Мин./макс. строковой колонки в query - исключение invalid_argument
+GroupTable executeGroupBy(const GroupBy& query, const GroupSource& source,
+    const std::vector<RowId>* rows);
+
+#endif // GROUP_BY_H
@@ -5,10 +5,17 @@
 #include <vector>
 #include <map>
 #include <stdexcept>
+#include <cstdint>
 #include "log_entry.h"
 
 // JSON-парсер для работы с логами веб-сервера
 
+// Положение записи в исходном файле: смещение и длина текста объекта
+struct RecordSpan {
+    uint64_t offset = 0;
+    uint64_t length = 0;
+};
+
 enum class JsonType {
     Null,
     Boolean,
@@ -46,6 +53,8 @@ struct JsonValue {
     double asNumber() const;
     bool asBoolean() const;
     std::vector<LogEntry> asLogEntries() const;
+    // Объект записи лога; false - не объект или нет нужных полей
+    bool toLogEntry(LogEntry& entry) const;
 
     // Проверки типов
     bool isNull() const { return type == JsonType::Null; }
@@ -75,6 +84,16 @@ public:
     // Загрузка из файла с обработкой BOM для Windows
     static JsonValue loadFromFile(const std::string& filename);
 
+    // Массив записей логов: элементы разбираются по одному, без дерева
+    // всего массива; некорректные записи пропускаются. spans - положение
+    // каждой принятой записи в тексте (смещения от base)
+    static std::vector<LogEntry> parseLogEntries(const std::string& jsonStr,
+        std::vector<RecordSpan>* spans = nullptr, uint64_t base = 0);
+
+    // Записи из файла; смещения spans - от начала файла (с учётом BOM)
+    static std::vector<LogEntry> loadLogEntries(const std::string& filename,
+        std::vector<RecordSpan>* spans = nullptr);
+
     // Сохранение в файл
     static void saveToFile(const std::string& filename, const JsonValue& value, bool pretty = true);
 
@@ -85,6 +104,9 @@ public:
     static bool isValid(const std::string& jsonStr, std::string& errorMsg);
 
 private:
+    // Содержимое файла без BOM; bomBytes - длина пропущенного BOM
+    static std::string readFile(const std::string& filename, size_t& bomBytes);
+
     // Вспомогательные методы парсинга
     static JsonValue parseValue(const std::string& jsonStr, size_t& pos);
     static JsonValue parseObject(const std::string& jsonStr, size_t& pos);
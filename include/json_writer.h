@@ -0,0 +1,42 @@
+﻿#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include "log_entry.h"
+#include "log_index.h"
+
+// Потоковый экспорт записей в JSON без промежуточного дерева JsonValue:
+// записи форматируются прямо в буферы блоками (см. export_pipeline.h),
+// поэтому память не зависит от числа записей. Строки экранируются по
+// RFC 8259 (кавычка, обратная косая черта, управляющие символы).
+
+enum class JsonLayout {
+    Array,      // один массив объектов
+    Lines       // NDJSON: объект на строку
+};
+
+struct JsonExportOptions {
+    JsonLayout layout = JsonLayout::Array;
+    // Массив - объект по полю на строке; NDJSON - пробелы после ':' и ','
+    bool pretty = true;
+    unsigned threads = 0;           // 0 - по числу ядер
+};
+
+namespace JsonWriter {
+
+    // Строка в кавычках с экранированием
+    void appendString(std::string& out, std::string_view value);
+
+    // Объект {"ts", "ip", "method", "url", "status"} без разделителей
+    // между записями (многострочный - с отступом элемента массива)
+    void appendRecord(std::string& out, const LogEntry& entry, const JsonExportOptions& options);
+
+    // Запись строк rows (номера в logs); rows = nullptr - все записи
+    bool write(const std::string& filename, const std::vector<LogEntry>& logs,
+        const std::vector<RowId>* rows = nullptr, const JsonExportOptions& options = JsonExportOptions());
+}
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,248 @@
+﻿#ifndef LOG_INDEX_H
+#define LOG_INDEX_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <cstdint>
+#include <utility>
+#include "log_entry.h"
+#include "bitmap.h"
+
+// Вторичные индексы по колонкам логов
+
+// Номер записи в LogAnalyzer (32 бита достаточно для ~4 млрд записей)
+using RowId = uint32_t;
+
+// Оптимизированная хэш-функция для Windows
+struct WindowsStringHash {
+    size_t operator()(std::string_view s) const {
+        // FNV-1a hash - эффективная для Windows
+        size_t hash = 2166136261U;
+        for (char c : s) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 16777619U;
+        }
+        return hash;
+    }
+};
+
+// Сжатый список номеров записей (posting list).
+// Номера хранятся по возрастанию как разности (delta) в формате varint:
+// для плотных списков это ~1 байт на запись вместо 8 у std::vector<size_t>.
+class PostingList {
+private:
+    std::vector<uint8_t> data;
+    uint32_t count = 0;
+    RowId first = 0;
+    RowId last = 0;
+
+    void appendVarint(uint32_t value);
+
+public:
+    // Добавление номера записи (номера должны идти по возрастанию)
+    void add(RowId row);
+
+    // Дописывание списка, все номера которого больше last
+    void append(const PostingList& tail);
+
+    // Распаковка в обычный вектор
+    std::vector<RowId> decode() const;
+    void decodeInto(std::vector<RowId>& out) const;
+
+    // Обход без распаковки в память
+    template<typename Fn>
+    void forEach(Fn&& fn) const {
+        RowId value = 0;
+        size_t pos = 0;
+        while (pos < data.size()) {
+            uint32_t delta = 0;
+            int shift = 0;
+            uint8_t byte;
+            do {
+                byte = data[pos++];
+                delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            value += delta;
+            fn(value);
+        }
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    RowId front() const { return first; }
+    RowId back() const { return last; }
+    size_t bytes() const { return data.size(); }
+    void clear();
+};
+
+// Хэш-индекс: значение колонки -> сжатый список записей
+class HashIndex {
+public:
+    using Map = std::unordered_map<std::string, PostingList, WindowsStringHash>;
+
+private:
+    Map postings;
+
+public:
+    // Построение по строковой колонке; при больших объёмах записи
+    // делятся на диапазоны и индексируются в нескольких потоках
+    void build(const std::vector<LogEntry>& logs,
+        std::string LogEntry::* column,
+        unsigned threads = 0);
+
+    // Добавление одной записи (номер больше всех уже добавленных).
+    // Возвращает элемент индекса: его адрес не меняется при росте таблицы.
+    const Map::value_type& add(const std::string& key, RowId row) {
+        Map::value_type& entry = *postings.try_emplace(key).first;
+        entry.second.add(row);
+        return entry;
+    }
+
+    // Точечный поиск: nullptr, если значение не встречается
+    const PostingList* find(const std::string& key) const;
+
+    // Построение по уже закодированной колонке: ids[i] - номер значения
+    // записи i в словаре keys. Строки хэшируются по разу на значение,
+    // а не на запись
+    template<typename Dictionary>
+    void buildFromIds(const Dictionary& keys, const uint32_t* ids, size_t rows) {
+        std::vector<PostingList> lists(keys.size());
+        for (size_t i = 0; i < rows; i++) {
+            lists[ids[i]].add(static_cast<RowId>(i));
+        }
+
+        postings.clear();
+        postings.reserve(keys.size());
+        for (size_t id = 0; id < keys.size(); id++) {
+            if (!lists[id].empty()) {
+                postings.emplace(std::string(keys[id]), std::move(lists[id]));
+            }
+        }
+    }
+
+    const Map& entries() const { return postings; }
+    size_t distinctKeys() const { return postings.size(); }
+    size_t memoryBytes() const;
+    void clear() { postings.clear(); }
+};
+
+// Индекс по времени: колонка epoch-секунд и перестановка записей,
+// упорядоченная по времени. Если записи уже идут по возрастанию времени
+// (обычный случай для логов), перестановка не строится и не сортируется.
+class TimeIndex {
+private:
+    std::vector<int64_t> epochs;
+    std::vector<RowId> order;
+    bool sorted = true;
+
+    void sortOrder();
+
+public:
+    // Непрерывный диапазон позиций [begin, end) в порядке времени
+    struct Span {
+        size_t begin = 0;
+        size_t end = 0;
+        size_t size() const { return end - begin; }
+        bool empty() const { return begin >= end; }
+    };
+
+    void build(const std::vector<LogEntry>& logs, unsigned threads = 0);
+
+    // Готовая колонка времени (например, из снимка): без разбора строк
+    void assign(std::vector<int64_t> epochColumn);
+
+    // Добавление записи с номером size(). Запись не по порядку переводит
+    // индекс на перестановку и вставляется в неё бинарным поиском; у почти
+    // упорядоченных логов сдвигается лишь короткий хвост перестановки.
+    void add(int64_t epoch);
+
+    // Две бинарных поиска: записи с from <= epoch <= to
+    Span range(int64_t from, int64_t to) const;
+
+    // Номер записи на позиции pos в порядке времени
+    RowId rowAt(size_t pos) const {
+        return sorted ? static_cast<RowId>(pos) : order[pos];
+    }
+
+    int64_t epochOf(RowId row) const { return epochs[row]; }
+    const std::vector<int64_t>& epochColumn() const { return epochs; }
+
+    bool isSorted() const { return sorted; }
+    size_t size() const { return epochs.size(); }
+    bool empty() const { return epochs.empty(); }
+    void clear();
+};
+
+// Битовые индексы для колонок с малым числом значений:
+// статус, класс статуса (1xx-5xx) и HTTP-метод (без учёта регистра).
+// Комбинации условий вычисляются операциями над битовыми картами,
+// не обращаясь к самим записям.
+class BitmapIndex {
+private:
+    std::map<int, RoaringBitmap> statuses;
+    RoaringBitmap statusClasses[6];  // [1]..[5] - 1xx..5xx, [0] - прочие
+    std::map<std::string, RoaringBitmap> methods;  // ключ в верхнем регистре
+    std::unordered_map<std::string, std::string, WindowsStringHash> upperCache;
+    size_t rows = 0;
+
+    const std::string& canonicalMethod(const std::string& method);
+
+public:
+    void build(const std::vector<LogEntry>& logs);
+
+    // Добавление записи (номер больше всех уже добавленных)
+    void add(const LogEntry& entry, RowId row);
+
+    RoaringBitmap status(int code) const;
+    RoaringBitmap statusRange(int minStatus, int maxStatus) const;  // включительно
+    RoaringBitmap statusClass(int cls) const;  // 2 -> все 2xx
+    RoaringBitmap method(const std::string& name) const;
+    RoaringBitmap all() const { return RoaringBitmap::range(static_cast<uint32_t>(rows)); }
+
+    const std::map<int, RoaringBitmap>& statusEntries() const { return statuses; }
+    const std::map<std::string, RoaringBitmap>& methodEntries() const { return methods; }
+
+    static int classOf(int status) {
+        return (status >= 100 && status <= 599) ? status / 100 : 0;
+    }
+
+    size_t size() const { return rows; }
+    size_t memoryBytes() const;
+    void clear();
+};
+
+// Кэш топ-N значений колонки. При добавлении записи счётчик одного ключа
+// растёт на единицу, поэтому список поправляется на месте: ключ из списка
+// поднимается, ключ, обогнавший последний элемент, занимает его место.
+// Место ключа в списке ищется по хэш-таблице, а подъём на единицу
+// перескакивает группу ключей с равным счётчиком одним обменом.
+class TopKCache {
+private:
+    std::vector<std::pair<std::string, int>> items;  // по убыванию счётчика
+    std::unordered_map<std::string, size_t, WindowsStringHash> positions;  // ключ -> номер в items
+    size_t limit = 0;   // сколько элементов хранится (0 - кэш пуст)
+    bool complete = false;  // в списке все значения колонки
+
+    void swapItems(size_t a, size_t b);
+
+public:
+    // Первые n элементов, если кэш их содержит
+    bool get(int n, std::vector<std::pair<std::string, int>>& out) const;
+
+    // Сохранение результата запроса топ-n (n <= 0 - все значения)
+    void store(int n, const std::vector<std::pair<std::string, int>>& sorted);
+
+    // Новое значение счётчика ключа (ровно на 1 больше прежнего)
+    void update(const std::string& key, int count);
+
+    void clear();
+};
+
+// Число потоков для параллельной обработки rows записей
+unsigned chooseThreadCount(size_t rows, unsigned requested = 0);
+
+#endif // LOG_INDEX_H
@@ -0,0 +1,116 @@
+﻿#ifndef LOG_LOADER_H
+#define LOG_LOADER_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include "log_entry.h"
+
+// Загрузка нескольких файлов логов (например, по файлу на сервер в час)
+// в один упорядоченный по времени набор.
+//
+// Файлы разбираются параллельно, по одному на поток. Каждый файл
+// проверяется на упорядоченность по времени: упорядоченный сразу идёт
+// в слияние, неупорядоченный делится на куски по числу потоков, и куски
+// всех таких файлов сортируются параллельно (устойчиво). Затем все
+// последовательности сливаются за один проход деревом проигравших:
+// O(N log k) сравнений для k последовательностей. Записи с одинаковым
+// временем идут в порядке файлов и строк.
+
+// Дерево проигравших для слияния k упорядоченных последовательностей.
+// Во внутренних узлах лежат проигравшие, в tree[0] - победитель;
+// после замены головы победителя повторяется только путь от его листа
+// к корню (log k сравнений).
+template<typename Key>
+class LoserTree {
+private:
+    std::vector<Key> heads;         // текущие головы последовательностей
+    std::vector<bool> exhausted;
+    std::vector<size_t> tree;
+    size_t k;
+
+    // Исчерпанная последовательность больше любой; равные - по номеру
+    bool less(size_t a, size_t b) const {
+        if (exhausted[a] != exhausted[b]) return !exhausted[a];
+        if (exhausted[a]) return a < b;
+        if (heads[a] < heads[b]) return true;
+        if (heads[b] < heads[a]) return false;
+        return a < b;
+    }
+
+    void replay(size_t source) {
+        size_t winner = source;
+        for (size_t node = (source + k) / 2; node >= 1; node /= 2) {
+            if (less(tree[node], winner)) {
+                std::swap(tree[node], winner);
+            }
+        }
+        tree[0] = winner;
+    }
+
+public:
+    // Первые элементы последовательностей; empty[i] - последовательность пуста
+    LoserTree(std::vector<Key> first, std::vector<bool> empty)
+        : heads(std::move(first)), exhausted(std::move(empty)), k(heads.size()) {
+        tree.assign(k > 0 ? k : 1, 0);
+        if (k == 0) return;
+
+        // Победители поддеревьев снизу вверх; в узле остаётся проигравший
+        std::vector<size_t> winners(2 * k);
+        for (size_t i = 0; i < k; i++) {
+            winners[k + i] = i;
+        }
+        for (size_t node = k - 1; node >= 1; node--) {
+            size_t a = winners[2 * node];
+            size_t b = winners[2 * node + 1];
+            bool aWins = less(a, b);
+            winners[node] = aWins ? a : b;
+            tree[node] = aWins ? b : a;
+        }
+        tree[0] = winners[1];
+    }
+
+    // Все последовательности исчерпаны
+    bool empty() const { return k == 0 || exhausted[tree[0]]; }
+
+    // Номер последовательности с наименьшей головой
+    size_t top() const { return tree[0]; }
+
+    // Следующий элемент победившей последовательности
+    void replaceTop(Key next) {
+        heads[tree[0]] = std::move(next);
+        replay(tree[0]);
+    }
+
+    // Победившая последовательность закончилась
+    void popTop() {
+        exhausted[tree[0]] = true;
+        replay(tree[0]);
+    }
+};
+
+// Итог загрузки нескольких файлов
+struct MultiFileLoad {
+    std::vector<LogEntry> logs;         // по возрастанию времени
+    size_t files = 0;                   // успешно прочитанных файлов
+    size_t sortedFiles = 0;             // из них уже упорядоченных по времени
+    std::vector<std::string> errors;    // "файл: причина"
+};
+
+namespace LogLoader {
+
+    // Файлы по пути: директория - все *.json в ней, маска ("logs\\web-*.json") -
+    // подходящие файлы, иначе сам путь. Порядок - по имени файла
+    std::vector<std::string> expandInputs(const std::string& pathOrPattern);
+
+    // Параллельная загрузка и слияние по времени; threads = 0 - по числу ядер
+    MultiFileLoad loadFiles(const std::vector<std::string>& files, unsigned threads = 0);
+
+    // Слияние упорядоченных по времени частей (epochs[i] - время записей parts[i])
+    std::vector<LogEntry> mergeByTime(std::vector<std::vector<LogEntry>>& parts,
+        const std::vector<std::vector<int64_t>>& epochs);
+}
+
+#endif // LOG_LOADER_H
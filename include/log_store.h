@@ -0,0 +1,151 @@
+﻿#ifndef LOG_STORE_H
+#define LOG_STORE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <iterator>
+#include <cstdint>
+#include "log_entry.h"
+#include "analyzer.h"
+
+// Хранилище для одновременной записи и чтения.
+//
+// Записи лежат в неизменяемых сегментах (до segmentCapacity записей),
+// у каждого сегмента индексы построены заранее. Снимок - список сегментов;
+// поток записи собирает новый снимок в стороне и публикует его одной
+// атомарной заменой указателя (RCU). Читатель берёт текущий снимок и
+// работает с ним без блокировок, сколько нужно: старые сегменты и снимки
+// освобождаются, когда их отпустит последний читатель.
+//
+//   LogStore store;
+//   // поток записи
+//   store.append(entry); ... store.publish();
+//   // любой поток чтения
+//   auto snapshot = store.snapshot();
+//   snapshot->filterByStatus(500);
+
+// Неизменяемый сегмент: записи с готовыми индексами
+class LogSegment {
+private:
+    LogAnalyzer analyzer;
+    size_t first;  // номер первой записи сегмента в хранилище
+
+public:
+    LogSegment(std::vector<LogEntry> rows, size_t firstRow);
+
+    const LogAnalyzer& data() const { return analyzer; }
+    const std::vector<LogEntry>& rows() const { return analyzer.getLogs(); }
+    size_t firstRow() const { return first; }
+    size_t size() const { return analyzer.getLogs().size(); }
+};
+
+// Согласованный снимок хранилища; все методы только читают
+class LogSnapshot {
+public:
+    using SegmentPtr = std::shared_ptr<const LogSegment>;
+
+private:
+    std::vector<SegmentPtr> segments;
+    size_t rows = 0;
+    uint64_t version = 0;
+
+    friend class LogStore;
+
+    // Объединение результатов сегментов (сегменты идут в порядке записей)
+    template<typename Fn>
+    std::vector<LogEntry> collect(Fn&& perSegment) const {
+        std::vector<LogEntry> result;
+        for (const auto& segment : segments) {
+            std::vector<LogEntry> part = perSegment(segment->data());
+            result.insert(result.end(), std::make_move_iterator(part.begin()),
+                std::make_move_iterator(part.end()));
+        }
+        return result;
+    }
+
+public:
+    size_t size() const { return rows; }
+    bool empty() const { return rows == 0; }
+    uint64_t getVersion() const { return version; }
+    const std::vector<SegmentPtr>& getSegments() const { return segments; }
+
+    // Обход записей по порядку
+    template<typename Fn>
+    void forEach(Fn&& fn) const {
+        for (const auto& segment : segments) {
+            for (const auto& entry : segment->rows()) {
+                fn(entry);
+            }
+        }
+    }
+
+    const LogEntry& at(size_t row) const;
+
+    std::vector<LogEntry> filterByStatus(int status) const;
+    std::vector<LogEntry> filterByMethod(const std::string& method) const;
+    std::vector<LogEntry> filterByIP(const std::string& ip) const;
+    std::vector<LogEntry> filterByURL(const std::string& urlPattern) const;
+    std::vector<LogEntry> filterByURLPrefix(const std::string& prefix) const;
+    std::vector<LogEntry> filterByCIDR(const std::string& cidr) const;
+    std::vector<LogEntry> filterByTimeRange(const std::string& startTime,
+        const std::string& endTime) const;
+
+    std::vector<std::pair<std::string, int>> getTopIPs(int n = 10) const;
+    std::vector<std::pair<std::string, int>> getTopURLs(int n = 10) const;
+    std::map<int, int> getStatusDistribution() const;
+    std::map<std::string, int> getMethodDistribution() const;
+    std::pair<std::string, std::string> getTimeRange() const;
+
+    // Выражения из predicate.h
+    template<typename Expr>
+    std::vector<LogEntry> where(const Expr& expr) const {
+        return collect([&expr](const LogAnalyzer& segment) {
+            return segment.where(expr).materialize();
+        });
+    }
+
+    template<typename Expr>
+    size_t count(const Expr& expr) const {
+        size_t total = 0;
+        for (const auto& segment : segments) {
+            total += segment->data().count(expr);
+        }
+        return total;
+    }
+};
+
+class LogStore {
+private:
+    // Текущий снимок: читается и заменяется только через atomic_load/atomic_store
+    std::shared_ptr<const LogSnapshot> current;
+
+    // Состояние потока записи
+    std::vector<LogEntry> pending;
+    size_t segmentCapacity;
+    size_t appended = 0;
+
+public:
+    static const size_t DEFAULT_SEGMENT_CAPACITY = 65536;
+
+    explicit LogStore(size_t capacity = DEFAULT_SEGMENT_CAPACITY);
+
+    // ---- Поток записи (один) ----
+    // Записи становятся видны читателям после publish()
+    void append(const LogEntry& entry);
+    void append(const std::vector<LogEntry>& entries);
+
+    // Публикация накопленных записей. Неполный последний сегмент
+    // пересобирается вместе с новыми записями (копируется не больше
+    // одного сегмента), остальные сегменты переходят в новый снимок как есть.
+    void publish();
+
+    size_t pendingCount() const { return pending.size(); }
+    size_t appendedCount() const { return appended; }
+
+    // ---- Потоки чтения (любое число) ----
+    std::shared_ptr<const LogSnapshot> snapshot() const;
+};
+
+#endif // LOG_STORE_H
@@ -0,0 +1,73 @@
+﻿#ifndef NGRAM_INDEX_H
+#define NGRAM_INDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include "log_index.h"
+
+// Поиск подстрок в уникальных значениях колонки (URL)
+
+// Поиск подстроки: позиция первого вхождения или std::string::npos.
+// На x86 сравниваются первый и последний символ образца сразу
+// в 16 позициях (SSE2), полное сравнение - только для совпавших позиций.
+size_t findSubstring(const char* text, size_t textLength,
+    const char* pattern, size_t patternLength);
+
+inline bool containsSubstring(const std::string& text, const std::string& pattern) {
+    return findSubstring(text.data(), text.size(), pattern.data(), pattern.size()) !=
+        std::string::npos;
+}
+
+// Триграммный индекс по словарю HashIndex: триграмма -> сжатый список
+// номеров уникальных значений. Для образца из 3+ символов кандидаты -
+// пересечение списков его триграмм; кандидаты затем проверяются
+// findSubstring. Индекс хранит указатели на элементы HashIndex
+// и действителен, пока тот не перестроен.
+class NGramIndex {
+public:
+    using Term = HashIndex::Map::value_type;  // значение и его записи
+
+private:
+    std::vector<const Term*> terms;
+    std::unordered_map<uint32_t, PostingList> grams;
+
+    static uint32_t gramAt(const std::string& s, size_t pos) {
+        return (static_cast<uint32_t>(static_cast<unsigned char>(s[pos])) << 16) |
+            (static_cast<uint32_t>(static_cast<unsigned char>(s[pos + 1])) << 8) |
+            static_cast<uint32_t>(static_cast<unsigned char>(s[pos + 2]));
+    }
+
+public:
+    static const size_t GRAM = 3;
+
+    void build(const HashIndex& dictionary);
+
+    // Добавление нового значения словаря (после HashIndex::add)
+    void add(const Term& term);
+
+    // Номера значений, которые могут содержать pattern (по возрастанию)
+    std::vector<uint32_t> candidates(const std::string& pattern) const;
+
+    // Значения, действительно содержащие pattern
+    template<typename Fn>
+    void forEachMatch(const std::string& pattern, Fn&& fn) const {
+        for (uint32_t id : candidates(pattern)) {
+            const Term& term = *terms[id];
+            if (containsSubstring(term.first, pattern)) {
+                fn(term.first, term.second);
+            }
+        }
+    }
+
+    const Term& term(uint32_t id) const { return *terms[id]; }
+    size_t termCount() const { return terms.size(); }
+    size_t gramCount() const { return grams.size(); }
+    size_t memoryBytes() const;
+    bool empty() const { return terms.empty(); }
+    void clear();
+};
+
+#endif // NGRAM_INDEX_H
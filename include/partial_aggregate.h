@@ -0,0 +1,112 @@
+﻿#ifndef PARTIAL_AGGREGATE_H
+#define PARTIAL_AGGREGATE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include "log_entry.h"
+#include "log_index.h"
+#include "rollup_cube.h"
+
+// Частичные агрегаты для анализа логов по частям (шардам): каждый
+// процесс считает агрегаты своей части, координатор их складывает.
+// Точные счётчики (записи, статусы, методы, куб) и HyperLogLog
+// сливаются сложением и максимумом, поэтому не зависят от разбиения и
+// порядка слияния и совпадают с анализом всех данных сразу. Сводка
+// частых значений при слиянии отсекается, и её оценки от разбиения и
+// порядка зависят; от них не зависит только граница ошибки.
+
+// Частые значения (Misra-Gries): хранится не больше 2k счётчиков; при
+// переполнении из всех вычитается (k+1)-й по величине, и остаётся не
+// больше k. Оценка занижена не более чем на errorBound() <= N/(k+1),
+// поэтому значение, встречающееся чаще N/(k+1) раз, в сводке есть.
+class TopKSketch {
+private:
+    std::unordered_map<std::string, uint64_t, WindowsStringHash> counters;
+    size_t capacity;
+    uint64_t error = 0;
+
+    // Вычитание (keep+1)-го по величине счётчика из всех
+    void prune(size_t keep);
+
+public:
+    explicit TopKSketch(size_t k = 1024);
+
+    // Потоковое добавление
+    void add(const std::string& key, uint64_t count = 1);
+
+    // Сводка по точным счётчикам: k наибольших, ошибка - (k+1)-й
+    void assign(std::vector<std::pair<std::string, uint64_t>> counts);
+
+    void merge(const TopKSketch& other);
+
+    // Первые n значений по убыванию оценки
+    std::vector<std::pair<std::string, uint64_t>> top(size_t n) const;
+    uint64_t estimate(const std::string& key) const;
+    uint64_t errorBound() const { return error; }
+    size_t size() const { return counters.size(); }
+
+    // Счётчики по возрастанию ключа (одинаковые сводки - одинаковые байты)
+    void serialize(std::string& out) const;
+    bool deserialize(std::string_view data, size_t& pos);
+    void clear();
+};
+
+// Число различных значений (HyperLogLog, 2^14 регистров, стандартная
+// ошибка около 0.8%). Слияние - максимум по регистрам; малые мощности
+// оцениваются линейным подсчётом по пустым регистрам.
+class HyperLogLog {
+public:
+    static const int PRECISION = 14;
+    static const size_t REGISTERS = static_cast<size_t>(1) << PRECISION;
+
+private:
+    std::vector<uint8_t> registers;
+
+public:
+    HyperLogLog() : registers(REGISTERS, 0) {}
+
+    void add(std::string_view value);
+    void merge(const HyperLogLog& other);
+    uint64_t estimate() const;
+
+    // 64-битный хэш, одинаковый во всех процессах
+    static uint64_t hash(std::string_view value);
+
+    // Немного заполненных регистров - парами (номер, значение), иначе все
+    void serialize(std::string& out) const;
+    bool deserialize(std::string_view data, size_t& pos);
+    void clear();
+};
+
+// Агрегаты части логов
+struct PartialAggregate {
+    uint64_t rows = 0;
+    int64_t firstEpoch = 0;     // время первой и последней записи (при rows > 0)
+    int64_t lastEpoch = 0;
+    std::map<int, uint64_t> statuses;
+    std::map<std::string, uint64_t> methods;
+    TopKSketch topIPs;
+    TopKSketch topURLs;
+    HyperLogLog uniqueIPs;
+    HyperLogLog uniqueURLs;
+    RollupCube rollup;
+
+    explicit PartialAggregate(size_t sketchSize = 1024)
+        : topIPs(sketchSize), topURLs(sketchSize) {}
+
+    // Потоковый учёт записи (без индексов)
+    void add(const LogEntry& entry);
+    void merge(const PartialAggregate& other);
+
+    // Двоичный формат: "LPA1", счётчики и сводки (varint), затем куб
+    std::string serialize() const;
+    bool deserialize(std::string_view data);
+};
+
+#endif // PARTIAL_AGGREGATE_H
@@ -0,0 +1,97 @@
+﻿#ifndef PATH_TRIE_H
+#define PATH_TRIE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include "log_entry.h"
+#include "log_index.h"
+
+// Разбор URL без выделения памяти (представления указывают в строку url)
+// Домен: "http://example.com/path" -> "example.com"
+std::string_view urlDomainView(std::string_view url);
+// Путь без строки запроса: "https://google.com/search?q=1" -> "/search"
+std::string_view urlPathView(std::string_view url);
+
+// Дерево путей URL: узел - сегмент пути между '/', сегменты хранятся
+// один раз (номер в словаре). Каждый узел знает число запросов и классов
+// статусов во всём своём поддереве, поэтому вопрос "сколько запросов ушло
+// в /api/v1/" решается спуском по сегментам префикса - O(глубина).
+// Схема, домен и строка запроса (?...) в путь не входят.
+class PathTrie {
+public:
+    using NodeId = uint32_t;
+    static const NodeId ROOT = 0;
+    static const NodeId NONE = 0xFFFFFFFF;
+
+    // Счётчики поддерева
+    struct Counts {
+        uint64_t requests = 0;
+        uint64_t statusClasses[6] = {};  // [1]..[5] - 1xx..5xx, [0] - прочие
+    };
+
+    // Дочерний узел для детализации по уровню
+    struct Child {
+        std::string path;  // полный путь узла, например "/api/v1"
+        NodeId node = NONE;
+        Counts counts;
+    };
+
+private:
+    struct Node {
+        uint32_t segment = 0;
+        NodeId parent = NONE;
+        NodeId firstChild = NONE;
+        NodeId nextSibling = NONE;
+        uint32_t depth = 0;
+        Counts counts;
+        PostingList rows;  // записи, путь которых заканчивается в узле
+    };
+
+    std::vector<Node> nodes;
+    std::deque<std::string> segments;  // deque: адреса строк не меняются
+    std::unordered_map<std::string_view, uint32_t, WindowsStringHash> segmentIds;
+    std::unordered_map<uint64_t, NodeId> edges;  // (родитель, сегмент) -> узел
+    std::unordered_map<std::string, NodeId, WindowsStringHash> urlNodes;  // кэш по полному URL
+
+    NodeId insertPath(std::string_view path);
+    NodeId child(NodeId parent, std::string_view segment) const;
+
+    static uint64_t edgeKey(NodeId parent, uint32_t segment) {
+        return (static_cast<uint64_t>(parent) << 32) | segment;
+    }
+
+public:
+    PathTrie() { clear(); }
+
+    void build(const std::vector<LogEntry>& logs);
+
+    // Добавление записи (номер больше всех уже добавленных)
+    void add(const LogEntry& entry, RowId row);
+
+    // Узел префикса пути ("/api/v1", "/api/v1/" и "api/v1" равнозначны);
+    // сравнение по целым сегментам: "/api" не совпадает с "/apix"
+    NodeId find(std::string_view prefix) const;
+
+    const Counts& counts(NodeId node) const { return nodes[node].counts; }
+    Counts prefixCounts(std::string_view prefix) const;
+
+    // Прямые потомки префикса, по убыванию числа запросов
+    std::vector<Child> children(std::string_view prefix) const;
+
+    // Все записи поддерева по возрастанию номеров
+    std::vector<RowId> rowsUnder(NodeId node) const;
+
+    std::string pathOf(NodeId node) const;
+    uint32_t depthOf(NodeId node) const { return nodes[node].depth; }
+
+    size_t nodeCount() const { return nodes.size(); }
+    size_t segmentCount() const { return segments.size(); }
+    size_t memoryBytes() const;
+    void clear();
+};
+
+#endif // PATH_TRIE_H
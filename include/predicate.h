@@ -0,0 +1,270 @@
+﻿#ifndef PREDICATE_H
+#define PREDICATE_H
+
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+#include "columns.h"
+#include "ngram_index.h"
+#include "analyzer.h"
+
+// Предикаты-шаблоны (expression templates) для LogAnalyzer::where и count.
+//
+//   analyzer.where(Status() >= 500 && Method() == "POST");
+//   analyzer.count(Time() >= "2025-03-14T08:00:00Z" && !(IP() == "10.0.0.1"));
+//   analyzer.where(Status() == 404 && Row([](const LogEntry& e) { ... }));
+//
+// Выражение разворачивается компилятором в один тип без виртуальных
+// вызовов. Условия проверяются блоками по PREDICATE_BLOCK записей:
+// сравнения с колонками - простые циклы по массивам, которые компилятор
+// векторизует, а &&, || и ! объединяют байтовые маски блока.
+
+namespace Predicates {
+
+    // Базовый класс выражений (CRTP): операторы &&, || и ! определены
+    // только для наследников, чтобы не перехватывать чужие типы
+    template<typename Derived>
+    struct Expr {
+        const Derived& self() const { return static_cast<const Derived&>(*this); }
+    };
+
+    // ==================== Сравнения ====================
+
+    struct Equal { template<typename T> static bool apply(T a, T b) { return a == b; } };
+    struct NotEqual { template<typename T> static bool apply(T a, T b) { return a != b; } };
+    struct Less { template<typename T> static bool apply(T a, T b) { return a < b; } };
+    struct LessEqual { template<typename T> static bool apply(T a, T b) { return a <= b; } };
+    struct Greater { template<typename T> static bool apply(T a, T b) { return a > b; } };
+    struct GreaterEqual { template<typename T> static bool apply(T a, T b) { return a >= b; } };
+
+    // Сравнение числовой колонки с константой
+    template<typename Column, typename Cmp>
+    struct ColumnCompare : Expr<ColumnCompare<Column, Cmp>> {
+        using Value = typename Column::Value;
+        Value value;
+
+        explicit ColumnCompare(Value v) : value(v) {}
+
+        void evalBlock(const ColumnView& view, size_t begin, size_t n, uint8_t* mask) const {
+            const Value* column = Column::data(view) + begin;
+            const Value v = value;
+            for (size_t i = 0; i < n; i++) {
+                mask[i] = static_cast<uint8_t>(Cmp::apply(column[i], v));
+            }
+        }
+    };
+
+    // ==================== Колонки ====================
+
+    // Статус; константы вне диапазона uint16_t приводятся к границам
+    struct Status {
+        using Value = uint16_t;
+        static const Value* data(const ColumnView& view) { return view.status; }
+
+        static Value clamp(int v) {
+            return static_cast<Value>(v < 0 ? 0 : (v > 0xFFFF ? 0xFFFF : v));
+        }
+    };
+
+    inline ColumnCompare<Status, Equal> operator==(Status, int v) {
+        return ColumnCompare<Status, Equal>(Status::clamp(v));
+    }
+    inline ColumnCompare<Status, NotEqual> operator!=(Status, int v) {
+        return ColumnCompare<Status, NotEqual>(Status::clamp(v));
+    }
+    inline ColumnCompare<Status, Less> operator<(Status, int v) {
+        return ColumnCompare<Status, Less>(Status::clamp(v));
+    }
+    inline ColumnCompare<Status, LessEqual> operator<=(Status, int v) {
+        return ColumnCompare<Status, LessEqual>(Status::clamp(v));
+    }
+    inline ColumnCompare<Status, Greater> operator>(Status, int v) {
+        return ColumnCompare<Status, Greater>(Status::clamp(v));
+    }
+    inline ColumnCompare<Status, GreaterEqual> operator>=(Status, int v) {
+        return ColumnCompare<Status, GreaterEqual>(Status::clamp(v));
+    }
+
+    // Время записи в секундах от 1970-01-01; константа - строка ISO 8601.
+    // Неполное время ("2025-03-14") - период целиком: Time() <= "2025-03-14"
+    // включает весь день, Time() > "2025-03-14" - начиная со следующего.
+    // Строка, не являющаяся временем, - исключение invalid_argument
+    struct Time {
+        using Value = int64_t;
+        static const Value* data(const ColumnView& view) { return view.epoch; }
+
+        static Value bound(const std::string& ts, bool upper) {
+            int64_t epoch = 0;
+            if (!TimeUtils::boundToEpoch(ts, upper, epoch)) {
+                throw std::invalid_argument("Некорректное время: " + ts);
+            }
+            return epoch;
+        }
+    };
+
+    inline ColumnCompare<Time, Less> operator<(Time, const std::string& ts) {
+        return ColumnCompare<Time, Less>(Time::bound(ts, false));
+    }
+    inline ColumnCompare<Time, LessEqual> operator<=(Time, const std::string& ts) {
+        return ColumnCompare<Time, LessEqual>(Time::bound(ts, true));
+    }
+    inline ColumnCompare<Time, Greater> operator>(Time, const std::string& ts) {
+        return ColumnCompare<Time, Greater>(Time::bound(ts, true));
+    }
+    inline ColumnCompare<Time, GreaterEqual> operator>=(Time, const std::string& ts) {
+        return ColumnCompare<Time, GreaterEqual>(Time::bound(ts, false));
+    }
+
+    // Метод: известные методы сравниваются по коду в колонке,
+    // нестандартные - по строке записи без учёта регистра
+    struct Method {};
+
+    struct MethodEquals : Expr<MethodEquals> {
+        std::string name;
+        uint8_t code;
+        bool negate;
+
+        MethodEquals(const std::string& n, bool neg)
+            : name(n), code(static_cast<uint8_t>(methodCode(n))), negate(neg) {
+        }
+
+        void evalBlock(const ColumnView& view, size_t begin, size_t n, uint8_t* mask) const {
+            if (code != static_cast<uint8_t>(HttpMethod::Other)) {
+                const uint8_t* column = view.method + begin;
+                const uint8_t c = code;
+                const uint8_t flip = negate ? 1 : 0;
+                for (size_t i = 0; i < n; i++) {
+                    mask[i] = static_cast<uint8_t>((column[i] == c) ^ flip);
+                }
+                return;
+            }
+            for (size_t i = 0; i < n; i++) {
+                const std::string& method = view.rows[begin + i].method;
+                bool same = method.size() == name.size();
+                for (size_t k = 0; same && k < name.size(); k++) {
+                    same = toupper(static_cast<unsigned char>(method[k])) ==
+                        toupper(static_cast<unsigned char>(name[k]));
+                }
+                mask[i] = static_cast<uint8_t>(same != negate);
+            }
+        }
+    };
+
+    inline MethodEquals operator==(Method, const std::string& name) { return MethodEquals(name, false); }
+    inline MethodEquals operator!=(Method, const std::string& name) { return MethodEquals(name, true); }
+
+    // Строковые колонки проверяются по записям, но без std::function
+    struct IP {};
+    struct URL {
+        struct Contains : Expr<Contains> {
+            std::string pattern;
+            explicit Contains(const std::string& p) : pattern(p) {}
+
+            void evalBlock(const ColumnView& view, size_t begin, size_t n, uint8_t* mask) const {
+                for (size_t i = 0; i < n; i++) {
+                    mask[i] = static_cast<uint8_t>(containsSubstring(view.rows[begin + i].url, pattern));
+                }
+            }
+        };
+
+        Contains contains(const std::string& pattern) const { return Contains(pattern); }
+    };
+
+    struct IPEquals : Expr<IPEquals> {
+        std::string address;
+        bool negate;
+
+        IPEquals(const std::string& a, bool neg) : address(a), negate(neg) {}
+
+        void evalBlock(const ColumnView& view, size_t begin, size_t n, uint8_t* mask) const {
+            for (size_t i = 0; i < n; i++) {
+                mask[i] = static_cast<uint8_t>((view.rows[begin + i].ip == address) != negate);
+            }
+        }
+    };
+
+    inline IPEquals operator==(IP, const std::string& address) { return IPEquals(address, false); }
+    inline IPEquals operator!=(IP, const std::string& address) { return IPEquals(address, true); }
+
+    // Произвольное условие над записью: вызов встраивается в цикл блока
+    template<typename Fn>
+    struct RowPredicate : Expr<RowPredicate<Fn>> {
+        Fn fn;
+        explicit RowPredicate(Fn f) : fn(std::move(f)) {}
+
+        void evalBlock(const ColumnView& view, size_t begin, size_t n, uint8_t* mask) const {
+            for (size_t i = 0; i < n; i++) {
+                mask[i] = static_cast<uint8_t>(fn(view.rows[begin + i]) ? 1 : 0);
+            }
+        }
+    };
+
+    template<typename Fn>
+    RowPredicate<Fn> Row(Fn fn) {
+        return RowPredicate<Fn>(std::move(fn));
+    }
+
+    // ==================== Логические операции ====================
+
+    template<typename L, typename R>
+    struct AndExpr : Expr<AndExpr<L, R>> {
+        L left;
+        R right;
+        AndExpr(const L& l, const R& r) : left(l), right(r) {}
+
+        void evalBlock(const ColumnView& view, size_t begin, size_t n, uint8_t* mask) const {
+            uint8_t other[PREDICATE_BLOCK];
+            left.evalBlock(view, begin, n, mask);
+            right.evalBlock(view, begin, n, other);
+            for (size_t i = 0; i < n; i++) {
+                mask[i] &= other[i];
+            }
+        }
+    };
+
+    template<typename L, typename R>
+    struct OrExpr : Expr<OrExpr<L, R>> {
+        L left;
+        R right;
+        OrExpr(const L& l, const R& r) : left(l), right(r) {}
+
+        void evalBlock(const ColumnView& view, size_t begin, size_t n, uint8_t* mask) const {
+            uint8_t other[PREDICATE_BLOCK];
+            left.evalBlock(view, begin, n, mask);
+            right.evalBlock(view, begin, n, other);
+            for (size_t i = 0; i < n; i++) {
+                mask[i] |= other[i];
+            }
+        }
+    };
+
+    template<typename E>
+    struct NotExpr : Expr<NotExpr<E>> {
+        E inner;
+        explicit NotExpr(const E& e) : inner(e) {}
+
+        void evalBlock(const ColumnView& view, size_t begin, size_t n, uint8_t* mask) const {
+            inner.evalBlock(view, begin, n, mask);
+            for (size_t i = 0; i < n; i++) {
+                mask[i] ^= 1;
+            }
+        }
+    };
+
+    template<typename L, typename R>
+    AndExpr<L, R> operator&&(const Expr<L>& l, const Expr<R>& r) {
+        return AndExpr<L, R>(l.self(), r.self());
+    }
+
+    template<typename L, typename R>
+    OrExpr<L, R> operator||(const Expr<L>& l, const Expr<R>& r) {
+        return OrExpr<L, R>(l.self(), r.self());
+    }
+
+    template<typename E>
+    NotExpr<E> operator!(const Expr<E>& e) {
+        return NotExpr<E>(e.self());
+    }
+};
+
+#endif // PREDICATE_H
@@ -0,0 +1,124 @@
+﻿#ifndef QUERY_H
+#define QUERY_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "log_entry.h"
+#include "log_index.h"
+
+// Составные запросы к логам: условия собираются в один план,
+// который выполняется за один проход и возвращает выборку номеров записей
+
+// Выборка - номера записей по возрастанию поверх данных анализатора.
+// Записи не копируются; выборка действительна, пока не изменился LogAnalyzer.
+class Selection {
+private:
+    const std::vector<LogEntry>* source = nullptr;
+    std::vector<RowId> rows;
+
+public:
+    Selection() = default;
+    Selection(const std::vector<LogEntry>& logs, std::vector<RowId> rowIds)
+        : source(&logs), rows(std::move(rowIds)) {
+    }
+
+    size_t size() const { return rows.size(); }
+    bool empty() const { return rows.empty(); }
+
+    RowId rowId(size_t i) const { return rows[i]; }
+    const LogEntry& at(size_t i) const { return (*source)[rows[i]]; }
+    const LogEntry& operator[](size_t i) const { return at(i); }
+
+    const std::vector<RowId>& rowIds() const { return rows; }
+    const std::vector<LogEntry>& sourceLogs() const { return *source; }
+
+    // Обход записей выборки без копирования
+    template<typename Fn>
+    void forEach(Fn&& fn) const {
+        for (RowId row : rows) {
+            fn((*source)[row]);
+        }
+    }
+
+    // Копирование записей (только когда действительно нужен вектор)
+    std::vector<LogEntry> materialize() const;
+};
+
+// Описание запроса: все заданные условия объединяются через AND,
+// значения внутри списков статусов и методов - через OR
+struct LogQuery {
+    std::vector<int> statuses;
+    int minStatus = 0;          // 0 - без ограничения
+    int maxStatus = 0;          // 0 - без ограничения
+    std::vector<std::string> methods;  // без учёта регистра
+    std::string ip;             // точное совпадение
+    std::string urlSubstring;   // подстрока URL
+    std::string timeStart;      // пустая строка - без ограничения
+    std::string timeEnd;
+
+    // Построение запроса цепочкой вызовов
+    LogQuery& status(int code) { statuses.push_back(code); return *this; }
+    LogQuery& statusRange(int from, int to) { minStatus = from; maxStatus = to; return *this; }
+    LogQuery& method(const std::string& name) { methods.push_back(name); return *this; }
+    LogQuery& fromIP(const std::string& address) { ip = address; return *this; }
+    LogQuery& urlContains(const std::string& pattern) { urlSubstring = pattern; return *this; }
+    LogQuery& timeRange(const std::string& from, const std::string& to) {
+        timeStart = from;
+        timeEnd = to;
+        return *this;
+    }
+
+    bool hasStatusFilter() const { return !statuses.empty() || minStatus > 0 || maxStatus > 0; }
+    bool hasTimeFilter() const { return !timeStart.empty() || !timeEnd.empty(); }
+    bool isEmpty() const {
+        return !hasStatusFilter() && methods.empty() && ip.empty() &&
+            urlSubstring.empty() && !hasTimeFilter();
+    }
+
+    std::string toString() const;
+};
+
+// Условия запроса, подготовленные для проверки отдельных записей без
+// индексов: методы в верхнем регистре, границы времени заданы полным
+// временем - сравниваются epoch-секунды, иначе строки
+struct QueryFilter {
+    const LogQuery& query;
+    std::vector<std::string> upperMethods;
+    bool epochBounds = false;
+    int64_t from = INT64_MIN;
+    int64_t to = INT64_MAX;
+
+    explicit QueryFilter(const LogQuery& q);
+
+    bool statusMatches(int status) const;
+    bool methodMatches(const std::string& method) const;
+    bool timeMatches(const std::string& timestamp) const;
+
+    // Все условия запроса
+    bool matches(const LogEntry& entry) const;
+};
+
+// План выполнения: источник кандидатов и условия, проверяемые по записям
+struct QueryPlan {
+    enum class Source {
+        Empty,      // заведомо пустой результат
+        FullScan,   // условий нет или индексы не помогают
+        IPIndex,    // список записей IP из хэш-индекса
+        TimeIndex,  // диапазон индекса времени
+        Bitmap,     // битовые карты статуса/метода
+        URLIndex    // записи подходящих уникальных URL
+    };
+
+    Source source = Source::FullScan;
+    size_t candidates = 0;      // число кандидатов из источника
+    bool checkStatus = false;   // проверки, оставшиеся после источника
+    bool checkMethod = false;
+    bool checkIP = false;
+    bool checkURL = false;
+    bool checkTime = false;
+
+    std::string describe() const;
+};
+
+#endif // QUERY_H
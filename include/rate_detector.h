@@ -0,0 +1,63 @@
+﻿#ifndef RATE_DETECTOR_H
+#define RATE_DETECTOR_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Потоковый поиск всплесков запросов по IP: больше maxRequests запросов
+// за какие-либо windowSeconds секунд.
+//
+// Для каждого IP хранится 24 байта: упакованный адрес, начало текущего
+// интервала длины W и счётчики текущего и предыдущего интервалов.
+// Запросы, попавшие в любое окно (t - W, t], лежат в этих двух интервалах,
+// поэтому сумма счётчиков не меньше истинного числа запросов в окне:
+// всплеск не пропускается, а найденные кандидаты проверяются точно.
+//
+// Таблица фиксированного размера (memoryBudget байт) с открытой адресацией:
+// IP без запросов за последние 2W секунд освобождают место, а если
+// свободного места нет, вытесняется самый давно активный IP из группы проб.
+class RateDetector {
+private:
+    struct Slot {
+        uint64_t key = 0;         // 0 - свободно
+        int64_t windowStart = 0;  // начало текущего интервала
+        uint32_t previous = 0;
+        uint32_t current = 0;
+    };
+
+    std::vector<Slot> slots;
+    size_t mask = 0;
+    uint32_t maxRequests;
+    int64_t window;
+    size_t used = 0;
+    size_t evicted = 0;
+
+    static const size_t PROBES = 8;
+
+public:
+    static const size_t DEFAULT_MEMORY = 32u << 20;  // 32 МБ, ~1.4 млн IP
+
+    RateDetector(uint32_t maxRequests, int64_t windowSeconds,
+        size_t memoryBudget = DEFAULT_MEMORY);
+
+    // Учёт запроса (время должно в основном не убывать). Возвращает true,
+    // если в окне, заканчивающемся этим запросом, может быть больше
+    // maxRequests запросов этого IP.
+    bool observe(uint64_t key, int64_t epoch);
+
+    // Ключ IP: IPv4 - сам адрес, IPv6 и прочие строки - 64-битный хэш (не 0)
+    static uint64_t packIP(const std::string& ip);
+
+    size_t capacity() const { return slots.size(); }
+    size_t trackedIPs() const { return used; }
+    size_t evictions() const { return evicted; }   // > 0 - бюджет памяти мал
+    size_t memoryBytes() const { return slots.capacity() * sizeof(Slot); }
+};
+
+// Наибольшее число запросов в окне windowSeconds по списку времён (точно).
+// Времена могут быть не упорядочены.
+uint32_t maxRequestsInWindow(std::vector<int64_t> epochs, int64_t windowSeconds);
+
+#endif // RATE_DETECTOR_H
@@ -0,0 +1,129 @@
+﻿#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <typeindex>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+// Кэш результатов запросов с вытеснением давно не использованных (LRU).
+//
+// Ключ - строка запроса с параметрами ("statusDistribution",
+// "topSubnets:24:10:64"), к нему добавляется версия данных: любое
+// изменение данных увеличивает версию, и все записи старой версии
+// сбрасываются при первом обращении с новой. Суммарный размер
+// результатов ограничен бюджетом памяти.
+//
+// Результаты хранятся как неизменяемые объекты; обращения из нескольких
+// потоков сериализуются мьютексом.
+class ResultCache {
+public:
+    static const size_t DEFAULT_BUDGET = 64u << 20;  // 64 МБ
+
+private:
+    struct Entry {
+        std::string key;
+        std::type_index type;
+        std::shared_ptr<const void> value;
+        size_t bytes;
+    };
+    using List = std::list<Entry>;
+
+    size_t budget;
+    size_t used = 0;
+    uint64_t version = 0;       // версия данных текущих записей
+    List entries;               // от недавно использованных к давним
+    std::unordered_map<std::string, List::iterator> lookup;
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+    uint64_t evictionCount = 0;
+    mutable std::mutex mutex;
+
+    std::shared_ptr<const void> findEntry(const std::string& key, std::type_index type,
+        uint64_t dataVersion);
+    void storeEntry(const std::string& key, std::type_index type,
+        std::shared_ptr<const void> value, size_t bytes, uint64_t dataVersion);
+
+    // Вызываются под мьютексом
+    bool switchVersion(uint64_t dataVersion);
+    void evictTo(size_t limit);
+    void dropAll();
+
+public:
+    explicit ResultCache(size_t budgetBytes = DEFAULT_BUDGET);
+
+    // Копия анализатора начинает с пустого кэша того же бюджета
+    ResultCache(const ResultCache& other);
+    ResultCache& operator=(const ResultCache& other);
+
+    // Результат для ключа и версии данных или nullptr
+    template<typename T>
+    std::shared_ptr<const T> find(const std::string& key, uint64_t dataVersion) {
+        return std::static_pointer_cast<const T>(findEntry(key, typeid(T), dataVersion));
+    }
+
+    // Сохранение результата; bytes - оценка занимаемой им памяти
+    template<typename T>
+    std::shared_ptr<const T> store(const std::string& key, uint64_t dataVersion,
+        T value, size_t bytes) {
+        auto stored = std::make_shared<const T>(std::move(value));
+        storeEntry(key, typeid(T), stored, bytes, dataVersion);
+        return stored;
+    }
+
+    void clear();
+    void setBudget(size_t budgetBytes);
+
+    size_t budgetBytes() const;
+    size_t memoryBytes() const;
+    size_t size() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+    uint64_t evictions() const;
+};
+
+// Оценка памяти результата для бюджета кэша
+inline size_t resultBytes(const std::string& value) {
+    return sizeof(value) + value.capacity();
+}
+
+template<typename T>
+size_t resultBytes(const T&) {
+    return sizeof(T);
+}
+
+template<typename A, typename B>
+size_t resultBytes(const std::pair<A, B>& value);
+
+template<typename T>
+size_t resultBytes(const std::vector<T>& values) {
+    size_t bytes = sizeof(values) + (values.capacity() - values.size()) * sizeof(T);
+    for (const auto& value : values) {
+        bytes += resultBytes(value);
+    }
+    return bytes;
+}
+
+template<typename K, typename V>
+size_t resultBytes(const std::map<K, V>& values) {
+    // Узел дерева: три указателя и цвет
+    size_t bytes = sizeof(values);
+    for (const auto& [key, value] : values) {
+        bytes += 4 * sizeof(void*) + resultBytes(key) + resultBytes(value);
+    }
+    return bytes;
+}
+
+template<typename A, typename B>
+size_t resultBytes(const std::pair<A, B>& value) {
+    return resultBytes(value.first) + resultBytes(value.second);
+}
+
+#endif // RESULT_CACHE_H
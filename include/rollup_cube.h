@@ -0,0 +1,102 @@
+﻿#ifndef ROLLUP_CUBE_H
+#define ROLLUP_CUBE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "columns.h"
+#include "log_index.h"
+
+// Куб счётчиков по времени: минута x класс статуса x метод, а также
+// часовой и суточный уровни, которые пополняются вместе с минутами.
+// Запрос за интервал складывает целые сутки, затем часы и минуты
+// по краям, поэтому не зависит от числа записей: для недели это
+// несколько десятков интервалов вместо прохода по всем строкам.
+class RollupCube {
+public:
+    static const int STATUS_CLASSES = 6;   // 0 - прочие, 1..5 - 1xx..5xx
+    static const int METHODS = 10;         // HttpMethod
+    static const int CELLS = STATUS_CLASSES * METHODS;
+
+    enum class Level { Minute, Hour, Day };
+
+    static int cellOf(int statusClass, HttpMethod method) {
+        return statusClass * METHODS + static_cast<int>(method);
+    }
+
+    // Сумма счётчиков за интервал (результат запроса)
+    struct Counts {
+        uint64_t cells[CELLS] = {};
+
+        uint64_t total() const;
+        uint64_t statusClass(int cls) const;
+        uint64_t method(HttpMethod method) const;
+        uint64_t at(int cls, HttpMethod method) const {
+            return cells[cellOf(cls, method)];
+        }
+    };
+
+private:
+    // Интервал уровня: начало (epoch-секунды) и счётчики ячеек
+    template<typename Counter>
+    struct Bucket {
+        int64_t start = 0;
+        Counter cells[CELLS] = {};
+    };
+
+    // В минуте не больше 2^32 запросов; в часе и сутках - 64-битные счётчики
+    std::vector<Bucket<uint32_t>> minutes;
+    std::vector<Bucket<uint64_t>> hours;
+    std::vector<Bucket<uint64_t>> days;
+    uint64_t rows = 0;
+
+    // Интервал с началом start; записи обычно идут по времени - тогда
+    // это последний интервал или новый в конце
+    template<typename Counter>
+    static Bucket<Counter>& bucketAt(std::vector<Bucket<Counter>>& level, int64_t start);
+
+    // Слияние двух упорядоченных уровней за один проход
+    template<typename Counter>
+    static void mergeLevel(std::vector<Bucket<Counter>>& level,
+        const std::vector<Bucket<Counter>>& other);
+
+    // Сумма интервалов уровня с началом в [from, to)
+    void sumLevel(Level level, int64_t from, int64_t to, Counts& out) const;
+    void accumulate(Level level, int64_t from, int64_t to, Counts& out) const;
+
+public:
+    // Построение по колонкам в порядке индекса времени
+    void build(const TimeIndex& time, const LogColumns& columns);
+
+    // Учёт одной записи (в любом порядке по времени)
+    void add(int64_t epoch, int status, HttpMethod method);
+
+    // Прибавление счётчиков другого куба (части тех же данных,
+    // посчитанной отдельно); порядок слияния частей не важен
+    void merge(const RollupCube& other);
+
+    // Счётчики за [from, to] (epoch-секунды); границы расширяются до
+    // целых минут: учитываются минуты, содержащие from и to
+    Counts query(int64_t from, int64_t to) const;
+
+    // Непустые интервалы уровня в [from, to] для графиков
+    std::vector<std::pair<int64_t, Counts>> series(int64_t from, int64_t to, Level level) const;
+
+    // Двоичный формат: заголовок, затем по минутам - смещение от
+    // предыдущей минуты, маска ненулевых ячеек и их значения (varint).
+    // Часы и сутки при чтении восстанавливаются из минут.
+    std::string serialize() const;
+    bool deserialize(std::string_view data);
+    bool saveToFile(const std::string& filename) const;
+    bool loadFromFile(const std::string& filename);
+
+    uint64_t totalRows() const { return rows; }
+    size_t minuteCount() const { return minutes.size(); }
+    bool empty() const { return rows == 0; }
+    size_t memoryBytes() const;
+    void clear();
+};
+
+#endif // ROLLUP_CUBE_H
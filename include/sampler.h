@@ -0,0 +1,164 @@
+﻿#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+#include <random>
+#include <cstdint>
+#include <cstddef>
+#include "log_entry.h"
+#include "log_index.h"
+
+// Равномерная выборка записей для быстрых приблизительных ответов.
+//
+// Резервуар фиксированного размера пополняется алгоритмом L: номер
+// следующей записи, попадающей в выборку, вычисляется заранее, поэтому
+// при загрузке целого массива проверяются только выбранные записи -
+// O(k log(N/k)) вместо O(N). Дополнительно можно вести отдельный
+// резервуар на каждый класс статуса (стратификация), чтобы редкие
+// 5xx были представлены не хуже частых 2xx.
+//
+// Оценки числа записей возвращаются с доверительным интервалом
+// (Агрести-Коулл по каждой страте с поправкой на конечную совокупность);
+// если выборка совпадает со всеми записями, ответ точный.
+
+// Выполнение запроса: по выборке или по всем записям
+enum class QueryMode { Sampled, Exact };
+
+// Оценка с доверительным интервалом [low, high]
+struct Estimate {
+    double value = 0.0;
+    double low = 0.0;
+    double high = 0.0;
+    bool exact = false;
+
+    static Estimate exactly(double v) {
+        Estimate e;
+        e.value = e.low = e.high = v;
+        e.exact = true;
+        return e;
+    }
+
+    bool contains(double v) const { return v >= low && v <= high; }
+    double margin() const { return (high - low) / 2.0; }
+};
+
+class LogSampler {
+public:
+    static const size_t DEFAULT_CAPACITY = 16384;
+    static const int STRATA = 6;   // классы статусов 0..5 (см. BitmapIndex::classOf)
+
+private:
+    struct Reservoir {
+        std::vector<RowId> rows;
+        uint64_t seen = 0;          // записей, прошедших через резервуар
+        uint64_t nextPick = 0;      // номер (среди seen) следующей выбранной записи
+        double w = 1.0;             // состояние алгоритма L
+    };
+
+    size_t capacity;
+    bool stratified;
+    double confidence;
+    double z;                       // квантиль нормального распределения
+    uint64_t seed;
+    std::mt19937_64 rng;
+    Reservoir uniform;
+    Reservoir strata[STRATA];
+
+    double randomUnit();
+    void scheduleNext(Reservoir& reservoir);
+    void offer(Reservoir& reservoir, RowId row);
+
+    // Страты для оценок: один равномерный резервуар или непустые классы
+    std::vector<const Reservoir*> estimationStrata() const;
+
+    // Объединение числа попаданий по стратам в оценку
+    Estimate combine(const std::vector<const Reservoir*>& parts,
+        const std::vector<uint64_t>& hits) const;
+
+public:
+    explicit LogSampler(size_t capacity = DEFAULT_CAPACITY, bool stratified = false,
+        double confidence = 0.95, uint64_t seed = 42);
+
+    // Выборка по всем записям (пересоздаётся)
+    void build(const std::vector<LogEntry>& logs);
+
+    // Очередная запись при потоковой загрузке; номера строго возрастают
+    void add(RowId row, int status);
+
+    void clear();
+
+    uint64_t population() const { return uniform.seen; }
+    const std::vector<RowId>& rows() const { return uniform.rows; }
+    const std::vector<RowId>& stratumRows(int statusClass) const { return strata[statusClass].rows; }
+    uint64_t stratumPopulation(int statusClass) const { return strata[statusClass].seen; }
+
+    bool isStratified() const { return stratified; }
+    size_t getCapacity() const { return capacity; }
+    double getConfidence() const { return confidence; }
+    size_t memoryBytes() const;
+
+    // Число записей, для которых predicate(запись) истинно
+    template<typename Predicate>
+    Estimate estimateCount(const std::vector<LogEntry>& logs, Predicate&& predicate) const;
+
+    // Число записей по значениям key(запись), по убыванию оценки;
+    // n <= 0 - все встретившиеся в выборке значения
+    template<typename KeyFn>
+    auto estimateCounts(const std::vector<LogEntry>& logs, KeyFn&& key, int n = 0) const
+        -> std::vector<std::pair<std::decay_t<decltype(key(logs[0]))>, Estimate>>;
+};
+
+template<typename Predicate>
+Estimate LogSampler::estimateCount(const std::vector<LogEntry>& logs, Predicate&& predicate) const {
+    std::vector<const Reservoir*> parts = estimationStrata();
+    std::vector<uint64_t> hits(parts.size(), 0);
+
+    for (size_t h = 0; h < parts.size(); h++) {
+        for (RowId row : parts[h]->rows) {
+            if (predicate(logs[row])) hits[h]++;
+        }
+    }
+
+    return combine(parts, hits);
+}
+
+template<typename KeyFn>
+auto LogSampler::estimateCounts(const std::vector<LogEntry>& logs, KeyFn&& key, int n) const
+    -> std::vector<std::pair<std::decay_t<decltype(key(logs[0]))>, Estimate>> {
+    using Key = std::decay_t<decltype(key(logs[0]))>;
+
+    std::vector<const Reservoir*> parts = estimationStrata();
+    std::unordered_map<Key, std::vector<uint64_t>> hits;
+
+    for (size_t h = 0; h < parts.size(); h++) {
+        for (RowId row : parts[h]->rows) {
+            std::vector<uint64_t>& counts = hits[key(logs[row])];
+            counts.resize(parts.size(), 0);
+            counts[h]++;
+        }
+    }
+
+    std::vector<std::pair<Key, Estimate>> result;
+    result.reserve(hits.size());
+    for (const auto& [value, counts] : hits) {
+        result.emplace_back(value, combine(parts, counts));
+    }
+
+    std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+        if (a.second.value != b.second.value) return a.second.value > b.second.value;
+        return a.first < b.first;
+    });
+
+    if (n > 0 && static_cast<size_t>(n) < result.size()) {
+        result.resize(static_cast<size_t>(n));
+    }
+
+    return result;
+}
+
+#endif // SAMPLER_H
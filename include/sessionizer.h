@@ -0,0 +1,102 @@
+﻿#ifndef SESSIONIZER_H
+#define SESSIONIZER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// Сессии посещений по IP: сессия закрывается, если следующий запрос
+// пришёл позже чем через gapSeconds после предыдущего.
+//
+// Записи подаются по возрастанию времени за один проход. Открытые сессии
+// лежат в плотном массиве с открытой адресацией по упакованному IP,
+// истечение отслеживает колесо таймеров: сессия записана в ячейку
+// момента истечения и проверяется, только когда колесо доходит до неё
+// (продлённая запросом сессия переносится в новую ячейку лениво).
+// Память пропорциональна числу одновременно открытых сессий.
+
+// Итог закрытой сессии
+struct Session {
+    std::string ip;
+    int64_t start = 0;      // первый и последний запрос (epoch-секунды)
+    int64_t end = 0;
+    uint32_t requests = 0;  // страниц за сессию
+    uint32_t errors = 0;    // ответов со статусом >= 400
+
+    int64_t duration() const { return end - start; }
+};
+
+class Sessionizer {
+public:
+    using Sink = std::function<void(const Session&)>;
+
+private:
+    static const uint32_t NONE = 0xFFFFFFFF;
+    static const int64_t WHEEL_SLOTS = 256;
+
+    struct OpenSession {
+        uint64_t key = 0;
+        Session session;
+        uint32_t next = NONE;   // следующая сессия в ячейке колеса
+        bool open = false;
+    };
+
+    int64_t gap;
+    int64_t tick;               // длительность ячейки колеса
+    Sink sink;
+
+    std::vector<OpenSession> sessions;
+    std::vector<uint32_t> freeList;
+    std::vector<uint32_t> index;    // номер сессии + 1, 0 - пусто
+    size_t mask = 0;
+    size_t openCount = 0;
+    size_t peakOpen = 0;
+
+    std::vector<uint32_t> wheel;    // первая сессия ячейки
+    int64_t currentTick = 0;
+    bool started = false;
+    int64_t now = 0;
+
+    size_t findSlot(uint64_t key) const;
+    void insertIndex(uint64_t key, uint32_t id);
+    void eraseIndex(uint64_t key);
+    void schedule(uint32_t id);
+    void close(uint32_t id);
+    void advance(int64_t epoch);
+
+public:
+    Sessionizer(int64_t gapSeconds, Sink sessionSink);
+
+    // Запрос ip в момент epoch; время не должно убывать
+    // (более ранние записи считаются пришедшими в текущий момент)
+    void add(const std::string& ip, int64_t epoch, int status);
+
+    // Закрытие всех открытых сессий в конце данных
+    void finish();
+
+    size_t openSessions() const { return openCount; }
+    size_t peakOpenSessions() const { return peakOpen; }
+};
+
+// Сводка по сессиям
+struct SessionStats {
+    size_t sessions = 0;
+    uint64_t requests = 0;
+    int64_t totalDuration = 0;
+    int64_t maxDuration = 0;
+    uint32_t maxRequests = 0;
+    std::unordered_map<std::string, int> sessionsPerIP;
+
+    void add(const Session& session);
+
+    double averageDuration() const { return sessions ? static_cast<double>(totalDuration) / sessions : 0.0; }
+    double pagesPerSession() const { return sessions ? static_cast<double>(requests) / sessions : 0.0; }
+
+    // IP с наибольшим числом сессий
+    std::vector<std::pair<std::string, int>> topIPs(size_t n = 10) const;
+};
+
+#endif // SESSIONIZER_H
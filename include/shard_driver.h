@@ -0,0 +1,40 @@
+﻿#ifndef SHARD_DRIVER_H
+#define SHARD_DRIVER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "partial_aggregate.h"
+
+// Анализ по частям на одной машине: файлы логов делятся между
+// несколькими процессами (копиями этой же программы), каждый строит
+// частичный агрегат своей доли и передаёт его через анонимный канал
+// (stdout обработчика), координатор сливает результаты.
+// Так проверяется тот же путь, что и при запуске обработчиков на
+// разных машинах: обмен идёт только сериализованными агрегатами.
+
+namespace ShardDriver {
+
+    // Аргумент командной строки режима обработчика:
+    // program --partial <размер сводки> [<файл>...]
+    // Без файлов список читается из stdin, по пути на строку: так его
+    // передаёт координатор, командная строка Windows ограничена 32767 символами
+    const char WORKER_FLAG[] = "--partial";
+
+    struct ShardedRun {
+        PartialAggregate total;
+        size_t processes = 0;               // запущено обработчиков
+        std::vector<std::string> errors;
+    };
+
+    // Координатор: файлы распределяются по размеру (больший - наименее
+    // загруженному обработчику); processes = 0 - по числу ядер
+    ShardedRun analyzeSharded(const std::vector<std::string>& files,
+        unsigned processes = 0, size_t sketchSize = 1024);
+
+    // Обработчик: загрузка файлов и запись агрегата в stdout (двоично).
+    // Код возврата: 0 - успех, 2 - часть файлов не прочитана, 1 - ошибка
+    int runWorker(const std::vector<std::string>& arguments);
+}
+
+#endif // SHARD_DRIVER_H
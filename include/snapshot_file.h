@@ -0,0 +1,133 @@
+﻿#ifndef SNAPSHOT_FILE_H
+#define SNAPSHOT_FILE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "log_entry.h"
+#include "rollup_cube.h"
+#include "windows_utils.h"
+
+// Двоичный снимок записей: загрузка без разбора JSON.
+//
+// Файл: заголовок, таблица разделов, затем разделы, выровненные на 8 байт.
+// Записи хранятся по колонкам: время (int64), статус (uint16), код метода
+// (uint8) и номера строк IP, URL и метода (uint32) в словарях. Словарь -
+// число строк, смещения (uint64, на одно больше числа строк) и байты строк.
+// Время хранится только числом, если строки восстанавливаются из него
+// без потерь (обычный случай), иначе добавляется словарь строк времени.
+// Куб счётчиков записывается по желанию, в своём формате (см. rollup_cube.h).
+//
+// У каждого раздела и у таблицы разделов есть контрольная сумма; числа
+// записаны в порядке байтов little-endian. Файл отображается в память,
+// колонки читаются прямо из отображения.
+//
+// Без копирования колонками пользуются только читатели SnapshotFile
+// (например, ArrowWriter::fromSnapshot). LogAnalyzer::loadSnapshot
+// копирует записи в память анализатора и строит индексы заново (кроме
+// времени и куба): снимок экономит разбор JSON, но не память и не
+// построение индексов.
+
+enum class SnapshotSection : uint32_t {
+    Epochs = 1,
+    Statuses,
+    MethodCodes,
+    IPIds,
+    URLIds,
+    MethodIds,
+    IPDictionary,
+    URLDictionary,
+    MethodDictionary,
+    TimestampIds,
+    TimestampDictionary,
+    Rollup
+};
+
+// Словарь строк внутри отображённого файла (без копирования)
+class SnapshotDictionary {
+private:
+    const uint64_t* offsets = nullptr;
+    const char* bytes = nullptr;
+    size_t count = 0;
+
+public:
+    SnapshotDictionary() = default;
+    SnapshotDictionary(const uint64_t* offsetTable, const char* data, size_t strings)
+        : offsets(offsetTable), bytes(data), count(strings) {}
+
+    size_t size() const { return count; }
+    const uint64_t* offsetTable() const { return offsets; }    // size() + 1 смещений от data()
+    const char* data() const { return bytes; }
+    std::string_view operator[](size_t id) const {
+        return std::string_view(bytes + offsets[id], static_cast<size_t>(offsets[id + 1] - offsets[id]));
+    }
+};
+
+class SnapshotFile {
+public:
+    static const uint32_t VERSION = 1;
+
+    // Запись снимка; rollup = nullptr - без куба
+    static bool save(const std::string& filename, const std::vector<LogEntry>& logs,
+        const RollupCube* rollup = nullptr);
+
+private:
+    WindowsUtils::MappedFile file;
+    size_t rows = 0;
+
+    const int64_t* epochs = nullptr;
+    const uint16_t* statuses = nullptr;
+    const uint8_t* methodCodes = nullptr;
+    const uint32_t* ipIds = nullptr;
+    const uint32_t* urlIds = nullptr;
+    const uint32_t* methodIds = nullptr;
+    const uint32_t* timestampIds = nullptr;     // nullptr - время восстанавливается из epochs
+    SnapshotDictionary ips;
+    SnapshotDictionary urls;
+    SnapshotDictionary methods;
+    SnapshotDictionary timestamps;
+    std::string_view rollup;
+
+public:
+    SnapshotFile() = default;
+    SnapshotFile(const SnapshotFile&) = delete;
+    SnapshotFile& operator=(const SnapshotFile&) = delete;
+
+    // Отображение файла и проверка заголовка и границ разделов.
+    // verify - ещё и контрольные суммы и номера в словарях (проход по файлу);
+    // без проверки открытие не зависит от размера файла
+    bool open(const std::string& filename, bool verify = true);
+    void close();
+
+    size_t size() const { return rows; }
+    bool isOpen() const { return file.isOpen(); }
+    size_t fileBytes() const { return file.size(); }
+
+    // Колонки (указатели внутрь отображения, действительны до close)
+    const int64_t* epochColumn() const { return epochs; }
+    const uint16_t* statusColumn() const { return statuses; }
+    const uint8_t* methodColumn() const { return methodCodes; }   // HttpMethod
+    const uint32_t* ipColumn() const { return ipIds; }
+    const uint32_t* urlColumn() const { return urlIds; }
+    const uint32_t* methodIdColumn() const { return methodIds; }
+    const SnapshotDictionary& ipDictionary() const { return ips; }
+    const SnapshotDictionary& urlDictionary() const { return urls; }
+    const SnapshotDictionary& methodDictionary() const { return methods; }
+
+    std::string_view ip(size_t row) const { return ips[ipIds[row]]; }
+    std::string_view url(size_t row) const { return urls[urlIds[row]]; }
+    std::string_view method(size_t row) const { return methods[methodIds[row]]; }
+    std::string timestamp(size_t row) const;
+    int status(size_t row) const { return statuses[row]; }
+
+    // Сохранённый куб (пусто, если его нет)
+    bool hasRollup() const { return !rollup.empty(); }
+    std::string_view rollupData() const { return rollup; }
+
+    // Копии записей для LogAnalyzer
+    std::vector<LogEntry> toLogEntries() const;
+};
+
+#endif // SNAPSHOT_FILE_H
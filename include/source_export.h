@@ -0,0 +1,26 @@
+﻿#ifndef SOURCE_EXPORT_H
+#define SOURCE_EXPORT_H
+
+#include <string>
+#include <vector>
+#include "json_parser.h"
+#include "log_index.h"
+
+// Экспорт выборки исходными байтами записей: без разбора и повторного
+// форматирования. Исходный файл отображается в память, и диапазоны
+// записей пишутся прямо из отображения; записи, идущие в файле подряд
+// (между ними только запятая и пробелы), копируются одним куском вместе
+// с разделителем. Результат - JSON-массив из исходных объектов.
+
+namespace SourceExport {
+
+    // Проверка, что span указывает на объект в пределах данных
+    bool isRecord(const char* data, size_t size, const RecordSpan& span);
+
+    // Записи rows (номера в spans). false - файл не открыт или изменился
+    // (запись не на месте) либо у строки нет положения в файле
+    bool writeRecords(const std::string& filename, const std::string& sourceFile,
+        const std::vector<RecordSpan>& spans, const std::vector<RowId>& rows);
+}
+
+#endif // SOURCE_EXPORT_H
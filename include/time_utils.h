@@ -0,0 +1,28 @@
+﻿#ifndef TIME_UTILS_H
+#define TIME_UTILS_H
+
+#include <string>
+#include <cstdint>
+
+// Преобразование времени записей в секунды от 1970-01-01 и обратно.
+// Нужно индексам и форматам файлов, поэтому лежит отдельно от
+// анализатора (остальные функции TimeUtils - в analyzer.h)
+namespace TimeUtils {
+    // Быстрое преобразование YYYY-MM-DDTHH:MM:SSZ в секунды от 1970-01-01
+    // (без sscanf и mktime; для некорректной строки возвращает 0)
+    int64_t toEpochSeconds(const std::string& timestamp);
+
+    // Обратное преобразование: секунды от 1970-01-01 в YYYY-MM-DDTHH:MM:SSZ
+    std::string fromEpochSeconds(int64_t epoch);
+
+    // Проверка, что строка имеет полный формат YYYY-MM-DDTHH:MM:SSZ
+    bool isFullTimestamp(const std::string& timestamp);
+
+    // Граница интервала в секундах. Неполное время (YYYY, YYYY-MM,
+    // YYYY-MM-DD, YYYY-MM-DDTHH, YYYY-MM-DDTHH:MM) обозначает свой период
+    // целиком: нижняя граница (upper = false) - его первая секунда,
+    // верхняя - последняя. false - строка не является временем
+    bool boundToEpoch(const std::string& bound, bool upper, int64_t& epoch);
+}
+
+#endif // TIME_UTILS_H
@@ -0,0 +1,54 @@
+﻿#ifndef VARINT_H
+#define VARINT_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// Целые переменной длины (по 7 бит в байте, старший бит - продолжение)
+// для компактных двоичных форматов (куб, частичные агрегаты)
+
+inline void appendVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// false - данные закончились посреди числа
+inline bool readVarint(std::string_view data, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < data.size(); shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(data[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// Знаковое смещение в беззнаковое: 0, -1, 1, -2, ... -> 0, 1, 2, 3, ...
+inline uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Строка с длиной впереди
+inline void appendString(std::string& out, std::string_view value) {
+    appendVarint(out, value.size());
+    out.append(value.data(), value.size());
+}
+
+inline bool readString(std::string_view data, size_t& pos, std::string& value) {
+    uint64_t length;
+    if (!readVarint(data, pos, length) || length > data.size() - pos) return false;
+    value.assign(data.data() + pos, static_cast<size_t>(length));
+    pos += static_cast<size_t>(length);
+    return true;
+}
+
+#endif // VARINT_H
@@ -54,6 +54,29 @@ namespace WindowsUtils {
     std::vector<std::string> listFiles(const std::string& directory,
         const std::string& pattern = "*.*");
 
+    // Файл, отображённый в память только для чтения. Страницы читаются
+    // по обращению и общие для всех процессов, открывших тот же файл
+    class MappedFile {
+    private:
+        void* file = nullptr;
+        void* mapping = nullptr;
+        const char* view = nullptr;
+        size_t length = 0;
+
+    public:
+        MappedFile() = default;
+        ~MappedFile() { close(); }
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool open(const std::string& path);    // пустой файл не отображается
+        void close();
+
+        const char* data() const { return view; }
+        size_t size() const { return length; }
+        bool isOpen() const { return view != nullptr; }
+    };
+
     // ==================== Работа с консолью ====================
 
     // Настройка консоли для поддержки UTF-8 и русского языка
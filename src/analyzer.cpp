@@ -3,8 +3,12 @@
 #include <numeric>
 #include <cmath>
 #include <unordered_set>
+#include <fstream>
+#include <climits>
 #include <windows.h>
 #include "json_parser.h"
+#include "log_loader.h"
+#include "snapshot_file.h"
 
 using namespace std;
 
@@ -13,11 +17,18 @@ LogAnalyzer::LogAnalyzer(const vector<LogEntry>& logEntries) : logs(logEntries)
     indexesBuilt = false;
 }
 
+LogAnalyzer::LogAnalyzer(vector<LogEntry>&& logEntries) : logs(move(logEntries)) {
+    indexesBuilt = false;
+}
+
 // Загрузка из JsonValue
 bool LogAnalyzer::loadFromJson(const JsonValue& json) {
     try {
         logs = json.asLogEntries();
+        clearSourceSpans();
         indexesBuilt = false;
+        sampleBuilt = false;
+        dataVersion++;
         return true;
     }
     catch (const exception& e) {
@@ -25,204 +36,757 @@ bool LogAnalyzer::loadFromJson(const JsonValue& json) {
     }
 }
 
-// Загрузка из файла
-bool LogAnalyzer::loadFromFile(const string& filename) {
+// Добавление записи без перестроения индексов
+void LogAnalyzer::addLog(const LogEntry& entry) {
+    logs.push_back(entry);
+    dataVersion++;
+
+    // Если индексы ещё не строились, они будут построены целиком по запросу
+    if (indexesBuilt) {
+        appendToIndexes(static_cast<RowId>(logs.size() - 1));
+    }
+    if (sampleBuilt) {
+        sampler.add(static_cast<RowId>(logs.size() - 1), entry.status);
+    }
+}
+
+void LogAnalyzer::addLogs(const vector<LogEntry>& entries) {
+    logs.reserve(logs.size() + entries.size());
+    for (const auto& entry : entries) {
+        addLog(entry);
+    }
+}
+
+// Загрузка из файла: записи разбираются по одной, без дерева всего массива
+bool LogAnalyzer::loadFromFile(const string& filename, bool keepSourceSpans) {
     try {
-        JsonValue json = JsonParser::loadFromFile(filename);
-        return loadFromJson(json);
+        vector<RecordSpan> spans;
+        logs = JsonParser::loadLogEntries(filename, keepSourceSpans ? &spans : nullptr);
+        clearSourceSpans();
+        if (keepSourceSpans) {
+            attachSourceSpans(filename, move(spans));
+        }
+        indexesBuilt = false;
+        sampleBuilt = false;
+        dataVersion++;
+        return true;
     }
     catch (const exception&) {
         return false;
     }
 }
 
-// Получение топ IP-адресов
-vector<pair<string, int>> LogAnalyzer::getTopIPs(int n) {
-    ensureIndexesBuilt();
+void LogAnalyzer::attachSourceSpans(const string& filename, vector<RecordSpan> spans) {
+    sourceFile = filename;
+    sourceSpans = move(spans);
+}
 
-    FastHashMap ipCounts;
-    ipCounts.reserve(logs.size() / 10);
+bool LogAnalyzer::loadFromFiles(const string& pathOrPattern, unsigned threads) {
+    return loadFromFiles(LogLoader::expandInputs(pathOrPattern), threads);
+}
 
-    for (const auto& log : logs) {
-        ipCounts[log.ip]++;
+// Загрузка нескольких файлов одним упорядоченным по времени набором
+bool LogAnalyzer::loadFromFiles(const vector<string>& files, unsigned threads) {
+    MultiFileLoad load = LogLoader::loadFiles(files, threads);
+    if (load.files == 0) {
+        return false;
+    }
+
+    logs = move(load.logs);
+    clearSourceSpans();
+    indexesBuilt = false;
+    sampleBuilt = false;
+    dataVersion++;
+    return load.errors.empty();
+}
+
+bool LogAnalyzer::saveSnapshot(const string& filename, bool withRollup) const {
+    if (withRollup) {
+        ensureIndexesBuilt();
+    }
+    return SnapshotFile::save(filename, logs, withRollup ? &rollup : nullptr);
+}
+
+// Загрузка снимка: записи копируются из словарей в logs, индексы IP и URL
+// строятся по номерам в словарях, время и куб берутся готовыми, остальные
+// индексы строятся как после загрузки JSON
+bool LogAnalyzer::loadSnapshot(const string& filename, bool verify) {
+    SnapshotFile snapshot;
+    if (!snapshot.open(filename, verify)) {
+        return false;
+    }
+
+    size_t rows = snapshot.size();
+    logs = snapshot.toLogEntries();
+    clearSourceSpans();
+    sampleBuilt = false;
+    dataVersion++;
+
+    ipIndex.buildFromIds(snapshot.ipDictionary(), snapshot.ipColumn(), rows);
+    urlIndex.buildFromIds(snapshot.urlDictionary(), snapshot.urlColumn(), rows);
+    timeIndex.assign(vector<int64_t>(snapshot.epochColumn(), snapshot.epochColumn() + rows));
+    buildBitmapIndex();
+    buildColumns();
+    buildPathTrie();
+    buildSubnetIndex();
+    if (!snapshot.hasRollup() || !rollup.deserialize(snapshot.rollupData()) ||
+        rollup.totalRows() != rows) {
+        buildRollup();
     }
+    finishIndexBuild();
+    return true;
+}
 
-    vector<pair<string, int>> sortedIPs(ipCounts.begin(), ipCounts.end());
+// Сортировка счётчиков по убыванию и обрезка до n
+static vector<pair<string, int>> topFromIndex(const HashIndex& index, int n) {
+    vector<pair<string, int>> sorted;
+    sorted.reserve(index.distinctKeys());
 
-    sort(sortedIPs.begin(), sortedIPs.end(),
+    for (const auto& [key, list] : index.entries()) {
+        sorted.emplace_back(key, static_cast<int>(list.size()));
+    }
+
+    sort(sorted.begin(), sorted.end(),
         [](const pair<string, int>& a, const pair<string, int>& b) {
             return a.second > b.second;
         });
 
-    if (n > 0 && static_cast<size_t>(n) < sortedIPs.size()) {
-        sortedIPs.resize(n);
+    if (n > 0 && static_cast<size_t>(n) < sorted.size()) {
+        sorted.resize(n);
     }
 
-    return sortedIPs;
+    return sorted;
+}
+
+// Получение топ IP-адресов (размеры списков индекса = число запросов)
+vector<pair<string, int>> LogAnalyzer::getTopIPs(int n) {
+    ensureIndexesBuilt();
+
+    vector<pair<string, int>> result;
+    if (!topIPsCache.get(n, result)) {
+        result = topFromIndex(ipIndex, n);
+        topIPsCache.store(n, result);
+    }
+    return result;
 }
 
 // Получение топ URL
 vector<pair<string, int>> LogAnalyzer::getTopURLs(int n) {
     ensureIndexesBuilt();
 
-    FastHashMap urlCounts;
-    urlCounts.reserve(logs.size() / 20);
+    vector<pair<string, int>> result;
+    if (!topURLsCache.get(n, result)) {
+        result = topFromIndex(urlIndex, n);
+        topURLsCache.store(n, result);
+    }
+    return result;
+}
 
-    for (const auto& log : logs) {
-        urlCounts[log.url]++;
+// Фильтрация по статусу: готовая битовая карта статуса
+vector<LogEntry> LogAnalyzer::filterByStatus(int status) const {
+    ensureIndexesBuilt();
+    return filterByBitmap(bitmapIndex.status(status));
+}
+
+// Фильтрация по методу (без учёта регистра, регистр приведён при индексации)
+vector<LogEntry> LogAnalyzer::filterByMethod(const string& method) const {
+    ensureIndexesBuilt();
+    return filterByBitmap(bitmapIndex.method(method));
+}
+
+// Фильтрация по временному диапазону: два бинарных поиска по индексу времени
+vector<LogEntry> LogAnalyzer::filterByTimeRange(const string& startTime,
+    const string& endTime) const {
+    // Неполные границы (например, только дата) сравниваются как строки
+    if ((!startTime.empty() && !TimeUtils::isFullTimestamp(startTime)) ||
+        (!endTime.empty() && !TimeUtils::isFullTimestamp(endTime))) {
+        vector<LogEntry> result;
+
+        copy_if(logs.begin(), logs.end(), back_inserter(result),
+            [&startTime, &endTime](const LogEntry& log) {
+                return isInTimeRange(log.timestamp, startTime, endTime);
+            });
+
+        return result;
     }
 
-    vector<pair<string, int>> sortedURLs(urlCounts.begin(), urlCounts.end());
+    TimeIndex::Span span = findTimeSpan(startTime, endTime);
 
-    sort(sortedURLs.begin(), sortedURLs.end(),
-        [](const pair<string, int>& a, const pair<string, int>& b) {
-            return a.second > b.second;
-        });
+    // Упорядоченные логи: диапазон записей непрерывен
+    if (timeIndex.isSorted()) {
+        return vector<LogEntry>(logs.begin() + span.begin, logs.begin() + span.end);
+    }
 
-    if (n > 0 && static_cast<size_t>(n) < sortedURLs.size()) {
-        sortedURLs.resize(n);
+    vector<RowId> rows;
+    rows.reserve(span.size());
+    for (size_t pos = span.begin; pos < span.end; pos++) {
+        rows.push_back(timeIndex.rowAt(pos));
     }
+    sort(rows.begin(), rows.end());
 
-    return sortedURLs;
+    return collectRows(rows);
 }
 
-// Фильтрация по статусу
-vector<LogEntry> LogAnalyzer::filterByStatus(int status) const {
-    vector<LogEntry> result;
-    result.reserve(logs.size() / 10); // Ожидаем примерно 10% записей
+// Поиск диапазона позиций в индексе времени
+TimeIndex::Span LogAnalyzer::findTimeSpan(const string& startTime,
+    const string& endTime) const {
+    ensureIndexesBuilt();
 
-    copy_if(logs.begin(), logs.end(), back_inserter(result),
-        [status](const LogEntry& log) {
-            return log.status == status;
+    int64_t from = INT64_MIN;
+    int64_t to = INT64_MAX;
+    if ((!startTime.empty() && !TimeUtils::boundToEpoch(startTime, false, from)) ||
+        (!endTime.empty() && !TimeUtils::boundToEpoch(endTime, true, to))) {
+        return TimeIndex::Span();
+    }
+    return timeIndex.range(from, to);
+}
+
+// Фильтрация по IP: точечный поиск в хэш-индексе
+vector<LogEntry> LogAnalyzer::filterByIP(const string& ip) const {
+    ensureIndexesBuilt();
+
+    const PostingList* rows = ipIndex.find(ip);
+    if (!rows) {
+        return {};
+    }
+
+    return collectRows(rows->decode());
+}
+
+// Фильтрация по шаблону URL: подстрока ищется по уникальным URL
+// из индекса, а не по каждой записи
+vector<LogEntry> LogAnalyzer::filterByURL(const string& urlPattern) const {
+    ensureIndexesBuilt();
+
+    vector<RowId> rows;
+    size_t matchedLists = 0;
+    getURLNGramIndex().forEachMatch(urlPattern,
+        [&rows, &matchedLists](const string&, const PostingList& list) {
+            list.decodeInto(rows);
+            matchedLists++;
         });
 
-    result.shrink_to_fit();
-    return result;
+    // Списки разных URL перемежаются - восстанавливаем порядок записей
+    if (matchedLists > 1) {
+        sort(rows.begin(), rows.end());
+    }
+
+    return collectRows(rows);
 }
 
-// Фильтрация по методу
-vector<LogEntry> LogAnalyzer::filterByMethod(const string& method) const {
-    vector<LogEntry> result;
-    result.reserve(logs.size() / 5); // Ожидаем примерно 20% записей
+// Записи подсети: поддерево префикса в дереве адресов
+vector<LogEntry> LogAnalyzer::filterByCIDR(const string& cidr) const {
+    CIDR network;
+    if (!parseCIDR(cidr, network)) {
+        return {};
+    }
+
+    ensureIndexesBuilt();
+    return collectRows(subnetIndex.rows(network));
+}
+
+vector<pair<string, int>> LogAnalyzer::getTopSubnets(int ipv4Prefix, int n, int ipv6Prefix) const {
+    string key = "topSubnets:" + to_string(ipv4Prefix) + ":" + to_string(n) + ":" + to_string(ipv6Prefix);
+    if (auto cached = resultCache.find<vector<pair<string, int>>>(key, dataVersion)) {
+        return *cached;
+    }
+
+    ensureIndexesBuilt();
+
+    vector<pair<string, int>> result;
+    for (const auto& [subnet, count] : subnetIndex.topSubnets(ipv4Prefix, ipv6Prefix,
+        n > 0 ? static_cast<size_t>(n) : 0)) {
+        result.emplace_back(subnet.toString(), static_cast<int>(count));
+    }
+    return remember(key, move(result));
+}
 
-    string upperMethod = method;
-    transform(upperMethod.begin(), upperMethod.end(), upperMethod.begin(), ::toupper);
+// Диапазоны меняют результаты getTopNamedRanges
+bool LogAnalyzer::addNamedRange(const string& cidr, const string& name) {
+    dataVersion++;
+    return namedRanges.add(cidr, name);
+}
+
+size_t LogAnalyzer::loadNamedRanges(const string& filename) {
+    dataVersion++;
+    return namedRanges.loadFromFile(filename);
+}
 
-    copy_if(logs.begin(), logs.end(), back_inserter(result),
-        [&upperMethod](const LogEntry& log) {
-            string logMethod = log.method;
-            transform(logMethod.begin(), logMethod.end(), logMethod.begin(), ::toupper);
-            return logMethod == upperMethod;
+string LogAnalyzer::findNamedRange(const string& ip) const {
+    const string* name = namedRanges.lookup(ip);
+    return name ? *name : string();
+}
+
+// Число запросов по диапазонам: один поиск на уникальный адрес
+vector<pair<string, int>> LogAnalyzer::getTopNamedRanges(int n) const {
+    string key = "topNamedRanges:" + to_string(n);
+    if (auto cached = resultCache.find<vector<pair<string, int>>>(key, dataVersion)) {
+        return *cached;
+    }
+
+    ensureIndexesBuilt();
+
+    unordered_map<string, int, WindowsStringHash> counts;
+    subnetIndex.forEachAddress([this, &counts](const IPAddress& address, const string&,
+        const PostingList& rows) {
+        const string* name = namedRanges.lookup(address);
+        if (name) {
+            counts[*name] += static_cast<int>(rows.size());
+        }
+    });
+
+    vector<pair<string, int>> sorted(counts.begin(), counts.end());
+    sort(sorted.begin(), sorted.end(),
+        [](const pair<string, int>& a, const pair<string, int>& b) {
+            return a.second > b.second || (a.second == b.second && a.first < b.first);
         });
 
-    result.shrink_to_fit();
-    return result;
+    if (n > 0 && static_cast<size_t>(n) < sorted.size()) {
+        sorted.resize(n);
+    }
+
+    return remember(key, move(sorted));
 }
 
-// Фильтрация по временному диапазону
-vector<LogEntry> LogAnalyzer::filterByTimeRange(const string& startTime,
-    const string& endTime) const {
+// Поддерево префикса в дереве путей
+vector<LogEntry> LogAnalyzer::filterByURLPrefix(const string& prefix) const {
+    ensureIndexesBuilt();
+    return collectRows(pathTrie.rowsUnder(pathTrie.find(prefix)));
+}
+
+const NGramIndex& LogAnalyzer::getURLNGramIndex() const {
+    ensureIndexesBuilt();
+
+    if (!urlNGramsBuilt) {
+        urlNGrams.build(urlIndex);
+        urlNGramsBuilt = true;
+    }
+
+    return urlNGrams;
+}
+
+// Копирование записей, отмеченных в битовой карте
+vector<LogEntry> LogAnalyzer::filterByBitmap(const RoaringBitmap& rows) const {
     vector<LogEntry> result;
-    result.reserve(logs.size());
+    result.reserve(rows.cardinality());
 
-    copy_if(logs.begin(), logs.end(), back_inserter(result),
-        [&startTime, &endTime](const LogEntry& log) {
-            return isInTimeRange(log.timestamp, startTime, endTime);
-        });
+    rows.forEach([this, &result](uint32_t row) {
+        if (row < logs.size()) {
+            result.push_back(logs[row]);
+        }
+    });
 
-    result.shrink_to_fit();
     return result;
 }
 
-// Фильтрация по IP
-vector<LogEntry> LogAnalyzer::filterByIP(const string& ip) const {
-    vector<LogEntry> result;
+// ==================== Составные запросы ====================
 
-    copy_if(logs.begin(), logs.end(), back_inserter(result),
-        [&ip](const LogEntry& log) {
-            return log.ip == ip;
-        });
+// Карта записей, удовлетворяющих условиям по статусу и методу
+RoaringBitmap LogAnalyzer::statusMethodBitmap(const LogQuery& query) const {
+    RoaringBitmap result = bitmapIndex.all();
+
+    if (!query.statuses.empty()) {
+        RoaringBitmap byStatus;
+        for (int status : query.statuses) {
+            byStatus |= bitmapIndex.status(status);
+        }
+        result &= byStatus;
+    }
+    if (query.minStatus > 0 || query.maxStatus > 0) {
+        result &= bitmapIndex.statusRange(query.minStatus,
+            query.maxStatus > 0 ? query.maxStatus : INT_MAX);
+    }
+    if (!query.methods.empty()) {
+        RoaringBitmap byMethod;
+        for (const auto& method : query.methods) {
+            byMethod |= bitmapIndex.method(method);
+        }
+        result &= byMethod;
+    }
 
     return result;
 }
 
-// Фильтрация по шаблону URL
-vector<LogEntry> LogAnalyzer::filterByURL(const string& urlPattern) const {
-    vector<LogEntry> result;
+// Выбор самого избирательного индекса; остальные условия проверяются по записям
+QueryPlan LogAnalyzer::makePlan(const LogQuery& query, RoaringBitmap& bitmap) const {
+    ensureIndexesBuilt();
 
-    copy_if(logs.begin(), logs.end(), back_inserter(result),
-        [&urlPattern](const LogEntry& log) {
-            return log.url.find(urlPattern) != string::npos;
+    QueryPlan plan;
+    plan.source = QueryPlan::Source::FullScan;
+    plan.candidates = logs.size();
+    plan.checkStatus = query.hasStatusFilter();
+    plan.checkMethod = !query.methods.empty();
+    plan.checkIP = !query.ip.empty();
+    plan.checkURL = !query.urlSubstring.empty();
+    plan.checkTime = query.hasTimeFilter();
+
+    auto consider = [&plan](QueryPlan::Source source, size_t candidates) {
+        if (candidates < plan.candidates) {
+            plan.source = source;
+            plan.candidates = candidates;
+        }
+    };
+
+    if (!query.ip.empty()) {
+        const PostingList* rows = ipIndex.find(query.ip);
+        consider(QueryPlan::Source::IPIndex, rows ? rows->size() : 0);
+    }
+
+    if (query.hasTimeFilter() &&
+        (query.timeStart.empty() || TimeUtils::isFullTimestamp(query.timeStart)) &&
+        (query.timeEnd.empty() || TimeUtils::isFullTimestamp(query.timeEnd))) {
+        consider(QueryPlan::Source::TimeIndex, findTimeSpan(query.timeStart, query.timeEnd).size());
+    }
+
+    if (plan.checkStatus || plan.checkMethod) {
+        bitmap = statusMethodBitmap(query);
+        consider(QueryPlan::Source::Bitmap, static_cast<size_t>(bitmap.cardinality()));
+    }
+
+    // Подстрока из 3+ символов сужается триграммным индексом; более короткая
+    // проверяется по всем уникальным URL, только если это дешевле
+    // уже выбранного источника
+    if (!query.urlSubstring.empty() &&
+        (query.urlSubstring.size() >= NGramIndex::GRAM || urlIndex.distinctKeys() < plan.candidates)) {
+        size_t matched = 0;
+        getURLNGramIndex().forEachMatch(query.urlSubstring,
+            [&matched](const string&, const PostingList& list) { matched += list.size(); });
+        consider(QueryPlan::Source::URLIndex, matched);
+    }
+
+    switch (plan.source) {
+    case QueryPlan::Source::IPIndex:   plan.checkIP = false; break;
+    case QueryPlan::Source::TimeIndex: plan.checkTime = false; break;
+    case QueryPlan::Source::URLIndex:  plan.checkURL = false; break;
+    case QueryPlan::Source::Bitmap:
+        plan.checkStatus = false;
+        plan.checkMethod = false;
+        break;
+    default:
+        break;
+    }
+
+    if (plan.candidates == 0) {
+        plan.source = QueryPlan::Source::Empty;
+    }
+
+    return plan;
+}
+
+QueryPlan LogAnalyzer::planQuery(const LogQuery& query) const {
+    RoaringBitmap bitmap;
+    return makePlan(query, bitmap);
+}
+
+// Выполнение запроса за один проход по кандидатам
+Selection LogAnalyzer::select(const LogQuery& query) const {
+    RoaringBitmap bitmap;
+    QueryPlan plan = makePlan(query, bitmap);
+    QueryFilter filter(query);
+
+    vector<RowId> result;
+    auto check = [&](RowId row) {
+        const LogEntry& log = logs[row];
+        if (plan.checkStatus && !filter.statusMatches(log.status)) return;
+        if (plan.checkMethod && !filter.methodMatches(log.method)) return;
+        if (plan.checkIP && log.ip != query.ip) return;
+        if (plan.checkTime) {
+            if (filter.epochBounds) {
+                int64_t epoch = timeIndex.epochOf(row);
+                if (epoch < filter.from || epoch > filter.to) return;
+            }
+            else if (!isInTimeRange(log.timestamp, query.timeStart, query.timeEnd)) {
+                return;
+            }
+        }
+        if (plan.checkURL && !containsSubstring(log.url, query.urlSubstring)) return;
+        result.push_back(row);
+    };
+
+    switch (plan.source) {
+    case QueryPlan::Source::Empty:
+        break;
+
+    case QueryPlan::Source::FullScan:
+        result.reserve(logs.size() / 4);
+        for (size_t i = 0; i < logs.size(); i++) {
+            check(static_cast<RowId>(i));
+        }
+        break;
+
+    case QueryPlan::Source::IPIndex:
+        ipIndex.find(query.ip)->forEach(check);
+        break;
+
+    case QueryPlan::Source::Bitmap:
+        result.reserve(plan.candidates);
+        bitmap.forEach(check);
+        break;
+
+    case QueryPlan::Source::TimeIndex: {
+        TimeIndex::Span span = findTimeSpan(query.timeStart, query.timeEnd);
+        result.reserve(span.size());
+        for (size_t pos = span.begin; pos < span.end; pos++) {
+            check(timeIndex.rowAt(pos));
+        }
+        if (!timeIndex.isSorted()) {
+            sort(result.begin(), result.end());
+        }
+        break;
+    }
+
+    case QueryPlan::Source::URLIndex: {
+        size_t matchedLists = 0;
+        urlNGrams.forEachMatch(query.urlSubstring,
+            [&check, &matchedLists](const string&, const PostingList& list) {
+                list.forEach(check);
+                matchedLists++;
+            });
+        if (matchedLists > 1) {
+            sort(result.begin(), result.end());
+        }
+        break;
+    }
+    }
+
+    return Selection(logs, move(result));
+}
+
+Selection LogAnalyzer::selectAll() const {
+    vector<RowId> rows(logs.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        rows[i] = static_cast<RowId>(i);
+    }
+    return Selection(logs, move(rows));
+}
+
+// Подсчёт топа по строковой колонке выборки
+static vector<pair<string, int>> topBySelection(const Selection& rows,
+    string LogEntry::* column, int n) {
+    unordered_map<string, int, WindowsStringHash> counts;
+    rows.forEach([&counts, column](const LogEntry& log) { counts[log.*column]++; });
+
+    vector<pair<string, int>> sorted(counts.begin(), counts.end());
+    sort(sorted.begin(), sorted.end(),
+        [](const pair<string, int>& a, const pair<string, int>& b) {
+            return a.second > b.second;
         });
 
-    return result;
+    if (n > 0 && static_cast<size_t>(n) < sorted.size()) {
+        sorted.resize(n);
+    }
+
+    return sorted;
 }
 
-// Фильтрация с пользовательским предикатом
-vector<LogEntry> LogAnalyzer::filter(const function<bool(const LogEntry&)>& predicate) const {
-    vector<LogEntry> result;
+vector<pair<string, int>> LogAnalyzer::getTopIPs(const Selection& rows, int n) const {
+    return topBySelection(rows, &LogEntry::ip, n);
+}
+
+vector<pair<string, int>> LogAnalyzer::getTopURLs(const Selection& rows, int n) const {
+    return topBySelection(rows, &LogEntry::url, n);
+}
+
+map<int, int> LogAnalyzer::getStatusDistribution(const Selection& rows) const {
+    map<int, int> distribution;
+    rows.forEach([&distribution](const LogEntry& log) { distribution[log.status]++; });
+    return distribution;
+}
+
+map<string, int> LogAnalyzer::getMethodDistribution(const Selection& rows) const {
+    map<string, int> distribution;
+    rows.forEach([&distribution](const LogEntry& log) { distribution[log.method]++; });
+    return distribution;
+}
+
+RollupCube::Counts LogAnalyzer::getRollupCounts(const string& startTime,
+    const string& endTime) const {
+    ensureIndexesBuilt();
+
+    int64_t from = INT64_MIN;
+    int64_t to = INT64_MAX;
+    if ((!startTime.empty() && !TimeUtils::boundToEpoch(startTime, false, from)) ||
+        (!endTime.empty() && !TimeUtils::boundToEpoch(endTime, true, to))) {
+        return RollupCube::Counts();
+    }
+    return rollup.query(from, to);
+}
 
-    copy_if(logs.begin(), logs.end(), back_inserter(result), predicate);
+// ==================== Приблизительные ответы ====================
 
+void LogAnalyzer::setSampling(size_t capacity, bool stratified, double confidence) {
+    sampler = LogSampler(capacity, stratified, confidence);
+    sampleBuilt = false;
+}
+
+// Выборка по уже загруженным записям; дальше пополняется в addLog
+const LogSampler& LogAnalyzer::getSampler() const {
+    if (!sampleBuilt) {
+        sampler.build(logs);
+        sampleBuilt = true;
+    }
+    return sampler;
+}
+
+// Точные значения топа в виде оценок с нулевой шириной интервала
+static vector<pair<string, Estimate>> exactEstimates(const vector<pair<string, int>>& counts) {
+    vector<pair<string, Estimate>> result;
+    result.reserve(counts.size());
+    for (const auto& [key, count] : counts) {
+        result.emplace_back(key, Estimate::exactly(count));
+    }
     return result;
 }
 
-// Получение временного диапазона
+vector<pair<string, Estimate>> LogAnalyzer::estimateTopIPs(int n, QueryMode mode) const {
+    if (mode == QueryMode::Exact) {
+        ensureIndexesBuilt();
+        return exactEstimates(topFromIndex(ipIndex, n));
+    }
+    return getSampler().estimateCounts(logs, [](const LogEntry& log) -> const string& {
+        return log.ip;
+    }, n);
+}
+
+vector<pair<string, Estimate>> LogAnalyzer::estimateTopURLs(int n, QueryMode mode) const {
+    if (mode == QueryMode::Exact) {
+        ensureIndexesBuilt();
+        return exactEstimates(topFromIndex(urlIndex, n));
+    }
+    return getSampler().estimateCounts(logs, [](const LogEntry& log) -> const string& {
+        return log.url;
+    }, n);
+}
+
+map<int, Estimate> LogAnalyzer::estimateStatusDistribution(QueryMode mode) const {
+    map<int, Estimate> distribution;
+    if (mode == QueryMode::Exact) {
+        for (const auto& [status, count] : getStatusDistribution()) {
+            distribution[status] = Estimate::exactly(count);
+        }
+        return distribution;
+    }
+
+    for (const auto& [status, estimate] : getSampler().estimateCounts(logs,
+        [](const LogEntry& log) { return log.status; })) {
+        distribution[status] = estimate;
+    }
+    return distribution;
+}
+
+// Группировка: строковые ключи кодируются по словарям индексов IP и URL
+GroupSource LogAnalyzer::groupSource() const {
+    GroupSource source;
+    source.columns = columnView();
+    source.ips = &ipIndex;
+    source.urls = &urlIndex;
+    return source;
+}
+
+GroupTable LogAnalyzer::groupBy(const GroupBy& query) const {
+    return executeGroupBy(query, groupSource(), nullptr);
+}
+
+GroupTable LogAnalyzer::groupBy(const GroupBy& query, const Selection& rows) const {
+    return executeGroupBy(query, groupSource(), &rows.rowIds());
+}
+
+// Получение временного диапазона: первая и последняя запись индекса времени
 pair<string, string> LogAnalyzer::getTimeRange() const {
     if (logs.empty()) {
         return { "", "" };
     }
 
-    string minTime = logs[0].timestamp;
-    string maxTime = logs[0].timestamp;
+    ensureIndexesBuilt();
 
-    for (const auto& log : logs) {
-        if (log.timestamp < minTime) {
-            minTime = log.timestamp;
-        }
-        if (log.timestamp > maxTime) {
-            maxTime = log.timestamp;
-        }
+    return { logs[timeIndex.rowAt(0)].timestamp,
+        logs[timeIndex.rowAt(logs.size() - 1)].timestamp };
+}
+
+// Частичные агрегаты из индексов: точные счётчики значений идут в сводки
+PartialAggregate LogAnalyzer::getPartialAggregate(size_t sketchSize) const {
+    ensureIndexesBuilt();
+
+    PartialAggregate partial(sketchSize);
+    partial.rows = logs.size();
+    if (!logs.empty()) {
+        partial.firstEpoch = timeIndex.epochOf(timeIndex.rowAt(0));
+        partial.lastEpoch = timeIndex.epochOf(timeIndex.rowAt(logs.size() - 1));
     }
 
-    return { minTime, maxTime };
+    for (const auto& [status, rows] : bitmapIndex.statusEntries()) {
+        partial.statuses[status] = rows.cardinality();
+    }
+    for (const auto& [method, count] : getMethodDistribution()) {
+        partial.methods[method] = static_cast<uint64_t>(count);
+    }
+
+    auto summarize = [](const HashIndex& index, TopKSketch& sketch, HyperLogLog& unique) {
+        vector<pair<string, uint64_t>> counts;
+        counts.reserve(index.distinctKeys());
+        for (const auto& [key, list] : index.entries()) {
+            counts.emplace_back(key, list.size());
+            unique.add(key);
+        }
+        sketch.assign(move(counts));
+    };
+    summarize(ipIndex, partial.topIPs, partial.uniqueIPs);
+    summarize(urlIndex, partial.topURLs, partial.uniqueURLs);
+
+    partial.rollup = rollup;
+    return partial;
 }
 
-// Распределение по статусам
+// Распределение по статусам: мощности битовых карт
 map<int, int> LogAnalyzer::getStatusDistribution() const {
-    map<int, int> distribution;
+    if (auto cached = resultCache.find<map<int, int>>("statusDistribution", dataVersion)) {
+        return *cached;
+    }
 
-    for (const auto& log : logs) {
-        distribution[log.status]++;
+    ensureIndexesBuilt();
+
+    map<int, int> distribution;
+    for (const auto& [status, rows] : bitmapIndex.statusEntries()) {
+        distribution[status] = static_cast<int>(rows.cardinality());
     }
 
-    return distribution;
+    return remember("statusDistribution", move(distribution));
 }
 
 // Распределение по методам
 map<string, int> LogAnalyzer::getMethodDistribution() const {
+    if (auto cached = resultCache.find<map<string, int>>("methodDistribution", dataVersion)) {
+        return *cached;
+    }
+
     map<string, int> distribution;
 
     for (const auto& log : logs) {
         distribution[log.method]++;
     }
 
-    return distribution;
+    return remember("methodDistribution", move(distribution));
+}
+
+// Оценка памяти статистики для кэша результатов
+static size_t resultBytes(const LogAnalyzer::Statistics& stats) {
+    return sizeof(stats) + resultBytes(stats.timeRangeStart) + resultBytes(stats.timeRangeEnd) +
+        resultBytes(stats.statusCounts) + resultBytes(stats.methodCounts);
 }
 
 // Детальная статистика
 LogAnalyzer::Statistics LogAnalyzer::getDetailedStatistics() const {
+    if (auto cached = resultCache.find<Statistics>("statistics", dataVersion)) {
+        return *cached;
+    }
+
     Statistics stats;
     stats.totalRequests = getTotalRequests();
 
-    // Уникальные IP и URL
-    unordered_set<string> uniqueIPs, uniqueURLs;
-    for (const auto& log : logs) {
-        uniqueIPs.insert(log.ip);
-        uniqueURLs.insert(log.url);
-    }
-    stats.uniqueIPs = static_cast<int>(uniqueIPs.size());
-    stats.uniqueURLs = static_cast<int>(uniqueURLs.size());
+    // Уникальные IP и URL - число ключей в индексах
+    ensureIndexesBuilt();
+    stats.uniqueIPs = static_cast<int>(ipIndex.distinctKeys());
+    stats.uniqueURLs = static_cast<int>(urlIndex.distinctKeys());
 
     // Временной диапазон
     auto timeRange = getTimeRange();
@@ -235,38 +799,32 @@ LogAnalyzer::Statistics LogAnalyzer::getDetailedStatistics() const {
     // Распределение по методам
     stats.methodCounts = getMethodDistribution();
 
-    // Расчет средней нагрузки (запросов в секунду)
-    if (!logs.empty() && timeRange.first != timeRange.second) {
-        try {
-            // Простой расчет: предполагаем равномерное распределение
-            // В реальности нужно парсить timestamp и вычислять разницу
-            stats.requestsPerSecond = static_cast<double>(stats.totalRequests) / 3600.0; // пример: за час
+    // Расчет средней нагрузки (запросов в секунду) по границам индекса времени
+    stats.requestsPerSecond = 0.0;
+    if (logs.size() > 1) {
+        int64_t seconds = timeIndex.epochOf(timeIndex.rowAt(logs.size() - 1)) -
+            timeIndex.epochOf(timeIndex.rowAt(0));
+        if (seconds > 0) {
+            stats.requestsPerSecond = static_cast<double>(stats.totalRequests) / seconds;
         }
-        catch (...) {
-            stats.requestsPerSecond = 0.0;
-        }
-    }
-    else {
-        stats.requestsPerSecond = 0.0;
     }
 
-    return stats;
+    return remember("statistics", move(stats));
 }
 
-// Поиск неудачных запросов
+// Поиск неудачных запросов: объединение карт статусов >= threshold
 vector<LogEntry> LogAnalyzer::findFailedRequests(int threshold) const {
-    vector<LogEntry> result;
-
-    copy_if(logs.begin(), logs.end(), back_inserter(result),
-        [threshold](const LogEntry& log) {
-            return log.status >= threshold;
-        });
-
-    return result;
+    ensureIndexesBuilt();
+    return filterByBitmap(bitmapIndex.statusRange(threshold, INT_MAX));
 }
 
 // Поиск подозрительных IP
 vector<string> LogAnalyzer::findSuspiciousIPs(int threshold) const {
+    string key = "suspiciousIPs:" + to_string(threshold);
+    if (auto cached = resultCache.find<vector<string>>(key, dataVersion)) {
+        return *cached;
+    }
+
     FastHashMap ipCounts;
 
     for (const auto& log : logs) {
@@ -281,54 +839,233 @@ vector<string> LogAnalyzer::findSuspiciousIPs(int threshold) const {
         }
     }
 
+    return remember(key, move(suspiciousIPs));
+}
+
+vector<string> LogAnalyzer::findSuspiciousIPs(int maxRequests, int windowSeconds) const {
+    vector<string> suspiciousIPs;
+    for (auto& [ip, peak] : findRequestBursts(maxRequests, windowSeconds)) {
+        suspiciousIPs.push_back(move(ip));
+    }
     return suspiciousIPs;
 }
 
-// Экспорт в CSV
-bool LogAnalyzer::exportToCSV(const string& filename) const {
-    ofstream file(filename);
-    if (!file.is_open()) {
-        return false;
+vector<pair<string, int>> LogAnalyzer::findRequestBursts(int maxRequests, int windowSeconds,
+    size_t memoryBudget) const {
+    vector<pair<string, int>> bursts;
+    if (logs.empty() || maxRequests < 0 || windowSeconds <= 0) {
+        return bursts;
     }
 
-    // Заголовок
-    file << "timestamp,ip,method,url,status\n";
+    // Результат точный при любом memoryBudget (см. ниже), поэтому бюджета
+    // нет в ключе
+    string key = "requestBursts:" + to_string(maxRequests) + ":" + to_string(windowSeconds);
+    if (auto cached = resultCache.find<vector<pair<string, int>>>(key, dataVersion)) {
+        return *cached;
+    }
 
-    // Данные
-    for (const auto& log : logs) {
-        file << log.timestamp << ","
-            << log.ip << ","
-            << log.method << ","
-            << "\"" << log.url << "\","
-            << log.status << "\n";
+    ensureIndexesBuilt();
+
+    // Один проход по записям в порядке времени: компактное состояние по IP
+    // отбирает кандидатов (оценка сверху, всплески не пропускаются)
+    RateDetector detector(static_cast<uint32_t>(maxRequests), windowSeconds, memoryBudget);
+    unordered_set<uint64_t> flagged;
+
+    for (size_t pos = 0; pos < timeIndex.size(); pos++) {
+        RowId row = timeIndex.rowAt(pos);
+        uint64_t key = RateDetector::packIP(logs[row].ip);
+        if (detector.observe(key, timeIndex.epochOf(row))) {
+            flagged.insert(key);
+        }
     }
 
-    file.close();
-    return true;
+    // Точная проверка по записям каждой строки IP с отмеченным ключом
+    // ("192.168.1.1" и "::ffff:192.168.1.1" дают один ключ). Если бюджета
+    // не хватило и активные IP вытеснялись, их счётчики потеряны - тогда
+    // проверяются все IP
+    bool checkAll = detector.evictions() > 0;
+    for (const auto& [ip, rows] : ipIndex.entries()) {
+        if (rows.size() <= static_cast<size_t>(maxRequests)) continue;
+        if (!checkAll && !flagged.count(RateDetector::packIP(ip))) continue;
+
+        vector<int64_t> epochs;
+        epochs.reserve(rows.size());
+        rows.forEach([this, &epochs](RowId row) {
+            epochs.push_back(timeIndex.epochOf(row));
+        });
+
+        uint32_t peak = maxRequestsInWindow(move(epochs), windowSeconds);
+        if (peak > static_cast<uint32_t>(maxRequests)) {
+            bursts.emplace_back(ip, static_cast<int>(peak));
+        }
+    }
+
+    sort(bursts.begin(), bursts.end(), [](const auto& a, const auto& b) {
+        if (a.second != b.second) return a.second > b.second;
+        return a.first < b.first;
+    });
+
+    return remember(key, move(bursts));
+}
+
+vector<AnomalyInterval> LogAnalyzer::findErrorRateAnomalies(const ErrorRateOptions& options,
+    int topURLs) const {
+    ensureIndexesBuilt();
+
+    // Самые частые URL по индексу
+    vector<string> urls;
+    if (topURLs > 0) {
+        vector<pair<string, size_t>> counts;
+        counts.reserve(urlIndex.distinctKeys());
+        for (const auto& [url, rows] : urlIndex.entries()) {
+            counts.emplace_back(url, rows.size());
+        }
+        size_t count = static_cast<size_t>(topURLs) < counts.size() ? topURLs : counts.size();
+        partial_sort(counts.begin(), counts.begin() + count, counts.end(),
+            [](const pair<string, size_t>& a, const pair<string, size_t>& b) {
+                if (a.second != b.second) return a.second > b.second;
+                return a.first < b.first;
+            });
+        for (size_t i = 0; i < count; i++) {
+            urls.push_back(counts[i].first);
+        }
+    }
+
+    ErrorRateDetector detector(options, urls);
+    for (size_t pos = 0; pos < timeIndex.size(); pos++) {
+        RowId row = timeIndex.rowAt(pos);
+        detector.add(timeIndex.epochOf(row), logs[row].status, logs[row].url);
+    }
+    detector.finish();
+    return detector.anomalies();
+}
+
+void LogAnalyzer::forEachSession(int gapSeconds, const Sessionizer::Sink& sink) const {
+    ensureIndexesBuilt();
+
+    Sessionizer sessionizer(gapSeconds, sink);
+    for (size_t pos = 0; pos < timeIndex.size(); pos++) {
+        RowId row = timeIndex.rowAt(pos);
+        sessionizer.add(logs[row].ip, timeIndex.epochOf(row), logs[row].status);
+    }
+    sessionizer.finish();
+}
+
+vector<Session> LogAnalyzer::getSessions(int gapSeconds) const {
+    vector<Session> sessions;
+    forEachSession(gapSeconds, [&sessions](const Session& session) {
+        sessions.push_back(session);
+    });
+
+    sort(sessions.begin(), sessions.end(), [](const Session& a, const Session& b) {
+        if (a.start != b.start) return a.start < b.start;
+        return a.ip < b.ip;
+    });
+    return sessions;
+}
+
+SessionStats LogAnalyzer::getSessionStats(int gapSeconds) const {
+    SessionStats stats;
+    forEachSession(gapSeconds, [&stats](const Session& session) {
+        stats.add(session);
+    });
+    return stats;
+}
+
+// Экспорт в CSV
+bool LogAnalyzer::exportToCSV(const string& filename, const CsvOptions& options) const {
+    return CsvWriter::write(filename, logs, nullptr, options);
+}
+
+// Экспорт выборки: записи берутся по номерам, без копирования
+bool LogAnalyzer::exportToCSV(const string& filename, const Selection& rows,
+    const CsvOptions& options) const {
+    if (rows.empty()) {
+        vector<RowId> none;
+        return CsvWriter::write(filename, logs, &none, options);
+    }
+    return CsvWriter::write(filename, rows.sourceLogs(), &rows.rowIds(), options);
 }
 
 // Экспорт в JSON
-bool LogAnalyzer::exportToJson(const string& filename) const {
-    try {
-        JsonValue jsonArray(JsonType::Array);
+bool LogAnalyzer::exportToJson(const string& filename, const JsonExportOptions& options) const {
+    return JsonWriter::write(filename, logs, nullptr, options);
+}
 
-        for (const auto& log : logs) {
-            map<string, JsonValue> obj;
-            obj["ts"] = JsonValue(log.timestamp);
-            obj["ip"] = JsonValue(log.ip);
-            obj["method"] = JsonValue(log.method);
-            obj["url"] = JsonValue(log.url);
-            obj["status"] = JsonValue(static_cast<double>(log.status));
+bool LogAnalyzer::exportToJson(const string& filename, const Selection& rows,
+    const JsonExportOptions& options) const {
+    if (rows.empty()) {
+        vector<RowId> none;
+        return JsonWriter::write(filename, logs, &none, options);
+    }
+    return JsonWriter::write(filename, rows.sourceLogs(), &rows.rowIds(), options);
+}
 
-            jsonArray.arrayValue.push_back(JsonValue(obj));
-        }
+// Экспорт в Arrow IPC
+bool LogAnalyzer::exportToArrow(const string& filename, const ArrowOptions& options) const {
+    ensureIndexesBuilt();
 
-        JsonParser::saveToFile(filename, jsonArray, true);
-        return true;
+    ArrowDictionaryColumn ips, methods, urls;
+    ips.fromIndex(ipIndex, logs.size());
+    methods.encode(logs, &LogEntry::method);
+    urls.fromIndex(urlIndex, logs.size());
+
+    ArrowTable table;
+    table.rows = logs.size();
+    table.epochs = timeIndex.epochColumn().data();
+    table.statuses = columns.status.data();
+    table.ips = ips.view();
+    table.methods = methods.view();
+    table.urls = urls.view();
+    return ArrowWriter::write(filename, table, nullptr, options);
+}
+
+// Выборка кодируется отдельно: в словарях только её значения
+bool LogAnalyzer::exportToArrow(const string& filename, const Selection& rows,
+    const ArrowOptions& options) const {
+    ArrowTable table;
+    if (rows.empty()) {
+        return ArrowWriter::write(filename, table, nullptr, options);
     }
-    catch (const exception&) {
+
+    const vector<LogEntry>& source = rows.sourceLogs();
+    const vector<RowId>& ids = rows.rowIds();
+    bool ownRows = &source == &logs;
+    if (ownRows) {
+        ensureIndexesBuilt();
+    }
+
+    vector<int64_t> epochs(ids.size());
+    vector<uint16_t> statuses(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+        const LogEntry& entry = source[ids[i]];
+        epochs[i] = ownRows ? timeIndex.epochOf(ids[i]) : TimeUtils::toEpochSeconds(entry.timestamp);
+        statuses[i] = static_cast<uint16_t>(entry.status);
+    }
+    ArrowDictionaryColumn ips, methods, urls;
+    ips.encode(source, &LogEntry::ip, &ids);
+    methods.encode(source, &LogEntry::method, &ids);
+    urls.encode(source, &LogEntry::url, &ids);
+
+    table.rows = ids.size();
+    table.epochs = epochs.data();
+    table.statuses = statuses.data();
+    table.ips = ips.view();
+    table.methods = methods.view();
+    table.urls = urls.view();
+    return ArrowWriter::write(filename, table, nullptr, options);
+}
+
+// Экспорт исходных байтов записей
+bool LogAnalyzer::exportOriginal(const string& filename, const Selection& rows) const {
+    if (rows.empty()) {
+        return SourceExport::writeRecords(filename, sourceFile, sourceSpans, {});
+    }
+    // Положения известны только для записей, загруженных из файла
+    if (&rows.sourceLogs() != &logs || sourceSpans.empty()) {
         return false;
     }
+    return SourceExport::writeRecords(filename, sourceFile, sourceSpans, rows.rowIds());
 }
 
 // Вспомогательная функция для проверки временного диапазона
@@ -343,63 +1080,129 @@ bool LogAnalyzer::isInTimeRange(const string& timestamp,
 
 // Извлечение домена из URL
 string LogAnalyzer::extractDomain(const string& url) {
-    // Простая реализация
-    size_t start = url.find("://");
-    if (start != string::npos) {
-        start += 3;
-    }
-    else {
-        start = 0;
-    }
-
-    size_t end = url.find('/', start);
-    if (end == string::npos) {
-        end = url.length();
-    }
-
-    return url.substr(start, end - start);
+    return string(urlDomainView(url));
 }
 
 // Извлечение пути из URL
 string LogAnalyzer::extractPath(const string& url) {
-    size_t start = url.find("://");
-    if (start != string::npos) {
-        start += 3;
-    }
-    else {
-        start = 0;
-    }
+    return string(urlPathView(url));
+}
 
-    size_t slashPos = url.find('/', start);
-    if (slashPos == string::npos) {
-        return "/";
-    }
+// Построение индексов по отдельным колонкам
+void LogAnalyzer::buildIPIndex() const {
+    ipIndex.build(logs, &LogEntry::ip);
+}
 
-    size_t queryPos = url.find('?', slashPos);
-    if (queryPos == string::npos) {
-        return url.substr(slashPos);
-    }
+void LogAnalyzer::buildURLIndex() const {
+    urlIndex.build(logs, &LogEntry::url);
+}
+
+void LogAnalyzer::buildTimeIndex() const {
+    timeIndex.build(logs);
+}
+
+void LogAnalyzer::buildBitmapIndex() const {
+    bitmapIndex.build(logs);
+}
 
-    return url.substr(slashPos, queryPos - slashPos);
+void LogAnalyzer::buildColumns() const {
+    columns.build(logs);
+}
+
+void LogAnalyzer::buildPathTrie() const {
+    pathTrie.build(logs);
+}
+
+// Дерево адресов ссылается на элементы индекса IP
+void LogAnalyzer::buildSubnetIndex() const {
+    subnetIndex.build(ipIndex);
+}
+
+// Куб строится после колонок и индекса времени
+void LogAnalyzer::buildRollup() const {
+    rollup.build(timeIndex, columns);
 }
 
 // Построение индексов для оптимизации
+// (на больших объёмах каждая колонка индексируется в нескольких потоках)
 void LogAnalyzer::ensureIndexesBuilt() const {
     if (indexesBuilt) return;
 
-    ipIndex.clear();
-    urlIndex.clear();
-    timeIndex.clear();
+    buildIPIndex();
+    buildURLIndex();
+    buildTimeIndex();
+    buildBitmapIndex();
+    buildColumns();
+    buildPathTrie();
+    buildSubnetIndex();
+    buildRollup();
+    finishIndexBuild();
+}
 
-    for (size_t i = 0; i < logs.size(); i++) {
-        ipIndex[logs[i].ip].push_back(i);
-        urlIndex[logs[i].url].push_back(i);
-        timeIndex[logs[i].timestamp].push_back(i);
-    }
+void LogAnalyzer::finishIndexBuild() const {
+    // Триграммы ссылаются на старый словарь URL и строятся заново по запросу
+    urlNGrams.clear();
+    urlNGramsBuilt = false;
+
+    topIPsCache.clear();
+    topURLsCache.clear();
 
     indexesBuilt = true;
 }
 
+void LogAnalyzer::buildIndexes() const {
+    ensureIndexesBuilt();
+    getURLNGramIndex();
+    getSampler();
+}
+
+void LogAnalyzer::appendToIndexes(RowId row) {
+    const LogEntry& entry = logs[row];
+
+    const auto& ip = ipIndex.add(entry.ip, row);
+    const auto& url = urlIndex.add(entry.url, row);
+    timeIndex.add(TimeUtils::toEpochSeconds(entry.timestamp));
+    bitmapIndex.add(entry, row);
+    columns.add(entry);
+    pathTrie.add(entry, row);
+    subnetIndex.add(ip);
+    rollup.add(timeIndex.epochOf(row), entry.status, static_cast<HttpMethod>(columns.method[row]));
+
+    // Новый URL попадает в словарь триграмм, если тот уже построен
+    if (urlNGramsBuilt && url.second.size() == 1) {
+        urlNGrams.add(url);
+    }
+
+    // Меняются счётчики только одного IP и одного URL
+    topIPsCache.update(ip.first, static_cast<int>(ip.second.size()));
+    topURLsCache.update(url.first, static_cast<int>(url.second.size()));
+}
+
+// Колонки для выражений; время берётся из индекса времени
+ColumnView LogAnalyzer::columnView() const {
+    ensureIndexesBuilt();
+
+    ColumnView view;
+    view.rows = logs.data();
+    view.status = columns.status.data();
+    view.method = columns.method.data();
+    view.epoch = timeIndex.epochColumn().data();
+    view.size = logs.size();
+    return view;
+}
+
+// Копирование записей по списку номеров
+vector<LogEntry> LogAnalyzer::collectRows(const vector<RowId>& rows) const {
+    vector<LogEntry> result;
+    result.reserve(rows.size());
+
+    for (RowId row : rows) {
+        result.push_back(logs[row]);
+    }
+
+    return result;
+}
+
 // Утилиты для работы со временем
 namespace TimeUtils {
 
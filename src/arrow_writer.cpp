@@ -0,0 +1,578 @@
+﻿#include "arrow_writer.h"
+#include "snapshot_file.h"
+#include "time_utils.h"
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <climits>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+using namespace std;
+
+// Файл Arrow: "ARROW1" и два нулевых байта, сообщения потокового формата
+// (схема, словари, пакеты записей, маркер конца), затем оглавление
+// (footer), его длина и снова "ARROW1"
+static const char MAGIC[6] = { 'A', 'R', 'R', 'O', 'W', '1' };
+static const char ZEROS[8] = {};
+
+// Значения перечислений из схемы Arrow (Schema.fbs, Message.fbs)
+const int16_t METADATA_V5 = 4;
+const uint8_t HEADER_SCHEMA = 1;
+const uint8_t HEADER_DICTIONARY_BATCH = 2;
+const uint8_t HEADER_RECORD_BATCH = 3;
+const uint8_t TYPE_INT = 2;
+const uint8_t TYPE_TIMESTAMP = 10;
+const uint8_t TYPE_LARGE_UTF8 = 20;
+const int16_t UNIT_SECOND = 0;
+
+// Структуры flatbuffers в том виде, в каком они лежат в буфере
+struct ArrowFieldNode {
+    int64_t length;
+    int64_t nullCount;
+};
+
+struct ArrowBuffer {
+    int64_t offset;             // от начала тела сообщения
+    int64_t length;
+};
+
+// ==================== Flatbuffers ====================
+
+// Сборка flatbuffer с конца, как в библиотеке flatbuffers: вложенные
+// объекты пишутся раньше ссылающихся на них. Ссылка на объект -
+// расстояние от конца буфера до его начала. Метаданные занимают сотни
+// байт, поэтому буфер просто дописывается спереди.
+class FlatBuilder {
+private:
+    string data;
+    size_t minAlign = 1;
+    size_t tableEnd = 0;
+    vector<pair<size_t, size_t>> fields;    // (номер поля, ссылка)
+
+    void prepend(const void* bytes, size_t size) {
+        data.insert(0, static_cast<const char*>(bytes), size);
+    }
+
+    // Выравнивание: после записи ещё extra байт размер кратен align
+    void preAlign(size_t extra, size_t align) {
+        if (align > minAlign) minAlign = align;
+        data.insert(static_cast<size_t>(0), (align - (data.size() + extra) % align) % align, '\0');
+    }
+
+    template<typename T>
+    void push(T value) {
+        preAlign(sizeof(T), sizeof(T));
+        prepend(&value, sizeof(T));
+    }
+
+    void pushOffset(uint32_t ref) {
+        preAlign(4, 4);
+        uint32_t offset = static_cast<uint32_t>(data.size() + 4 - ref);
+        prepend(&offset, 4);
+    }
+
+public:
+    uint32_t size() const { return static_cast<uint32_t>(data.size()); }
+
+    uint32_t createString(string_view value) {
+        preAlign(value.size() + 1, 4);
+        data.insert(static_cast<size_t>(0), 1, '\0');
+        prepend(value.data(), value.size());
+        push(static_cast<uint32_t>(value.size()));
+        return size();
+    }
+
+    uint32_t createOffsetVector(const vector<uint32_t>& refs) {
+        preAlign(refs.size() * 4, 4);
+        for (size_t i = refs.size(); i-- > 0;) {
+            pushOffset(refs[i]);
+        }
+        push(static_cast<uint32_t>(refs.size()));
+        return size();
+    }
+
+    template<typename T>
+    uint32_t createStructVector(const vector<T>& items) {
+        preAlign(items.size() * sizeof(T), 4);
+        preAlign(items.size() * sizeof(T), 8);
+        if (!items.empty()) {
+            prepend(items.data(), items.size() * sizeof(T));
+        }
+        push(static_cast<uint32_t>(items.size()));
+        return size();
+    }
+
+    // Таблица: поля между startTable и endTable, вложенные объекты - до неё
+    void startTable() {
+        fields.clear();
+        tableEnd = size();
+    }
+
+    template<typename T>
+    void addScalar(size_t field, T value) {
+        push(value);
+        fields.emplace_back(field, size());
+    }
+
+    void addOffset(size_t field, uint32_t ref) {
+        pushOffset(ref);
+        fields.emplace_back(field, size());
+    }
+
+    // Смещение таблицы до vtable (размеры и положения полей) пишется
+    // в её начало после того, как vtable записана перед таблицей
+    uint32_t endTable() {
+        push(static_cast<int32_t>(0));
+        uint32_t table = size();
+
+        size_t slots = 0;
+        for (const auto& field : fields) {
+            if (field.first + 1 > slots) slots = field.first + 1;
+        }
+        vector<uint16_t> vtable(2 + slots, 0);
+        vtable[0] = static_cast<uint16_t>(vtable.size() * sizeof(uint16_t));
+        vtable[1] = static_cast<uint16_t>(table - tableEnd);
+        for (const auto& [field, ref] : fields) {
+            vtable[2 + field] = static_cast<uint16_t>(table - ref);
+        }
+        prepend(vtable.data(), vtable.size() * sizeof(uint16_t));
+
+        int32_t toVtable = static_cast<int32_t>(size() - table);
+        memcpy(&data[data.size() - table], &toVtable, sizeof(toVtable));
+        return table;
+    }
+
+    string finish(uint32_t root) {
+        preAlign(4, minAlign);
+        pushOffset(root);
+        return data;
+    }
+};
+
+// Поле схемы; dictionary = 0 - без словаря
+static uint32_t buildField(FlatBuilder& builder, const char* name, uint8_t typeKind,
+    uint32_t type, uint32_t dictionary) {
+    uint32_t nameRef = builder.createString(name);
+    uint32_t children = builder.createOffsetVector({});
+
+    builder.startTable();
+    builder.addOffset(0, nameRef);
+    builder.addScalar<uint8_t>(1, 0);           // nullable
+    builder.addScalar<uint8_t>(2, typeKind);
+    builder.addOffset(3, type);
+    if (dictionary) builder.addOffset(4, dictionary);
+    builder.addOffset(5, children);
+    return builder.endTable();
+}
+
+static uint32_t buildIntType(FlatBuilder& builder, int32_t bitWidth, bool isSigned) {
+    builder.startTable();
+    builder.addScalar<int32_t>(0, bitWidth);
+    builder.addScalar<uint8_t>(1, isSigned ? 1 : 0);
+    return builder.endTable();
+}
+
+// Строки со словарём: значения large_string, номера int32
+static uint32_t buildDictionaryField(FlatBuilder& builder, const char* name, int64_t id) {
+    builder.startTable();
+    uint32_t valueType = builder.endTable();
+    uint32_t indexType = buildIntType(builder, 32, true);
+
+    builder.startTable();
+    builder.addScalar<int64_t>(0, id);
+    builder.addOffset(1, indexType);
+    builder.addScalar<uint8_t>(2, 0);           // isOrdered
+    uint32_t encoding = builder.endTable();
+
+    return buildField(builder, name, TYPE_LARGE_UTF8, valueType, encoding);
+}
+
+// Строки без словаря
+static uint32_t buildStringField(FlatBuilder& builder, const char* name) {
+    builder.startTable();
+    uint32_t type = builder.endTable();
+    return buildField(builder, name, TYPE_LARGE_UTF8, type, 0);
+}
+
+// ts, ip, method, url, status; номера словарей - 0, 1, 2
+static uint32_t buildSchema(FlatBuilder& builder, bool dictionaries) {
+    vector<uint32_t> fields;
+
+    uint32_t timezone = builder.createString("UTC");
+    builder.startTable();
+    builder.addScalar<int16_t>(0, UNIT_SECOND);
+    builder.addOffset(1, timezone);
+    uint32_t timestamp = builder.endTable();
+    fields.push_back(buildField(builder, "ts", TYPE_TIMESTAMP, timestamp, 0));
+
+    const char* names[] = { "ip", "method", "url" };
+    for (int64_t id = 0; id < 3; id++) {
+        fields.push_back(dictionaries ? buildDictionaryField(builder, names[id], id)
+            : buildStringField(builder, names[id]));
+    }
+    fields.push_back(buildField(builder, "status", TYPE_INT, buildIntType(builder, 16, false), 0));
+
+    uint32_t fieldVector = builder.createOffsetVector(fields);
+    builder.startTable();
+    builder.addScalar<int16_t>(0, 0);           // little-endian
+    builder.addOffset(1, fieldVector);
+    return builder.endTable();
+}
+
+// ==================== Сообщения ====================
+
+// Тело сообщения - куски памяти колонок без копирования; каждый буфер
+// дополняется нулями до кратного 8 размера
+struct MessageBody {
+    vector<pair<const char*, size_t>> pieces;
+    vector<ArrowBuffer> buffers;
+    int64_t length = 0;
+
+    void add(const void* data, size_t size) {
+        buffers.push_back({ length, static_cast<int64_t>(size) });
+        if (size > 0) {
+            pieces.emplace_back(static_cast<const char*>(data), size);
+        }
+        size_t padding = (8 - size % 8) % 8;
+        if (padding > 0) {
+            pieces.emplace_back(ZEROS, padding);
+        }
+        length += static_cast<int64_t>(size + padding);
+    }
+
+    // Битовая карта null не нужна: пропусков нет
+    void addNoNulls() {
+        buffers.push_back({ length, 0 });
+    }
+};
+
+static uint32_t buildRecordBatch(FlatBuilder& builder, int64_t rows, size_t columns,
+    const MessageBody& body) {
+    vector<ArrowFieldNode> nodes(columns, ArrowFieldNode{ rows, 0 });
+    uint32_t nodeVector = builder.createStructVector(nodes);
+    uint32_t bufferVector = builder.createStructVector(body.buffers);
+
+    builder.startTable();
+    builder.addScalar<int64_t>(0, rows);
+    builder.addOffset(1, nodeVector);
+    builder.addOffset(2, bufferVector);
+    return builder.endTable();
+}
+
+static string buildMessage(FlatBuilder& builder, uint8_t headerKind, uint32_t header,
+    int64_t bodyLength) {
+    builder.startTable();
+    builder.addScalar<int64_t>(3, bodyLength);
+    builder.addScalar<int16_t>(0, METADATA_V5);
+    builder.addScalar<uint8_t>(1, headerKind);
+    builder.addOffset(2, header);
+    return builder.finish(builder.endTable());
+}
+
+// Маркер продолжения, длина метаданных, метаданные до кратного 8, тело
+static bool writeMessage(ofstream& out, const string& metadata, const MessageBody* body,
+    vector<ArrowBlock>* blocks) {
+    ArrowBlock block = {};
+    block.offset = static_cast<int64_t>(out.tellp());
+
+    size_t padding = (8 - metadata.size() % 8) % 8;
+    uint32_t continuation = 0xFFFFFFFF;
+    int32_t length = static_cast<int32_t>(metadata.size() + padding);
+    out.write(reinterpret_cast<const char*>(&continuation), sizeof(continuation));
+    out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.write(metadata.data(), static_cast<streamsize>(metadata.size()));
+    out.write(ZEROS, static_cast<streamsize>(padding));
+
+    if (body) {
+        for (const auto& piece : body->pieces) {
+            out.write(piece.first, static_cast<streamsize>(piece.second));
+        }
+        block.bodyLength = body->length;
+    }
+    block.metadataLength = length + 8;
+    if (blocks) {
+        blocks->push_back(block);
+    }
+    return static_cast<bool>(out);
+}
+
+static bool writeDictionary(ofstream& out, const ArrowStringColumn& column, int64_t id,
+    vector<ArrowBlock>& blocks) {
+    static const uint64_t EMPTY_OFFSET = 0;
+    const uint64_t* offsets = column.offsets ? column.offsets : &EMPTY_OFFSET;
+    size_t count = column.offsets ? column.count : 0;
+
+    MessageBody body;
+    body.addNoNulls();
+    body.add(offsets, (count + 1) * sizeof(uint64_t));
+    body.add(column.bytes, static_cast<size_t>(offsets[count]));
+
+    FlatBuilder builder;
+    uint32_t data = buildRecordBatch(builder, static_cast<int64_t>(count), 1, body);
+    builder.startTable();
+    builder.addScalar<int64_t>(0, id);
+    builder.addOffset(1, data);
+    uint32_t dictionaryBatch = builder.endTable();
+
+    string metadata = buildMessage(builder, HEADER_DICTIONARY_BATCH, dictionaryBatch, body.length);
+    return writeMessage(out, metadata, &body, &blocks);
+}
+
+// Начало файла: сигнатура и схема
+static void writeFileStart(ofstream& out, bool dictionaries) {
+    out.write(MAGIC, sizeof(MAGIC));
+    out.write(ZEROS, 2);
+
+    FlatBuilder builder;
+    uint32_t schema = buildSchema(builder, dictionaries);
+    writeMessage(out, buildMessage(builder, HEADER_SCHEMA, schema, 0), nullptr, nullptr);
+}
+
+// Маркер конца потока, оглавление, его длина и сигнатура
+static bool writeFileEnd(ofstream& out, bool dictionaries,
+    const vector<ArrowBlock>& dictionaryBlocks, const vector<ArrowBlock>& batches) {
+    uint32_t endOfStream[2] = { 0xFFFFFFFF, 0 };
+    out.write(reinterpret_cast<const char*>(endOfStream), sizeof(endOfStream));
+
+    FlatBuilder builder;
+    uint32_t schema = buildSchema(builder, dictionaries);
+    uint32_t dictionaryVector = builder.createStructVector(dictionaryBlocks);
+    uint32_t batchVector = builder.createStructVector(batches);
+    builder.startTable();
+    builder.addScalar<int16_t>(0, METADATA_V5);
+    builder.addOffset(1, schema);
+    builder.addOffset(2, dictionaryVector);
+    builder.addOffset(3, batchVector);
+    string footer = builder.finish(builder.endTable());
+
+    int32_t footerLength = static_cast<int32_t>(footer.size());
+    out.write(footer.data(), static_cast<streamsize>(footer.size()));
+    out.write(reinterpret_cast<const char*>(&footerLength), sizeof(footerLength));
+    out.write(MAGIC, sizeof(MAGIC));
+    out.close();
+    return !out.fail();
+}
+
+// Собранные колонки пакета для выборки строк
+struct BatchColumns {
+    vector<int64_t> epochs;
+    vector<uint32_t> ips;
+    vector<uint32_t> methods;
+    vector<uint32_t> urls;
+    vector<uint16_t> statuses;
+
+    void gather(const ArrowTable& table, const RowId* rows, size_t count) {
+        epochs.resize(count);
+        ips.resize(count);
+        methods.resize(count);
+        urls.resize(count);
+        statuses.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            RowId row = rows[i];
+            epochs[i] = table.epochs[row];
+            ips[i] = table.ips.ids[row];
+            methods[i] = table.methods.ids[row];
+            urls[i] = table.urls.ids[row];
+            statuses[i] = table.statuses[row];
+        }
+    }
+};
+
+// ==================== ArrowDictionaryColumn ====================
+
+void ArrowDictionaryColumn::encode(const vector<LogEntry>& logs, string LogEntry::* column,
+    const vector<RowId>* rows) {
+    unordered_map<string_view, uint32_t, WindowsStringHash> known;
+    size_t count = rows ? rows->size() : logs.size();
+    ids.assign(count, 0);
+    offsets.assign(1, 0);
+    bytes.clear();
+
+    for (size_t i = 0; i < count; i++) {
+        const string& value = logs[rows ? (*rows)[i] : i].*column;
+        auto inserted = known.try_emplace(value, static_cast<uint32_t>(offsets.size() - 1));
+        if (inserted.second) {
+            bytes += value;
+            offsets.push_back(bytes.size());
+        }
+        ids[i] = inserted.first->second;
+    }
+}
+
+void ArrowDictionaryColumn::fromIndex(const HashIndex& index, size_t rows) {
+    ids.assign(rows, 0);
+    offsets.assign(1, 0);
+    offsets.reserve(index.distinctKeys() + 1);
+    bytes.clear();
+
+    vector<const HashIndex::Map::value_type*> keys;
+    keys.reserve(index.distinctKeys());
+    for (const auto& entry : index.entries()) {
+        if (!entry.second.empty()) keys.push_back(&entry);
+    }
+    sort(keys.begin(), keys.end(), [](const auto* a, const auto* b) {
+        return a->second.front() < b->second.front();
+    });
+
+    for (const auto* entry : keys) {
+        uint32_t id = static_cast<uint32_t>(offsets.size() - 1);
+        bytes += entry->first;
+        offsets.push_back(bytes.size());
+        entry->second.forEach([this, id](RowId row) { ids[row] = id; });
+    }
+}
+
+ArrowStringColumn ArrowDictionaryColumn::view() const {
+    ArrowStringColumn column;
+    column.ids = ids.data();
+    column.offsets = offsets.data();
+    column.bytes = bytes.data();
+    column.count = offsets.size() - 1;
+    return column;
+}
+
+// ==================== ArrowWriter ====================
+
+namespace ArrowWriter {
+
+    ArrowTable fromSnapshot(const SnapshotFile& snapshot) {
+        auto column = [](const uint32_t* ids, const SnapshotDictionary& dictionary) {
+            ArrowStringColumn result;
+            result.ids = ids;
+            result.offsets = dictionary.offsetTable();
+            result.bytes = dictionary.data();
+            result.count = dictionary.size();
+            return result;
+        };
+
+        ArrowTable table;
+        table.rows = snapshot.size();
+        table.epochs = snapshot.epochColumn();
+        table.statuses = snapshot.statusColumn();
+        table.ips = column(snapshot.ipColumn(), snapshot.ipDictionary());
+        table.methods = column(snapshot.methodIdColumn(), snapshot.methodDictionary());
+        table.urls = column(snapshot.urlColumn(), snapshot.urlDictionary());
+        return table;
+    }
+
+    bool write(const string& filename, const ArrowTable& table, const vector<RowId>* rows,
+        const ArrowOptions& options) {
+        // Номера в словаре - int32
+        for (const ArrowStringColumn* column : { &table.ips, &table.methods, &table.urls }) {
+            if (column->count > static_cast<size_t>(INT32_MAX)) return false;
+        }
+
+        ofstream out(filename, ios::binary | ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+        writeFileStart(out, true);
+
+        vector<ArrowBlock> dictionaries;
+        writeDictionary(out, table.ips, 0, dictionaries);
+        writeDictionary(out, table.methods, 1, dictionaries);
+        writeDictionary(out, table.urls, 2, dictionaries);
+
+        size_t total = rows ? rows->size() : table.rows;
+        size_t batchRows = options.batchRows > 0 ? options.batchRows : total;
+        vector<ArrowBlock> batches;
+        BatchColumns gathered;
+
+        for (size_t begin = 0; begin < total && out; begin += batchRows) {
+            size_t count = total - begin < batchRows ? total - begin : batchRows;
+            const int64_t* epochs = table.epochs + begin;
+            const uint32_t* ips = table.ips.ids + begin;
+            const uint32_t* methods = table.methods.ids + begin;
+            const uint32_t* urls = table.urls.ids + begin;
+            const uint16_t* statuses = table.statuses + begin;
+            if (rows) {
+                gathered.gather(table, rows->data() + begin, count);
+                epochs = gathered.epochs.data();
+                ips = gathered.ips.data();
+                methods = gathered.methods.data();
+                urls = gathered.urls.data();
+                statuses = gathered.statuses.data();
+            }
+
+            MessageBody body;
+            body.addNoNulls();
+            body.add(epochs, count * sizeof(int64_t));
+            for (const uint32_t* ids : { ips, methods, urls }) {
+                body.addNoNulls();
+                body.add(ids, count * sizeof(uint32_t));
+            }
+            body.addNoNulls();
+            body.add(statuses, count * sizeof(uint16_t));
+
+            FlatBuilder builder;
+            uint32_t batch = buildRecordBatch(builder, static_cast<int64_t>(count), 5, body);
+            writeMessage(out, buildMessage(builder, HEADER_RECORD_BATCH, batch, body.length),
+                &body, &batches);
+        }
+
+        return writeFileEnd(out, true, dictionaries, batches);
+    }
+}
+
+// ==================== ArrowStreamWriter ====================
+
+bool ArrowStreamWriter::open(const string& filename) {
+    batches.clear();
+    out.open(filename, ios::binary | ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+    writeFileStart(out, false);
+    return static_cast<bool>(out);
+}
+
+bool ArrowStreamWriter::write(const vector<LogEntry>& batch) {
+    if (!out.is_open()) {
+        return false;
+    }
+    if (batch.empty()) {
+        return static_cast<bool>(out);
+    }
+
+    string LogEntry::* columns[] = { &LogEntry::ip, &LogEntry::method, &LogEntry::url };
+    epochs.resize(batch.size());
+    statuses.resize(batch.size());
+    for (size_t c = 0; c < 3; c++) {
+        offsets[c].assign(1, 0);
+        bytes[c].clear();
+    }
+    for (size_t i = 0; i < batch.size(); i++) {
+        const LogEntry& entry = batch[i];
+        epochs[i] = TimeUtils::toEpochSeconds(entry.timestamp);
+        statuses[i] = static_cast<uint16_t>(entry.status);
+        for (size_t c = 0; c < 3; c++) {
+            bytes[c] += entry.*columns[c];
+            offsets[c].push_back(bytes[c].size());
+        }
+    }
+
+    MessageBody body;
+    body.addNoNulls();
+    body.add(epochs.data(), epochs.size() * sizeof(int64_t));
+    for (size_t c = 0; c < 3; c++) {
+        body.addNoNulls();
+        body.add(offsets[c].data(), offsets[c].size() * sizeof(uint64_t));
+        body.add(bytes[c].data(), bytes[c].size());
+    }
+    body.addNoNulls();
+    body.add(statuses.data(), statuses.size() * sizeof(uint16_t));
+
+    FlatBuilder builder;
+    uint32_t header = buildRecordBatch(builder, static_cast<int64_t>(batch.size()), 5, body);
+    return writeMessage(out, buildMessage(builder, HEADER_RECORD_BATCH, header, body.length),
+        &body, &batches);
+}
+
+bool ArrowStreamWriter::close() {
+    if (!out.is_open()) {
+        return false;
+    }
+    return writeFileEnd(out, false, {}, batches);
+}
@@ -0,0 +1,336 @@
+﻿#include "bitmap.h"
+#include <algorithm>
+#include <iterator>
+
+using namespace std;
+
+// ==================== Контейнер ====================
+
+bool RoaringBitmap::Container::contains(uint16_t low) const {
+    if (isBitset()) {
+        return (bits[low >> 6] >> (low & 63)) & 1;
+    }
+    return binary_search(array.begin(), array.end(), low);
+}
+
+void RoaringBitmap::Container::add(uint16_t low) {
+    if (isBitset()) {
+        uint64_t mask = uint64_t(1) << (low & 63);
+        if (!(bits[low >> 6] & mask)) {
+            bits[low >> 6] |= mask;
+            cardinality++;
+        }
+        return;
+    }
+
+    // Быстрый путь: добавление по возрастанию
+    if (array.empty() || array.back() < low) {
+        array.push_back(low);
+    }
+    else {
+        auto it = lower_bound(array.begin(), array.end(), low);
+        if (*it == low) return;
+        array.insert(it, low);
+    }
+    cardinality++;
+
+    if (cardinality > ARRAY_LIMIT) {
+        toBitset();
+    }
+}
+
+void RoaringBitmap::Container::toBitset() {
+    if (isBitset()) return;
+    bits.assign(BITSET_WORDS, 0);
+    for (uint16_t low : array) {
+        bits[low >> 6] |= uint64_t(1) << (low & 63);
+    }
+    vector<uint16_t>().swap(array);
+}
+
+void RoaringBitmap::Container::normalize() {
+    if (isBitset() && cardinality <= ARRAY_LIMIT) {
+        array.reserve(cardinality);
+        for (size_t w = 0; w < BITSET_WORDS; w++) {
+            uint64_t word = bits[w];
+            while (word) {
+                array.push_back(static_cast<uint16_t>(w * 64 + countTrailingZeros(word)));
+                word &= word - 1;
+            }
+        }
+        vector<uint64_t>().swap(bits);
+    }
+    else if (!isBitset() && cardinality > ARRAY_LIMIT) {
+        toBitset();
+    }
+}
+
+// Пересечение блоков
+RoaringBitmap::Container RoaringBitmap::andContainers(const Container& a, const Container& b) {
+    Container result;
+    result.key = a.key;
+
+    if (a.isBitset() && b.isBitset()) {
+        result.bits.resize(BITSET_WORDS);
+        uint32_t count = 0;
+        for (size_t w = 0; w < BITSET_WORDS; w++) {
+            result.bits[w] = a.bits[w] & b.bits[w];
+            count += popcount(result.bits[w]);
+        }
+        result.cardinality = count;
+        result.normalize();
+    }
+    else if (a.isBitset() || b.isBitset()) {
+        const Container& arr = a.isBitset() ? b : a;
+        const Container& set = a.isBitset() ? a : b;
+        for (uint16_t low : arr.array) {
+            if (set.contains(low)) result.array.push_back(low);
+        }
+        result.cardinality = static_cast<uint32_t>(result.array.size());
+    }
+    else {
+        set_intersection(a.array.begin(), a.array.end(),
+            b.array.begin(), b.array.end(), back_inserter(result.array));
+        result.cardinality = static_cast<uint32_t>(result.array.size());
+    }
+
+    return result;
+}
+
+// Объединение блоков
+RoaringBitmap::Container RoaringBitmap::orContainers(const Container& a, const Container& b) {
+    Container result;
+    result.key = a.key;
+
+    if (!a.isBitset() && !b.isBitset() && a.cardinality + b.cardinality <= ARRAY_LIMIT) {
+        set_union(a.array.begin(), a.array.end(),
+            b.array.begin(), b.array.end(), back_inserter(result.array));
+        result.cardinality = static_cast<uint32_t>(result.array.size());
+        return result;
+    }
+
+    result.bits.assign(BITSET_WORDS, 0);
+    for (const Container* c : { &a, &b }) {
+        if (c->isBitset()) {
+            for (size_t w = 0; w < BITSET_WORDS; w++) result.bits[w] |= c->bits[w];
+        }
+        else {
+            for (uint16_t low : c->array) result.bits[low >> 6] |= uint64_t(1) << (low & 63);
+        }
+    }
+
+    uint32_t count = 0;
+    for (size_t w = 0; w < BITSET_WORDS; w++) count += popcount(result.bits[w]);
+    result.cardinality = count;
+    result.normalize();
+    return result;
+}
+
+// Разность блоков a \ b
+RoaringBitmap::Container RoaringBitmap::andNotContainers(const Container& a, const Container& b) {
+    Container result;
+    result.key = a.key;
+
+    if (!a.isBitset()) {
+        if (b.isBitset()) {
+            for (uint16_t low : a.array) {
+                if (!b.contains(low)) result.array.push_back(low);
+            }
+        }
+        else {
+            set_difference(a.array.begin(), a.array.end(),
+                b.array.begin(), b.array.end(), back_inserter(result.array));
+        }
+        result.cardinality = static_cast<uint32_t>(result.array.size());
+        return result;
+    }
+
+    result.bits = a.bits;
+    if (b.isBitset()) {
+        for (size_t w = 0; w < BITSET_WORDS; w++) result.bits[w] &= ~b.bits[w];
+    }
+    else {
+        for (uint16_t low : b.array) result.bits[low >> 6] &= ~(uint64_t(1) << (low & 63));
+    }
+
+    uint32_t count = 0;
+    for (size_t w = 0; w < BITSET_WORDS; w++) count += popcount(result.bits[w]);
+    result.cardinality = count;
+    result.normalize();
+    return result;
+}
+
+// ==================== RoaringBitmap ====================
+
+RoaringBitmap::Container* RoaringBitmap::findContainer(uint16_t key) {
+    auto it = lower_bound(containers.begin(), containers.end(), key,
+        [](const Container& c, uint16_t k) { return c.key < k; });
+    return (it != containers.end() && it->key == key) ? &*it : nullptr;
+}
+
+const RoaringBitmap::Container* RoaringBitmap::findContainer(uint16_t key) const {
+    auto it = lower_bound(containers.begin(), containers.end(), key,
+        [](const Container& c, uint16_t k) { return c.key < k; });
+    return (it != containers.end() && it->key == key) ? &*it : nullptr;
+}
+
+RoaringBitmap RoaringBitmap::range(uint32_t count) {
+    RoaringBitmap result;
+    uint32_t fullBlocks = count >> 16;
+    uint32_t rest = count & 0xFFFF;
+
+    for (uint32_t block = 0; block <= fullBlocks; block++) {
+        uint32_t size = block < fullBlocks ? 65536 : rest;
+        if (size == 0) break;
+
+        Container c;
+        c.key = static_cast<uint16_t>(block);
+        c.bits.assign(BITSET_WORDS, 0);
+        for (uint32_t w = 0; w < size / 64; w++) c.bits[w] = ~uint64_t(0);
+        if (size % 64) c.bits[size / 64] = (uint64_t(1) << (size % 64)) - 1;
+        c.cardinality = size;
+        c.normalize();
+        result.containers.push_back(move(c));
+    }
+
+    return result;
+}
+
+void RoaringBitmap::add(uint32_t value) {
+    uint16_t key = static_cast<uint16_t>(value >> 16);
+    uint16_t low = static_cast<uint16_t>(value & 0xFFFF);
+
+    // Быстрый путь: добавление в последний блок
+    if (!containers.empty() && containers.back().key == key) {
+        containers.back().add(low);
+        return;
+    }
+
+    if (containers.empty() || containers.back().key < key) {
+        containers.emplace_back();
+        containers.back().key = key;
+        containers.back().add(low);
+        return;
+    }
+
+    Container* c = findContainer(key);
+    if (!c) {
+        auto it = lower_bound(containers.begin(), containers.end(), key,
+            [](const Container& cont, uint16_t k) { return cont.key < k; });
+        it = containers.insert(it, Container());
+        it->key = key;
+        c = &*it;
+    }
+    c->add(low);
+}
+
+bool RoaringBitmap::contains(uint32_t value) const {
+    const Container* c = findContainer(static_cast<uint16_t>(value >> 16));
+    return c && c->contains(static_cast<uint16_t>(value & 0xFFFF));
+}
+
+uint64_t RoaringBitmap::cardinality() const {
+    uint64_t total = 0;
+    for (const auto& c : containers) {
+        total += c.cardinality;
+    }
+    return total;
+}
+
+RoaringBitmap RoaringBitmap::operator&(const RoaringBitmap& other) const {
+    RoaringBitmap result;
+    size_t i = 0, j = 0;
+    while (i < containers.size() && j < other.containers.size()) {
+        if (containers[i].key < other.containers[j].key) i++;
+        else if (containers[i].key > other.containers[j].key) j++;
+        else {
+            Container c = andContainers(containers[i++], other.containers[j++]);
+            if (c.cardinality > 0) result.containers.push_back(move(c));
+        }
+    }
+    return result;
+}
+
+RoaringBitmap RoaringBitmap::operator|(const RoaringBitmap& other) const {
+    RoaringBitmap result;
+    size_t i = 0, j = 0;
+    while (i < containers.size() || j < other.containers.size()) {
+        if (j == other.containers.size() ||
+            (i < containers.size() && containers[i].key < other.containers[j].key)) {
+            result.containers.push_back(containers[i++]);
+        }
+        else if (i == containers.size() || containers[i].key > other.containers[j].key) {
+            result.containers.push_back(other.containers[j++]);
+        }
+        else {
+            result.containers.push_back(orContainers(containers[i++], other.containers[j++]));
+        }
+    }
+    return result;
+}
+
+RoaringBitmap RoaringBitmap::andNot(const RoaringBitmap& other) const {
+    RoaringBitmap result;
+    size_t j = 0;
+    for (const auto& c : containers) {
+        while (j < other.containers.size() && other.containers[j].key < c.key) j++;
+        if (j < other.containers.size() && other.containers[j].key == c.key) {
+            Container diff = andNotContainers(c, other.containers[j]);
+            if (diff.cardinality > 0) result.containers.push_back(move(diff));
+        }
+        else {
+            result.containers.push_back(c);
+        }
+    }
+    return result;
+}
+
+uint64_t RoaringBitmap::andCardinality(const RoaringBitmap& other) const {
+    uint64_t total = 0;
+    size_t i = 0, j = 0;
+    while (i < containers.size() && j < other.containers.size()) {
+        const Container& a = containers[i];
+        const Container& b = other.containers[j];
+        if (a.key < b.key) { i++; continue; }
+        if (a.key > b.key) { j++; continue; }
+
+        if (a.isBitset() && b.isBitset()) {
+            for (size_t w = 0; w < BITSET_WORDS; w++) total += popcount(a.bits[w] & b.bits[w]);
+        }
+        else {
+            total += andContainers(a, b).cardinality;
+        }
+        i++;
+        j++;
+    }
+    return total;
+}
+
+vector<uint32_t> RoaringBitmap::toVector() const {
+    vector<uint32_t> result;
+    result.reserve(cardinality());
+    forEach([&result](uint32_t value) { result.push_back(value); });
+    return result;
+}
+
+size_t RoaringBitmap::memoryBytes() const {
+    size_t total = 0;
+    for (const auto& c : containers) {
+        total += sizeof(Container) + c.array.capacity() * sizeof(uint16_t) +
+            c.bits.capacity() * sizeof(uint64_t);
+    }
+    return total;
+}
+
+bool RoaringBitmap::operator==(const RoaringBitmap& other) const {
+    if (containers.size() != other.containers.size()) return false;
+    for (size_t i = 0; i < containers.size(); i++) {
+        const Container& a = containers[i];
+        const Container& b = other.containers[i];
+        if (a.key != b.key || a.cardinality != b.cardinality ||
+            a.array != b.array || a.bits != b.bits) {
+            return false;
+        }
+    }
+    return true;
+}
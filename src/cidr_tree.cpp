@@ -0,0 +1,527 @@
+﻿#include "cidr_tree.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+// Число старших нулевых бит (word != 0)
+static int countLeadingZeros(uint64_t word) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, word);
+    return 63 - static_cast<int>(index);
+#else
+    return __builtin_clzll(word);
+#endif
+}
+
+// ==================== IPAddress ====================
+
+IPAddress IPAddress::masked(int bits) const {
+    IPAddress result = *this;
+    if (bits >= 128) return result;
+
+    if (bits <= 64) {
+        result.hi = bits == 0 ? 0 : hi & (~0ULL << (64 - bits));
+        result.lo = 0;
+    }
+    else {
+        result.lo = lo & (~0ULL << (128 - bits));
+    }
+    return result;
+}
+
+int IPAddress::commonPrefix(const IPAddress& a, const IPAddress& b) {
+    uint64_t x = a.hi ^ b.hi;
+    if (x) return countLeadingZeros(x);
+    uint64_t y = a.lo ^ b.lo;
+    if (y) return 64 + countLeadingZeros(y);
+    return 128;
+}
+
+// ==================== Разбор адресов ====================
+
+static bool parseIPv4(string_view text, uint32_t& out) {
+    uint32_t value = 0;
+    int parts = 0;
+    size_t pos = 0;
+
+    while (parts < 4) {
+        size_t digits = 0;
+        uint32_t part = 0;
+        while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9' && digits < 3) {
+            part = part * 10 + (text[pos] - '0');
+            pos++;
+            digits++;
+        }
+        if (digits == 0 || part > 255) return false;
+
+        value = (value << 8) | part;
+        parts++;
+
+        if (parts < 4) {
+            if (pos >= text.size() || text[pos] != '.') return false;
+            pos++;
+        }
+    }
+
+    out = value;
+    return pos == text.size();
+}
+
+// Группы IPv6 через ':'; последней группой может быть IPv4 ("::ffff:1.2.3.4")
+static bool parseIPv6Groups(string_view part, vector<uint16_t>& out, bool allowIPv4Tail) {
+    if (part.empty()) return true;
+
+    size_t pos = 0;
+    while (true) {
+        size_t end = part.find(':', pos);
+        string_view group = part.substr(pos, end == string_view::npos ? string_view::npos : end - pos);
+
+        if (end == string_view::npos && allowIPv4Tail && group.find('.') != string_view::npos) {
+            uint32_t v4;
+            if (!parseIPv4(group, v4)) return false;
+            out.push_back(static_cast<uint16_t>(v4 >> 16));
+            out.push_back(static_cast<uint16_t>(v4 & 0xFFFF));
+            return true;
+        }
+
+        if (group.empty() || group.size() > 4) return false;
+        uint16_t value = 0;
+        for (char c : group) {
+            int digit;
+            if (c >= '0' && c <= '9') digit = c - '0';
+            else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+            else return false;
+            value = static_cast<uint16_t>((value << 4) | digit);
+        }
+        out.push_back(value);
+
+        if (end == string_view::npos) return true;
+        pos = end + 1;
+    }
+}
+
+static bool parseIPv6(string_view text, uint16_t groups[8]) {
+    size_t gap = text.find("::");
+    if (gap != string_view::npos && text.find("::", gap + 1) != string_view::npos) {
+        return false;
+    }
+
+    vector<uint16_t> head, tail;
+    if (gap == string_view::npos) {
+        if (!parseIPv6Groups(text, head, true) || head.size() != 8) return false;
+    }
+    else {
+        if (!parseIPv6Groups(text.substr(0, gap), head, false) ||
+            !parseIPv6Groups(text.substr(gap + 2), tail, true) ||
+            head.size() + tail.size() > 7) {
+            return false;
+        }
+    }
+
+    size_t zeros = 8 - head.size() - tail.size();
+    size_t i = 0;
+    for (uint16_t g : head) groups[i++] = g;
+    for (size_t z = 0; z < zeros; z++) groups[i++] = 0;
+    for (uint16_t g : tail) groups[i++] = g;
+    return true;
+}
+
+bool parseIPAddress(string_view text, IPAddress& out) {
+    out = IPAddress();
+
+    if (text.find(':') == string_view::npos) {
+        uint32_t v4;
+        if (!parseIPv4(text, v4)) return false;
+        out.hi = static_cast<uint64_t>(v4) << 32;
+        return true;
+    }
+
+    uint16_t groups[8];
+    if (!parseIPv6(text, groups)) return false;
+
+    // ::ffff:a.b.c.d - IPv4-адрес в записи IPv6
+    if (groups[0] == 0 && groups[1] == 0 && groups[2] == 0 && groups[3] == 0 &&
+        groups[4] == 0 && groups[5] == 0xFFFF) {
+        out.hi = (static_cast<uint64_t>(groups[6]) << 48) | (static_cast<uint64_t>(groups[7]) << 32);
+        return true;
+    }
+
+    out.v6 = true;
+    for (int i = 0; i < 4; i++) {
+        out.hi = (out.hi << 16) | groups[i];
+        out.lo = (out.lo << 16) | groups[i + 4];
+    }
+    return true;
+}
+
+string formatIPAddress(const IPAddress& address) {
+    ostringstream oss;
+
+    if (!address.v6) {
+        uint32_t v4 = static_cast<uint32_t>(address.hi >> 32);
+        oss << (v4 >> 24) << '.' << ((v4 >> 16) & 0xFF) << '.'
+            << ((v4 >> 8) & 0xFF) << '.' << (v4 & 0xFF);
+        return oss.str();
+    }
+
+    uint16_t groups[8];
+    for (int i = 0; i < 4; i++) {
+        groups[i] = static_cast<uint16_t>(address.hi >> (48 - 16 * i));
+        groups[i + 4] = static_cast<uint16_t>(address.lo >> (48 - 16 * i));
+    }
+
+    // Самая длинная серия нулевых групп (от двух) сокращается до "::"
+    int bestStart = -1, bestLength = 1;
+    for (int i = 0; i < 8;) {
+        if (groups[i] != 0) {
+            i++;
+            continue;
+        }
+        int j = i;
+        while (j < 8 && groups[j] == 0) j++;
+        if (j - i > bestLength) {
+            bestStart = i;
+            bestLength = j - i;
+        }
+        i = j;
+    }
+
+    oss << hex;
+    for (int i = 0; i < 8; i++) {
+        if (i == bestStart) {
+            oss << "::";
+            i += bestLength - 1;
+            continue;
+        }
+        if (i > 0 && i != bestStart + bestLength) oss << ':';
+        oss << groups[i];
+    }
+    return oss.str();
+}
+
+bool parseCIDR(string_view text, CIDR& out) {
+    size_t slash = text.find('/');
+    string_view addressText = text.substr(0, slash);
+
+    if (!parseIPAddress(addressText, out.network)) return false;
+
+    bool writtenAsIPv6 = addressText.find(':') != string_view::npos;
+    int prefix = writtenAsIPv6 ? 128 : out.network.maxBits();
+
+    if (slash != string_view::npos) {
+        string_view digits = text.substr(slash + 1);
+        if (digits.empty() || digits.size() > 3) return false;
+        prefix = 0;
+        for (char c : digits) {
+            if (c < '0' || c > '9') return false;
+            prefix = prefix * 10 + (c - '0');
+        }
+    }
+
+    // Префикс ::ffff:a.b.c.d/N задан в битах IPv6
+    if (writtenAsIPv6 && !out.network.v6) {
+        if (prefix < 96) return false;
+        prefix -= 96;
+    }
+
+    if (prefix > out.network.maxBits()) return false;
+
+    out.prefix = prefix;
+    out.network = out.network.masked(prefix);
+    return true;
+}
+
+string CIDR::toString() const {
+    return formatIPAddress(network) + "/" + to_string(prefix);
+}
+
+// ==================== CIDRTree ====================
+
+int32_t CIDRTree::newNode(const IPAddress& key, int bits, uint64_t count) {
+    Node node;
+    node.key = key.masked(bits);
+    node.bits = bits;
+    node.count = count;
+    nodes.push_back(node);
+    return static_cast<int32_t>(nodes.size() - 1);
+}
+
+int32_t CIDRTree::insert(const IPAddress& key, int bits, uint64_t weight) {
+    int32_t current = 0;
+    nodes[0].count += weight;
+
+    while (nodes[current].bits < bits) {
+        int branch = key.bit(nodes[current].bits);
+        int32_t next = nodes[current].child[branch];
+
+        if (next == NONE) {
+            int32_t leaf = newNode(key, bits, weight);
+            nodes[current].child[branch] = leaf;
+            return leaf;
+        }
+
+        int common = min(IPAddress::commonPrefix(key, nodes[next].key),
+            min(nodes[next].bits, bits));
+
+        if (common == nodes[next].bits) {
+            nodes[next].count += weight;
+            current = next;
+            continue;
+        }
+
+        // Ключ расходится с узлом внутри сжатого ребра - вставляем развилку
+        int32_t split = newNode(key, common, nodes[next].count + weight);
+        nodes[split].child[nodes[next].key.bit(common)] = next;
+        nodes[current].child[branch] = split;
+
+        if (common == bits) {
+            return split;
+        }
+
+        int32_t leaf = newNode(key, bits, weight);
+        nodes[split].child[key.bit(common)] = leaf;
+        return leaf;
+    }
+
+    return current;
+}
+
+int32_t CIDRTree::longestMatch(const IPAddress& address) const {
+    int32_t current = 0;
+    int32_t best = nodes[0].value;
+
+    while (nodes[current].bits < 128) {
+        int32_t next = nodes[current].child[address.bit(nodes[current].bits)];
+        if (next == NONE || IPAddress::commonPrefix(address, nodes[next].key) < nodes[next].bits) {
+            break;
+        }
+        current = next;
+        if (nodes[current].value != NONE) {
+            best = nodes[current].value;
+        }
+    }
+
+    return best;
+}
+
+int32_t CIDRTree::findPrefix(const IPAddress& key, int bits) const {
+    int32_t current = 0;
+
+    while (nodes[current].bits < bits) {
+        int32_t next = nodes[current].child[key.bit(nodes[current].bits)];
+        if (next == NONE) {
+            return NONE;
+        }
+        int need = min(nodes[next].bits, bits);
+        if (IPAddress::commonPrefix(key, nodes[next].key) < need) {
+            return NONE;
+        }
+        current = next;
+    }
+
+    return current;
+}
+
+void CIDRTree::clear() {
+    nodes.clear();
+    newNode(IPAddress(), 0, 0);  // корень - пустой префикс
+}
+
+// ==================== SubnetIndex ====================
+
+void SubnetIndex::build(const HashIndex& ips) {
+    clear();
+    addresses.reserve(ips.distinctKeys());
+    parsed.reserve(ips.distinctKeys());
+    sameAddress.reserve(ips.distinctKeys());
+
+    for (const auto& entry : ips.entries()) {
+        IPAddress address;
+        if (!parseIPAddress(entry.first, address)) {
+            invalid++;
+            continue;
+        }
+
+        CIDRTree& tree = trees[address.v6 ? 1 : 0];
+        int32_t node = tree.insert(address, address.maxBits(), entry.second.size());
+        attach(tree, node, entry, address);
+    }
+}
+
+void SubnetIndex::attach(CIDRTree& tree, int32_t node, const Address& entry,
+    const IPAddress& address) {
+    sameAddress.push_back(tree.node(node).value);
+    tree.setValue(node, static_cast<int32_t>(addresses.size()));
+    addresses.push_back(&entry);
+    parsed.push_back(address);
+}
+
+void SubnetIndex::add(const Address& entry) {
+    IPAddress address;
+    if (!parseIPAddress(entry.first, address)) {
+        if (entry.second.size() == 1) invalid++;
+        return;
+    }
+
+    CIDRTree& tree = trees[address.v6 ? 1 : 0];
+    int32_t node = tree.insert(address, address.maxBits(), 1);
+    for (int32_t id = tree.node(node).value; id != CIDRTree::NONE; id = sameAddress[id]) {
+        if (addresses[id] == &entry) return;
+    }
+    attach(tree, node, entry, address);
+}
+
+vector<RowId> SubnetIndex::rows(const CIDR& network) const {
+    vector<RowId> result;
+    const CIDRTree& tree = trees[network.network.v6 ? 1 : 0];
+
+    int32_t root = tree.findPrefix(network.network, network.prefix);
+    if (root == CIDRTree::NONE) {
+        return result;
+    }
+    result.reserve(tree.node(root).count);
+
+    size_t lists = 0;
+    tree.forEachValue(root, [this, &result, &lists](int32_t head) {
+        for (int32_t id = head; id != CIDRTree::NONE; id = sameAddress[id]) {
+            addresses[id]->second.decodeInto(result);
+            lists++;
+        }
+    });
+
+    // Списки разных адресов перемежаются - восстанавливаем порядок записей
+    if (lists > 1) {
+        sort(result.begin(), result.end());
+    }
+
+    return result;
+}
+
+uint64_t SubnetIndex::count(const CIDR& network) const {
+    const CIDRTree& tree = trees[network.network.v6 ? 1 : 0];
+    int32_t root = tree.findPrefix(network.network, network.prefix);
+    return root == CIDRTree::NONE ? 0 : tree.node(root).count;
+}
+
+vector<pair<CIDR, uint64_t>> SubnetIndex::topSubnets(int ipv4Prefix, int ipv6Prefix,
+    size_t n) const {
+    vector<pair<CIDR, uint64_t>> result;
+
+    for (int family = 0; family < 2; family++) {
+        int prefix = family == 0 ? min(max(ipv4Prefix, 0), 32) : min(max(ipv6Prefix, 0), 128);
+        trees[family].forEachSubnet(prefix, [&result, prefix, family](const IPAddress& network,
+            uint64_t count) {
+            CIDR subnet;
+            subnet.network = network;
+            subnet.network.v6 = family == 1;
+            subnet.prefix = prefix;
+            result.emplace_back(subnet, count);
+        });
+    }
+
+    auto byCount = [](const pair<CIDR, uint64_t>& a, const pair<CIDR, uint64_t>& b) {
+        if (a.second != b.second) return a.second > b.second;
+        if (a.first.network.v6 != b.first.network.v6) return !a.first.network.v6;
+        if (a.first.network.hi != b.first.network.hi) return a.first.network.hi < b.first.network.hi;
+        return a.first.network.lo < b.first.network.lo;
+    };
+
+    if (n > 0 && n < result.size()) {
+        partial_sort(result.begin(), result.begin() + n, result.end(), byCount);
+        result.resize(n);
+    }
+    else {
+        sort(result.begin(), result.end(), byCount);
+    }
+
+    return result;
+}
+
+size_t SubnetIndex::memoryBytes() const {
+    return trees[0].memoryBytes() + trees[1].memoryBytes() +
+        addresses.capacity() * sizeof(const Address*) + parsed.capacity() * sizeof(IPAddress) +
+        sameAddress.capacity() * sizeof(int32_t);
+}
+
+void SubnetIndex::clear() {
+    trees[0].clear();
+    trees[1].clear();
+    addresses.clear();
+    parsed.clear();
+    sameAddress.clear();
+    invalid = 0;
+}
+
+// ==================== NamedRanges ====================
+
+bool NamedRanges::add(const string& cidr, const string& name) {
+    CIDR range;
+    if (!parseCIDR(cidr, range)) {
+        return false;
+    }
+
+    CIDRTree& tree = trees[range.network.v6 ? 1 : 0];
+    int32_t node = tree.insert(range.network, range.prefix);
+    int32_t id = tree.node(node).value;
+
+    if (id == CIDRTree::NONE) {
+        tree.setValue(node, static_cast<int32_t>(names.size()));
+        names.push_back(name);
+        ranges.push_back(range);
+    }
+    else {
+        names[id] = name;
+    }
+    return true;
+}
+
+size_t NamedRanges::loadFromFile(const string& filename) {
+    ifstream file(filename);
+    if (!file.is_open()) {
+        return 0;
+    }
+
+    size_t loaded = 0;
+    string line;
+    while (getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+
+        istringstream fields(line);
+        string cidr, name;
+        if (!(fields >> cidr) || cidr[0] == '#') continue;
+
+        getline(fields >> ws, name);
+        if (name.empty()) name = cidr;
+
+        if (add(cidr, name)) loaded++;
+    }
+
+    return loaded;
+}
+
+const string* NamedRanges::lookup(const IPAddress& address) const {
+    int32_t id = trees[address.v6 ? 1 : 0].longestMatch(address);
+    return id == CIDRTree::NONE ? nullptr : &names[id];
+}
+
+const string* NamedRanges::lookup(const string& ip) const {
+    IPAddress address;
+    if (!parseIPAddress(ip, address)) {
+        return nullptr;
+    }
+    return lookup(address);
+}
+
+void NamedRanges::clear() {
+    trees[0].clear();
+    trees[1].clear();
+    names.clear();
+    ranges.clear();
+}
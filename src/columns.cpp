@@ -0,0 +1,67 @@
+﻿#include "columns.h"
+#include <cctype>
+
+using namespace std;
+
+// Сравнение без учёта регистра с именем в верхнем регистре
+static bool equalsUpper(const string& value, const char* upper, size_t length) {
+    if (value.size() != length) return false;
+    for (size_t i = 0; i < length; i++) {
+        if (toupper(static_cast<unsigned char>(value[i])) != upper[i]) return false;
+    }
+    return true;
+}
+
+HttpMethod methodCode(const string& method) {
+    switch (method.size()) {
+    case 3:
+        if (equalsUpper(method, "GET", 3)) return HttpMethod::Get;
+        if (equalsUpper(method, "PUT", 3)) return HttpMethod::Put;
+        break;
+    case 4:
+        if (equalsUpper(method, "POST", 4)) return HttpMethod::Post;
+        if (equalsUpper(method, "HEAD", 4)) return HttpMethod::Head;
+        break;
+    case 5:
+        if (equalsUpper(method, "PATCH", 5)) return HttpMethod::Patch;
+        if (equalsUpper(method, "TRACE", 5)) return HttpMethod::Trace;
+        break;
+    case 6:
+        if (equalsUpper(method, "DELETE", 6)) return HttpMethod::Delete;
+        break;
+    case 7:
+        if (equalsUpper(method, "OPTIONS", 7)) return HttpMethod::Options;
+        if (equalsUpper(method, "CONNECT", 7)) return HttpMethod::Connect;
+        break;
+    }
+    return HttpMethod::Other;
+}
+
+const char* methodName(HttpMethod code) {
+    static const char* const names[] = {
+        "OTHER", "GET", "POST", "PUT", "DELETE", "HEAD", "OPTIONS", "PATCH", "CONNECT", "TRACE"
+    };
+    size_t index = static_cast<size_t>(code);
+    return index < sizeof(names) / sizeof(names[0]) ? names[index] : names[0];
+}
+
+void LogColumns::build(const vector<LogEntry>& logs) {
+    clear();
+    status.reserve(logs.size());
+    method.reserve(logs.size());
+
+    for (const auto& log : logs) {
+        add(log);
+    }
+}
+
+void LogColumns::add(const LogEntry& entry) {
+    status.push_back(entry.status >= 0 && entry.status <= 0xFFFF
+        ? static_cast<uint16_t>(entry.status) : 0);
+    method.push_back(static_cast<uint8_t>(methodCode(entry.method)));
+}
+
+void LogColumns::clear() {
+    status.clear();
+    method.clear();
+}
@@ -0,0 +1,119 @@
+﻿#include "csv_writer.h"
+#include "export_pipeline.h"
+#include <charconv>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LOG_ANALYZER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace CsvWriter {
+
+    bool needsQuoting(string_view field, char delimiter) {
+        const char* data = field.data();
+        size_t size = field.size();
+        size_t i = 0;
+
+#ifdef LOG_ANALYZER_SSE2
+        const __m128i separator = _mm_set1_epi8(delimiter);
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+
+        for (; i + 16 <= size; i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i special = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(block, separator), _mm_cmpeq_epi8(block, quote)),
+                _mm_or_si128(_mm_cmpeq_epi8(block, cr), _mm_cmpeq_epi8(block, lf)));
+            if (_mm_movemask_epi8(special)) {
+                return true;
+            }
+        }
+#endif
+
+        // Хвост (или всё поле без SSE2)
+        for (; i < size; i++) {
+            char c = data[i];
+            if (c == delimiter || c == '"' || c == '\r' || c == '\n') {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void appendField(string& out, string_view field, char delimiter) {
+        if (!needsQuoting(field, delimiter)) {
+            out.append(field.data(), field.size());
+            return;
+        }
+
+        out.push_back('"');
+        size_t start = 0;
+        for (size_t quote = field.find('"'); quote != string_view::npos; quote = field.find('"', start)) {
+            out.append(field.data() + start, quote + 1 - start);
+            out.push_back('"');
+            start = quote + 1;
+        }
+        out.append(field.data() + start, field.size() - start);
+        out.push_back('"');
+    }
+
+    void appendRow(string& out, const LogEntry& entry, const CsvOptions& options) {
+        char separator = options.delimiter;
+        appendField(out, entry.timestamp, separator);
+        out.push_back(separator);
+        appendField(out, entry.ip, separator);
+        out.push_back(separator);
+        appendField(out, entry.method, separator);
+        out.push_back(separator);
+        appendField(out, entry.url, separator);
+        out.push_back(separator);
+
+        char number[16];
+        auto result = to_chars(number, number + sizeof(number), entry.status);
+        out.append(number, result.ptr);
+        out.append(options.lineEnd);
+    }
+
+    void appendHeader(string& out, const CsvOptions& options) {
+        const char* names[] = { "timestamp", "ip", "method", "url", "status" };
+        for (size_t i = 0; i < 5; i++) {
+            if (i > 0) out.push_back(options.delimiter);
+            out += names[i];
+        }
+        out += options.lineEnd;
+    }
+
+    bool write(const string& filename, const vector<LogEntry>& logs,
+        const vector<RowId>* rows, const CsvOptions& options) {
+        ofstream file(filename, ios::binary | ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        if (options.header) {
+            string header;
+            appendHeader(header, options);
+            file.write(header.data(), static_cast<streamsize>(header.size()));
+        }
+
+        size_t count = rows ? rows->size() : logs.size();
+        auto format = [&](size_t begin, size_t end, string& buffer) {
+            buffer.reserve((end - begin) * 80);
+            for (size_t i = begin; i < end; i++) {
+                appendRow(buffer, logs[rows ? (*rows)[i] : i], options);
+            }
+        };
+        auto output = [&file](const string& block) {
+            file.write(block.data(), static_cast<streamsize>(block.size()));
+            return static_cast<bool>(file);
+        };
+
+        bool ok = ExportPipeline::formatInOrder(count, format, output, options.threads);
+        file.close();
+        return ok && !file.fail();
+    }
+}
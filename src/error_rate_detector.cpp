@@ -0,0 +1,180 @@
+﻿#include "error_rate_detector.h"
+#include "log_index.h"
+#include <cmath>
+
+using namespace std;
+
+// Деление с округлением вниз
+static int64_t floorDiv(int64_t value, int64_t step) {
+    int64_t q = value / step;
+    return (value % step != 0 && value < 0) ? q - 1 : q;
+}
+
+// Первое наблюдение задаёт среднее; дальше - инкрементальная EWMA-дисперсия
+void ErrorRateDetector::Baseline::update(double value, double alpha) {
+    if (samples == 0) {
+        mean = value;
+        variance = 0.0;
+    }
+    else {
+        double diff = value - mean;
+        double increment = alpha * diff;
+        mean += increment;
+        variance = (1.0 - alpha) * (variance + diff * increment);
+    }
+    samples++;
+}
+
+ErrorRateDetector::ErrorRateDetector(const ErrorRateOptions& opts, const vector<string>& urls)
+    : options(opts), classPosition(6, -1) {
+    if (options.bucketSeconds < 1) options.bucketSeconds = 1;
+
+    for (size_t i = 0; i < options.statusClasses.size(); i++) {
+        int cls = options.statusClasses[i];
+        if (cls >= 1 && cls <= 5) classPosition[cls] = static_cast<int>(i);
+    }
+
+    for (const auto& url : urls) {
+        urlIds.emplace(url, static_cast<int>(urlIds.size()));
+    }
+    urlRequests.assign(urlIds.size(), 0);
+
+    // Ряды: сначала все запросы, затем по URL; внутри - по классам
+    vector<const string*> urlNames(urlIds.size());
+    for (const auto& [url, id] : urlIds) {
+        urlNames[id] = &url;
+    }
+    for (int url = -1; url < static_cast<int>(urlNames.size()); url++) {
+        for (int cls : options.statusClasses) {
+            Series s;
+            s.statusClass = cls;
+            s.url = url;
+            s.name = to_string(cls) + "xx";
+            if (url >= 0) s.name += " " + *urlNames[url];
+            s.seasonal.resize(options.seasonBuckets);
+            series.push_back(move(s));
+        }
+    }
+}
+
+void ErrorRateDetector::add(int64_t epoch, int status, const string& url) {
+    int64_t b = floorDiv(epoch, options.bucketSeconds);
+    if (!started) {
+        started = true;
+        bucket = b;
+    }
+    else if (b > bucket) {
+        closeBucket();
+        bucket = b;
+    }
+
+    int cls = BitmapIndex::classOf(status);
+    int position = classPosition[cls];
+    size_t classes = options.statusClasses.size();
+
+    requests++;
+    if (position >= 0) {
+        series[position].errors++;
+    }
+
+    if (!urlIds.empty()) {
+        auto it = urlIds.find(url);
+        if (it != urlIds.end()) {
+            urlRequests[it->second]++;
+            if (position >= 0) {
+                series[(it->second + 1) * classes + position].errors++;
+            }
+        }
+    }
+}
+
+void ErrorRateDetector::closeInterval(Series& s) {
+    if (s.open) {
+        found.push_back(s.current);
+        s.open = false;
+    }
+}
+
+void ErrorRateDetector::closeBucket() {
+    int64_t bucketStart = bucket * options.bucketSeconds;
+
+    for (Series& s : series) {
+        uint64_t n = s.url < 0 ? requests : urlRequests[s.url];
+        uint64_t errors = s.errors;
+        s.errors = 0;
+
+        // Аномалия прерывается пропуском во времени
+        if (s.open && s.lastBucket != bucket - 1) {
+            closeInterval(s);
+        }
+        if (n < options.minRequests) {
+            closeInterval(s);
+            continue;
+        }
+
+        double rate = static_cast<double>(errors) / static_cast<double>(n);
+
+        // База: фаза периода, если у неё достаточно наблюдений
+        Baseline* phase = nullptr;
+        if (options.seasonBuckets > 0) {
+            int64_t p = bucket % static_cast<int64_t>(options.seasonBuckets);
+            if (p < 0) p += options.seasonBuckets;
+            phase = &s.seasonal[static_cast<size_t>(p)];
+        }
+        bool usePhase = phase && phase->samples >= options.seasonWarmup;
+        Baseline& base = usePhase ? *phase : s.global;
+
+        bool anomalous = false;
+        double score = 0.0;
+        if (base.samples >= (usePhase ? options.seasonWarmup : options.warmupBuckets)) {
+            // Шум доли при n запросах; для нулевой базы - как при одной ошибке
+            double p = base.mean > 1.0 / n ? base.mean : 1.0 / n;
+            double deviation = sqrt(base.variance + p * (1.0 - p) / n);
+            score = (rate - base.mean) / deviation;
+            anomalous = score > options.threshold;
+        }
+
+        if (anomalous) {
+            if (!s.open) {
+                s.open = true;
+                s.current = AnomalyInterval();
+                s.current.series = s.name;
+                s.current.start = bucketStart;
+            }
+            s.current.end = bucketStart + options.bucketSeconds;
+            s.current.requests += n;
+            s.current.errors += errors;
+            if (score > s.current.peakScore) {
+                s.current.peakScore = score;
+                s.current.peakRate = rate;
+                s.current.expectedRate = base.mean;
+            }
+            s.lastBucket = bucket;
+        }
+        else {
+            closeInterval(s);
+        }
+
+        // Аномальные интервалы не сдвигают прогретые базы;
+        // непрогретые пополняются всегда
+        if (!anomalous || s.global.samples < options.warmupBuckets) {
+            s.global.update(rate, options.alpha);
+        }
+        if (phase && (!anomalous || phase->samples < options.seasonWarmup)) {
+            phase->update(rate, options.alpha);
+        }
+    }
+
+    requests = 0;
+    for (auto& count : urlRequests) count = 0;
+}
+
+void ErrorRateDetector::finish() {
+    if (started) {
+        closeBucket();
+    }
+    for (Series& s : series) {
+        closeInterval(s);
+    }
+    started = false;
+}
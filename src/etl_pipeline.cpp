@@ -0,0 +1,294 @@
+﻿#include "etl_pipeline.h"
+#include "json_parser.h"
+#include "csv_writer.h"
+#include "json_writer.h"
+#include "arrow_writer.h"
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <thread>
+
+using namespace std;
+
+// ==================== RecordScanner ====================
+
+void RecordScanner::feed(const char* data, size_t size, vector<string>& records) {
+    size_t start = 0;   // начало записи в блоке; продолжение записи - с 0
+
+    for (size_t i = 0; i < size; i++) {
+        char c = data[i];
+        if (inString) {
+            if (escaped) {
+                escaped = false;
+            }
+            else if (c == '\\') {
+                escaped = true;
+            }
+            else if (c == '"') {
+                inString = false;
+            }
+        }
+        else if (c == '"') {
+            inString = true;
+        }
+        else if (c == '{') {
+            if (depth++ == 0) start = i;
+        }
+        else if (c == '}' && depth > 0 && --depth == 0) {
+            partial.append(data + start, i + 1 - start);
+            records.push_back(move(partial));
+            partial.clear();
+        }
+    }
+
+    if (depth > 0) {
+        partial.append(data + start, size - start);
+    }
+}
+
+void RecordScanner::reset() {
+    partial.clear();
+    depth = 0;
+    inString = false;
+    escaped = false;
+}
+
+// ==================== EtlPipeline ====================
+
+namespace EtlPipeline {
+
+    bool parseFormat(const string& name, EtlFormat& format) {
+        if (name == "csv") format = EtlFormat::Csv;
+        else if (name == "json") format = EtlFormat::Json;
+        else if (name == "ndjson" || name == "jsonl") format = EtlFormat::Ndjson;
+        else if (name == "arrow" || name == "feather") format = EtlFormat::Arrow;
+        else return false;
+        return true;
+    }
+
+    // Первая ошибка любой стадии; очереди закрываются, чтобы остальные
+    // стадии не ждали
+    struct Abort {
+        mutex lock;
+        bool failed = false;
+        string message;
+    };
+
+    // Стадия чтения: блоки файлов -> тексты записей
+    static void readInputs(const vector<string>& inputs, const EtlOptions& options,
+        BoundedQueue<vector<string>>& texts, EtlStats& stats, const function<void(const string&)>& fail) {
+        size_t batchRows = options.batchRows > 0 ? options.batchRows : 1;
+        vector<char> block(options.readBlockBytes > 0 ? options.readBlockBytes : 1 << 20);
+        vector<string> records;
+        RecordScanner scanner;
+
+        // Полные пакеты (all - и остаток) в очередь
+        auto flush = [&](bool all) {
+            size_t begin = 0;
+            while (records.size() - begin >= batchRows || (all && begin < records.size())) {
+                size_t end = records.size() - begin > batchRows ? begin + batchRows : records.size();
+                vector<string> batch(make_move_iterator(records.begin() + begin),
+                    make_move_iterator(records.begin() + end));
+                if (!texts.push(move(batch))) return false;
+                begin = end;
+            }
+            records.erase(records.begin(), records.begin() + begin);
+            return true;
+        };
+
+        bool running = true;
+        for (const auto& input : inputs) {
+            ifstream file(input, ios::binary);
+            if (!file.is_open()) {
+                fail("Не удалось открыть файл: " + input);
+                running = false;
+                break;
+            }
+
+            scanner.reset();
+            bool firstBlock = true;
+            while (running && file) {
+                file.read(block.data(), static_cast<streamsize>(block.size()));
+                size_t size = static_cast<size_t>(file.gcount());
+                if (size == 0) break;
+                stats.bytesRead += size;
+
+                // BOM в начале файла
+                size_t skip = 0;
+                if (firstBlock && size >= 3 && static_cast<unsigned char>(block[0]) == 0xEF &&
+                    static_cast<unsigned char>(block[1]) == 0xBB && static_cast<unsigned char>(block[2]) == 0xBF) {
+                    skip = 3;
+                }
+                firstBlock = false;
+
+                scanner.feed(block.data() + skip, size - skip, records);
+                running = flush(false);
+            }
+            if (!running) break;
+            if (file.bad()) {
+                fail("Ошибка чтения файла: " + input);
+                running = false;
+                break;
+            }
+            // Оборванная последняя запись - в пропущенные
+            if (scanner.hasPartial()) {
+                records.push_back(string());
+            }
+        }
+
+        if (running) {
+            flush(true);
+        }
+        texts.close();
+    }
+
+    // Стадия разбора: тексты -> записи, прошедшие фильтр
+    static void parseRecords(const EtlOptions& options, BoundedQueue<vector<string>>& texts,
+        BoundedQueue<vector<LogEntry>>& entries, EtlStats& stats) {
+        QueryFilter filter(options.filter);
+        vector<string> batch;
+
+        while (texts.pop(batch)) {
+            vector<LogEntry> accepted;
+            accepted.reserve(batch.size());
+            for (const auto& text : batch) {
+                LogEntry entry;
+                bool parsed = false;
+                try {
+                    parsed = JsonParser::parse(text).toLogEntry(entry);
+                }
+                catch (const exception&) {
+                    parsed = false;
+                }
+
+                if (!parsed) {
+                    stats.skipped++;
+                    continue;
+                }
+                stats.records++;
+                if (filter.matches(entry)) {
+                    accepted.push_back(move(entry));
+                }
+            }
+
+            if (!accepted.empty() && !entries.push(move(accepted))) {
+                break;
+            }
+        }
+        entries.close();
+    }
+
+    // Стадия записи текстовых форматов; разделители - как у CsvWriter и JsonWriter
+    static bool writeText(const string& output, const EtlOptions& options,
+        BoundedQueue<vector<LogEntry>>& entries, EtlStats& stats) {
+        ofstream file(output, ios::binary | ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        CsvOptions csv;
+        JsonExportOptions json;
+        if (options.format == EtlFormat::Ndjson) {
+            json.layout = JsonLayout::Lines;
+            json.pretty = false;
+        }
+
+        string buffer;
+        if (options.format == EtlFormat::Csv) {
+            CsvWriter::appendHeader(buffer, csv);
+        }
+        else if (options.format == EtlFormat::Json) {
+            buffer.push_back('[');
+        }
+
+        vector<LogEntry> batch;
+        while (entries.pop(batch)) {
+            for (const auto& entry : batch) {
+                if (options.format == EtlFormat::Csv) {
+                    CsvWriter::appendRow(buffer, entry, csv);
+                }
+                else if (options.format == EtlFormat::Json) {
+                    if (stats.written > 0) buffer.push_back(',');
+                    buffer += "\n  ";
+                    JsonWriter::appendRecord(buffer, entry, json);
+                }
+                else {
+                    JsonWriter::appendRecord(buffer, entry, json);
+                    buffer.push_back('\n');
+                }
+                stats.written++;
+            }
+
+            file.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+            buffer.clear();
+            if (!file) {
+                return false;
+            }
+        }
+
+        // Заголовок без записей и конец массива
+        if (options.format == EtlFormat::Json) {
+            buffer += stats.written > 0 ? "\n]\n" : "]\n";
+        }
+        file.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        file.close();
+        return !file.fail();
+    }
+
+    static bool writeArrow(const string& output, BoundedQueue<vector<LogEntry>>& entries,
+        EtlStats& stats) {
+        ArrowStreamWriter writer;
+        if (!writer.open(output)) {
+            return false;
+        }
+
+        vector<LogEntry> batch;
+        while (entries.pop(batch)) {
+            if (!writer.write(batch)) {
+                return false;
+            }
+            stats.written += batch.size();
+        }
+        return writer.close();
+    }
+
+    bool run(const vector<string>& inputs, const string& output,
+        const EtlOptions& options, EtlStats& stats) {
+        stats = EtlStats();
+        BoundedQueue<vector<string>> texts(options.queueBatches);
+        BoundedQueue<vector<LogEntry>> entries(options.queueBatches);
+
+        Abort abort;
+        auto fail = [&](const string& message) {
+            {
+                lock_guard<mutex> guard(abort.lock);
+                if (!abort.failed) {
+                    abort.failed = true;
+                    abort.message = message;
+                }
+            }
+            texts.close();
+            entries.close();
+        };
+
+        thread reader([&] { readInputs(inputs, options, texts, stats, fail); });
+        thread parser([&] { parseRecords(options, texts, entries, stats); });
+
+        // Запись - в вызывающем потоке
+        bool written = options.format == EtlFormat::Arrow
+            ? writeArrow(output, entries, stats)
+            : writeText(output, options, entries, stats);
+        if (!written) {
+            fail("Ошибка записи файла: " + output);
+        }
+
+        reader.join();
+        parser.join();
+
+        if (abort.failed) {
+            stats.error = abort.message;
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,91 @@
+﻿#include "export_pipeline.h"
+#include "log_index.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace ExportPipeline {
+
+    bool formatInOrder(size_t rows, const FormatFn& format, const WriteFn& write,
+        unsigned threads, size_t blockRows) {
+        if (blockRows == 0) blockRows = DEFAULT_BLOCK_ROWS;
+        size_t blocks = (rows + blockRows - 1) / blockRows;
+        unsigned workers = chooseThreadCount(rows, threads);
+        auto blockEnd = [rows, blockRows](size_t block) {
+            size_t end = (block + 1) * blockRows;
+            return end < rows ? end : rows;
+        };
+
+        // Один поток: блоки форматируются и выводятся по очереди
+        if (workers <= 1 || blocks <= 1) {
+            string buffer;
+            for (size_t block = 0; block < blocks; block++) {
+                buffer.clear();
+                format(block * blockRows, blockEnd(block), buffer);
+                if (!write(buffer)) return false;
+            }
+            return true;
+        }
+
+        // Кольцо буферов: блок b форматируется в ring[b % size], когда
+        // блок b - size уже выведен
+        struct Slot {
+            string buffer;
+            bool ready = false;
+        };
+        size_t ringSize = 2 * static_cast<size_t>(workers);
+        vector<Slot> ring(ringSize);
+        mutex lock;
+        condition_variable changed;
+        size_t written = 0;
+        atomic<size_t> next(0);
+
+        auto worker = [&]() {
+            for (size_t block = next++; block < blocks; block = next++) {
+                {
+                    unique_lock<mutex> guard(lock);
+                    changed.wait(guard, [&]() { return block < written + ringSize; });
+                }
+                Slot& slot = ring[block % ringSize];
+                slot.buffer.clear();
+                format(block * blockRows, blockEnd(block), slot.buffer);
+                {
+                    lock_guard<mutex> guard(lock);
+                    slot.ready = true;
+                }
+                changed.notify_all();
+            }
+        };
+
+        vector<thread> pool;
+        for (unsigned t = 0; t < workers; t++) {
+            pool.emplace_back(worker);
+        }
+
+        // Вывод по порядку в этом потоке; после ошибки блоки только освобождаются
+        bool ok = true;
+        for (size_t block = 0; block < blocks; block++) {
+            Slot& slot = ring[block % ringSize];
+            {
+                unique_lock<mutex> guard(lock);
+                changed.wait(guard, [&]() { return slot.ready; });
+            }
+            ok = ok && write(slot.buffer);
+            {
+                lock_guard<mutex> guard(lock);
+                slot.ready = false;
+                written++;
+            }
+            changed.notify_all();
+        }
+
+        for (auto& formatter : pool) {
+            formatter.join();
+        }
+        return ok;
+    }
+}
@@ -220,6 +220,30 @@ string LogFormatter::formatLogsTable(const vector<LogEntry>& logs,
     return result;
 }
 
+// Форматирование таблицы выборки
+string LogFormatter::formatLogsTable(const Selection& selection,
+    int maxRows,
+    const TableConfig& config) {
+    size_t displayCount = min(selection.size(), static_cast<size_t>(maxRows));
+
+    vector<LogEntry> shown;
+    shown.reserve(displayCount);
+    for (size_t i = 0; i < displayCount; i++) {
+        shown.push_back(selection.at(i));
+    }
+
+    string result = formatLogsTable(shown, maxRows, config);
+
+    if (selection.size() > displayCount) {
+        ostringstream oss;
+        oss << result << "\n... и еще " << (selection.size() - displayCount)
+            << " записей (показано: " << displayCount << ")\n";
+        return oss.str();
+    }
+
+    return result;
+}
+
 // Форматирование топ-таблицы
 string LogFormatter::formatTopTable(const vector<pair<string, int>>& data,
     const string& title,
@@ -240,6 +264,24 @@ string LogFormatter::formatTopTable(const vector<pair<string, int>>& data,
     return oss.str();
 }
 
+// Таблица группировки: ячейки формирует сама таблица
+string LogFormatter::formatGroupTable(const GroupTable& table,
+    const string& title,
+    int maxRows,
+    const TableConfig& config) {
+    size_t shown = maxRows > 0 ? static_cast<size_t>(maxRows) : table.size();
+
+    ostringstream oss;
+    oss << title << "\n\n";
+    oss << formatTable(table.toRows(shown), table.getHeaders(), config);
+
+    if (table.size() > shown) {
+        oss << "... и еще " << (table.size() - shown) << " групп\n";
+    }
+
+    return oss.str();
+}
+
 // Форматирование статистики
 string LogFormatter::formatStatisticsTable(const LogAnalyzer::Statistics& stats,
     const TableConfig& config) {
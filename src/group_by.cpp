@@ -0,0 +1,582 @@
+﻿#include "group_by.h"
+#include "time_utils.h"
+#include "path_trie.h"
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+#include <string_view>
+#include <thread>
+#include <memory>
+#include <climits>
+
+using namespace std;
+
+namespace {
+
+const uint64_t HASH_SEED = 0xcbf29ce484222325ULL;
+const uint64_t HASH_MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+
+// ==================== Кодирование колонок ====================
+
+// Строковая колонка в виде кодов: номер записи -> номер значения в словаре
+struct Dictionary {
+    vector<uint32_t> codes;
+    vector<string> labels;
+};
+
+// Код - порядковый номер значения в хэш-индексе
+unique_ptr<Dictionary> dictionaryFromIndex(const HashIndex& index, size_t rows) {
+    auto dict = make_unique<Dictionary>();
+    dict->codes.assign(rows, 0);
+    dict->labels.reserve(index.distinctKeys());
+
+    for (const auto& [value, list] : index.entries()) {
+        uint32_t code = static_cast<uint32_t>(dict->labels.size());
+        dict->labels.push_back(value);
+        uint32_t* codes = dict->codes.data();
+        list.forEach([codes, code](RowId row) { codes[row] = code; });
+    }
+    return dict;
+}
+
+// Уникальные URL с одинаковым путём получают один код
+unique_ptr<Dictionary> pathDictionary(const HashIndex& urls, size_t rows) {
+    auto dict = make_unique<Dictionary>();
+    dict->codes.assign(rows, 0);
+    unordered_map<string_view, uint32_t> pathCodes;
+
+    for (const auto& [url, list] : urls.entries()) {
+        string_view path = urlPathView(url);
+        auto inserted = pathCodes.try_emplace(path, static_cast<uint32_t>(dict->labels.size()));
+        if (inserted.second) {
+            dict->labels.emplace_back(path);
+        }
+        uint32_t code = inserted.first->second;
+        uint32_t* codes = dict->codes.data();
+        list.forEach([codes, code](RowId row) { codes[row] = code; });
+    }
+    return dict;
+}
+
+// Колонка ключа или агрегата, сведённая к числам
+struct EncodedColumn {
+    enum class Kind { Codes, Status, StatusClass, Method, Time, TimeBucket };
+
+    Kind kind = Kind::Status;
+    const Dictionary* dictionary = nullptr;  // Codes
+    int64_t base = 0;                         // TimeBucket: начало первого интервала
+    int64_t step = 1;                         // TimeBucket: длина интервала
+};
+
+// Коды блока записей: отдельный цикл на каждый вид колонки
+void fillCodes(const EncodedColumn& column, const ColumnView& view,
+    const RowId* rows, size_t n, uint32_t* out) {
+    switch (column.kind) {
+    case EncodedColumn::Kind::Codes: {
+        const uint32_t* codes = column.dictionary->codes.data();
+        for (size_t i = 0; i < n; i++) out[i] = codes[rows[i]];
+        break;
+    }
+    case EncodedColumn::Kind::Status:
+        for (size_t i = 0; i < n; i++) out[i] = view.status[rows[i]];
+        break;
+    case EncodedColumn::Kind::StatusClass:
+        for (size_t i = 0; i < n; i++) out[i] = view.status[rows[i]] / 100u;
+        break;
+    case EncodedColumn::Kind::Method:
+        for (size_t i = 0; i < n; i++) out[i] = view.method[rows[i]];
+        break;
+    case EncodedColumn::Kind::Time:
+    case EncodedColumn::Kind::TimeBucket: {
+        int64_t base = column.base;
+        int64_t step = column.step;
+        for (size_t i = 0; i < n; i++) {
+            out[i] = static_cast<uint32_t>((view.epoch[rows[i]] - base) / step);
+        }
+        break;
+    }
+    }
+}
+
+int64_t valueOf(const EncodedColumn& column, const ColumnView& view, RowId row) {
+    switch (column.kind) {
+    case EncodedColumn::Kind::Codes: return column.dictionary->codes[row];
+    case EncodedColumn::Kind::Status: return view.status[row];
+    case EncodedColumn::Kind::StatusClass: return view.status[row] / 100;
+    case EncodedColumn::Kind::Method: return view.method[row];
+    case EncodedColumn::Kind::Time: return view.epoch[row];
+    case EncodedColumn::Kind::TimeBucket: return (view.epoch[row] - column.base) / column.step;
+    }
+    return 0;
+}
+
+// Текст значения ключа по коду
+string labelOf(const EncodedColumn& column, GroupKey key, uint32_t code) {
+    switch (column.kind) {
+    case EncodedColumn::Kind::Codes: return column.dictionary->labels[code];
+    case EncodedColumn::Kind::Status: return to_string(code);
+    case EncodedColumn::Kind::StatusClass: return to_string(code) + "xx";
+    case EncodedColumn::Kind::Method: return methodName(static_cast<HttpMethod>(code));
+    case EncodedColumn::Kind::Time:
+    case EncodedColumn::Kind::TimeBucket: {
+        string time = TimeUtils::fromEpochSeconds(column.base + code * column.step);
+        return key == GroupKey::Day ? time.substr(0, 10) : time;
+    }
+    }
+    return string();
+}
+
+const char* keyHeader(GroupKey key) {
+    switch (key) {
+    case GroupKey::IP: return "IP";
+    case GroupKey::URL: return "URL";
+    case GroupKey::Path: return "Путь";
+    case GroupKey::Method: return "Метод";
+    case GroupKey::Status: return "Статус";
+    case GroupKey::StatusClass: return "Класс статуса";
+    case GroupKey::Minute: return "Минута";
+    case GroupKey::Hour: return "Час";
+    case GroupKey::Day: return "День";
+    }
+    return "";
+}
+
+string aggregateHeader(const GroupBy::Aggregate& aggregate) {
+    static const char* const columns[] = { "IP", "URL", "метод", "статус", "время" };
+    const char* column = columns[static_cast<int>(aggregate.column)];
+    switch (aggregate.kind) {
+    case AggregateKind::Count: return "Запросов";
+    case AggregateKind::Min: return string("Мин. ") + column;
+    case AggregateKind::Max: return string("Макс. ") + column;
+    case AggregateKind::Distinct: return string("Уник. ") + column;
+    }
+    return string();
+}
+
+// ==================== Хэш-таблица групп ====================
+
+// Таблица одного потока: ключи, хэши и значения агрегатов лежат
+// плотными массивами по группам, слоты хранят номер группы + 1
+class GroupHashTable {
+public:
+    size_t keyCount;
+    const vector<GroupBy::Aggregate>& aggregates;
+    vector<size_t> distinctSlot;   // агрегат -> номер множества (Distinct)
+    size_t distinctCount = 0;
+
+    vector<uint32_t> keys;
+    vector<uint64_t> hashes;
+    vector<int64_t> values;
+    vector<unordered_set<int64_t>> distinct;
+
+private:
+    vector<uint32_t> slots;
+    size_t mask;
+
+    void grow() {
+        slots.assign(slots.size() * 2, 0);
+        mask = slots.size() - 1;
+        for (size_t g = 0; g < hashes.size(); g++) {
+            size_t pos = hashes[g] & mask;
+            while (slots[pos] != 0) pos = (pos + 1) & mask;
+            slots[pos] = static_cast<uint32_t>(g + 1);
+        }
+    }
+
+public:
+    GroupHashTable(size_t keyColumns, const vector<GroupBy::Aggregate>& aggregateList)
+        : keyCount(keyColumns), aggregates(aggregateList), slots(64, 0), mask(63) {
+        for (const auto& aggregate : aggregates) {
+            distinctSlot.push_back(aggregate.kind == AggregateKind::Distinct ? distinctCount++ : 0);
+        }
+    }
+
+    size_t size() const { return hashes.size(); }
+
+    uint32_t findOrInsert(uint64_t hash, const uint32_t* key) {
+        size_t pos = hash & mask;
+        while (slots[pos] != 0) {
+            uint32_t g = slots[pos] - 1;
+            if (hashes[g] == hash &&
+                equal(key, key + keyCount, keys.begin() + g * keyCount)) {
+                return g;
+            }
+            pos = (pos + 1) & mask;
+        }
+
+        uint32_t g = static_cast<uint32_t>(hashes.size());
+        slots[pos] = g + 1;
+        hashes.push_back(hash);
+        keys.insert(keys.end(), key, key + keyCount);
+        for (const auto& aggregate : aggregates) {
+            values.push_back(aggregate.kind == AggregateKind::Min ? INT64_MAX
+                : aggregate.kind == AggregateKind::Max ? INT64_MIN : 0);
+        }
+        distinct.resize(distinct.size() + distinctCount);
+
+        // Заполнение не больше половины
+        if (hashes.size() * 2 > slots.size()) {
+            grow();
+        }
+        return g;
+    }
+
+    // Слияние группы g другой таблицы в группу target этой
+    void combine(uint32_t target, const GroupHashTable& other, uint32_t g) {
+        for (size_t a = 0; a < aggregates.size(); a++) {
+            int64_t& value = values[target * aggregates.size() + a];
+            int64_t otherValue = other.values[g * aggregates.size() + a];
+            switch (aggregates[a].kind) {
+            case AggregateKind::Count: value += otherValue; break;
+            case AggregateKind::Min: if (otherValue < value) value = otherValue; break;
+            case AggregateKind::Max: if (otherValue > value) value = otherValue; break;
+            case AggregateKind::Distinct: {
+                const auto& from = other.distinct[g * distinctCount + distinctSlot[a]];
+                distinct[target * distinctCount + distinctSlot[a]].insert(from.begin(), from.end());
+                break;
+            }
+            }
+        }
+    }
+};
+
+// Всё, что нужно потокам для агрегации
+struct GroupContext {
+    const GroupBy& query;
+    const ColumnView& view;
+    vector<EncodedColumn> keys;
+    vector<EncodedColumn> aggregateColumns;
+};
+
+// Агрегация записей [begin, end) списка rows (или самих номеров при rows == nullptr)
+void aggregateRange(const GroupContext& ctx, const RowId* rows, size_t begin, size_t end,
+    GroupHashTable& table) {
+    size_t keyCount = ctx.keys.size();
+    size_t aggregateCount = ctx.query.aggregates.size();
+
+    vector<uint32_t> blockKeys(keyCount * PREDICATE_BLOCK);
+    vector<uint64_t> hashes(PREDICATE_BLOCK);
+    vector<RowId> blockRows(PREDICATE_BLOCK);
+    vector<uint32_t> key(keyCount + 1);
+
+    for (size_t blockBegin = begin; blockBegin < end; blockBegin += PREDICATE_BLOCK) {
+        size_t n = end - blockBegin < PREDICATE_BLOCK ? end - blockBegin : PREDICATE_BLOCK;
+
+        for (size_t i = 0; i < n; i++) {
+            blockRows[i] = rows ? rows[blockBegin + i] : static_cast<RowId>(blockBegin + i);
+        }
+
+        // Коды и хэши считаются колонками целиком: простые циклы без ветвлений
+        for (size_t k = 0; k < keyCount; k++) {
+            fillCodes(ctx.keys[k], ctx.view, blockRows.data(), n, &blockKeys[k * PREDICATE_BLOCK]);
+        }
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = HASH_SEED;
+        }
+        for (size_t k = 0; k < keyCount; k++) {
+            const uint32_t* codes = &blockKeys[k * PREDICATE_BLOCK];
+            for (size_t i = 0; i < n; i++) {
+                hashes[i] = (hashes[i] ^ codes[i]) * HASH_MULTIPLIER;
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] ^= hashes[i] >> 32;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            for (size_t k = 0; k < keyCount; k++) {
+                key[k] = blockKeys[k * PREDICATE_BLOCK + i];
+            }
+            uint32_t g = table.findOrInsert(hashes[i], key.data());
+            int64_t* values = table.values.data() + g * aggregateCount;
+
+            for (size_t a = 0; a < aggregateCount; a++) {
+                const GroupBy::Aggregate& aggregate = ctx.query.aggregates[a];
+                if (aggregate.kind == AggregateKind::Count) {
+                    values[a]++;
+                    continue;
+                }
+                int64_t value = valueOf(ctx.aggregateColumns[a], ctx.view, blockRows[i]);
+                if (aggregate.kind == AggregateKind::Min) {
+                    if (value < values[a]) values[a] = value;
+                }
+                else if (aggregate.kind == AggregateKind::Max) {
+                    if (value > values[a]) values[a] = value;
+                }
+                else {
+                    table.distinct[g * table.distinctCount + table.distinctSlot[a]].insert(value);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+// ==================== executeGroupBy ====================
+
+GroupTable executeGroupBy(const GroupBy& query, const GroupSource& source,
+    const vector<RowId>* rowList) {
+    const ColumnView& view = source.columns;
+    const RowId* rows = rowList ? rowList->data() : nullptr;
+    size_t count = rowList ? rowList->size() : view.size;
+
+    // Агрегаты, добавленные в обход minOf/maxOf
+    for (const auto& aggregate : query.aggregates) {
+        if (aggregate.kind == AggregateKind::Min || aggregate.kind == AggregateKind::Max) {
+            GroupBy::ordered(aggregate.column);
+        }
+    }
+
+    // Словари строят один раз на колонку, даже если она нужна и ключу, и агрегату
+    unique_ptr<Dictionary> ipDictionary, urlDictionary, pathDict;
+    auto dictionaryFor = [&](GroupKey key) -> const Dictionary* {
+        if (key == GroupKey::IP) {
+            if (!ipDictionary) ipDictionary = dictionaryFromIndex(*source.ips, view.size);
+            return ipDictionary.get();
+        }
+        if (key == GroupKey::URL) {
+            if (!urlDictionary) urlDictionary = dictionaryFromIndex(*source.urls, view.size);
+            return urlDictionary.get();
+        }
+        if (!pathDict) pathDict = pathDictionary(*source.urls, view.size);
+        return pathDict.get();
+    };
+
+    // Начало интервалов времени - по самой ранней записи
+    int64_t minEpoch = INT64_MAX;
+    for (GroupKey key : query.keys) {
+        if (key == GroupKey::Minute || key == GroupKey::Hour || key == GroupKey::Day) {
+            for (size_t i = 0; i < count; i++) {
+                int64_t epoch = view.epoch[rows ? rows[i] : i];
+                if (epoch < minEpoch) minEpoch = epoch;
+            }
+            break;
+        }
+    }
+
+    GroupContext ctx{ query, view, {}, {} };
+    for (GroupKey key : query.keys) {
+        EncodedColumn column;
+        switch (key) {
+        case GroupKey::IP:
+        case GroupKey::URL:
+        case GroupKey::Path:
+            column.kind = EncodedColumn::Kind::Codes;
+            column.dictionary = dictionaryFor(key);
+            break;
+        case GroupKey::Method: column.kind = EncodedColumn::Kind::Method; break;
+        case GroupKey::Status: column.kind = EncodedColumn::Kind::Status; break;
+        case GroupKey::StatusClass: column.kind = EncodedColumn::Kind::StatusClass; break;
+        case GroupKey::Minute:
+        case GroupKey::Hour:
+        case GroupKey::Day: {
+            column.kind = EncodedColumn::Kind::TimeBucket;
+            column.step = key == GroupKey::Minute ? 60 : key == GroupKey::Hour ? 3600 : 86400;
+            int64_t start = minEpoch == INT64_MAX ? 0 : minEpoch;
+            column.base = start >= 0 ? start - start % column.step
+                : start - (column.step + start % column.step) % column.step;
+            break;
+        }
+        }
+        ctx.keys.push_back(column);
+    }
+
+    for (const auto& aggregate : query.aggregates) {
+        EncodedColumn column;
+        switch (aggregate.column) {
+        case GroupColumn::IP:
+            column.kind = EncodedColumn::Kind::Codes;
+            if (aggregate.kind == AggregateKind::Distinct) column.dictionary = dictionaryFor(GroupKey::IP);
+            break;
+        case GroupColumn::URL:
+            column.kind = EncodedColumn::Kind::Codes;
+            if (aggregate.kind == AggregateKind::Distinct) column.dictionary = dictionaryFor(GroupKey::URL);
+            break;
+        case GroupColumn::Method: column.kind = EncodedColumn::Kind::Method; break;
+        case GroupColumn::Status: column.kind = EncodedColumn::Kind::Status; break;
+        case GroupColumn::Time: column.kind = EncodedColumn::Kind::Time; break;
+        }
+        ctx.aggregateColumns.push_back(column);
+    }
+
+    // Частичные таблицы по диапазонам записей, затем слияние в первую
+    unsigned threadCount = chooseThreadCount(count, query.threads);
+    vector<unique_ptr<GroupHashTable>> partial;
+    for (unsigned t = 0; t < threadCount; t++) {
+        partial.push_back(make_unique<GroupHashTable>(ctx.keys.size(), query.aggregates));
+    }
+
+    size_t chunk = (count + threadCount - 1) / threadCount;
+    if (threadCount <= 1) {
+        aggregateRange(ctx, rows, 0, count, *partial[0]);
+    }
+    else {
+        vector<thread> workers;
+        for (unsigned t = 0; t < threadCount; t++) {
+            size_t begin = t * chunk;
+            size_t end = begin + chunk < count ? begin + chunk : count;
+            workers.emplace_back([&ctx, rows, begin, end, &partial, t]() {
+                aggregateRange(ctx, rows, begin, end, *partial[t]);
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    GroupHashTable& merged = *partial[0];
+    for (unsigned t = 1; t < threadCount; t++) {
+        const GroupHashTable& other = *partial[t];
+        for (uint32_t g = 0; g < other.size(); g++) {
+            uint32_t target = merged.findOrInsert(other.hashes[g], other.keys.data() + g * other.keyCount);
+            merged.combine(target, other, g);
+        }
+    }
+
+    // ---- Результат ----
+    GroupTable table;
+    table.keyCount = ctx.keys.size();
+    table.aggregateCount = query.aggregates.size();
+    table.groups = merged.size();
+
+    for (GroupKey key : query.keys) {
+        table.headers.push_back(keyHeader(key));
+    }
+    for (const auto& aggregate : query.aggregates) {
+        table.headers.push_back(aggregateHeader(aggregate));
+        table.timeColumns.push_back(aggregate.column == GroupColumn::Time &&
+            aggregate.kind != AggregateKind::Distinct);
+    }
+
+    // Словари результата - только встретившиеся значения, упорядоченные:
+    // строки по тексту, числа и время по значению
+    table.keyCodes.resize(merged.keys.size());
+    for (size_t k = 0; k < table.keyCount; k++) {
+        vector<uint32_t> used;
+        used.reserve(merged.size());
+        for (size_t g = 0; g < merged.size(); g++) {
+            used.push_back(merged.keys[g * table.keyCount + k]);
+        }
+        sort(used.begin(), used.end());
+        used.erase(unique(used.begin(), used.end()), used.end());
+
+        const EncodedColumn& column = ctx.keys[k];
+        if (column.kind == EncodedColumn::Kind::Codes) {
+            const vector<string>& labels = column.dictionary->labels;
+            sort(used.begin(), used.end(), [&labels](uint32_t a, uint32_t b) {
+                return labels[a] < labels[b];
+            });
+        }
+
+        unordered_map<uint32_t, uint32_t> local;
+        vector<string> dictionary;
+        dictionary.reserve(used.size());
+        for (uint32_t code : used) {
+            local.emplace(code, static_cast<uint32_t>(dictionary.size()));
+            dictionary.push_back(labelOf(column, query.keys[k], code));
+        }
+        for (size_t g = 0; g < merged.size(); g++) {
+            size_t at = g * table.keyCount + k;
+            table.keyCodes[at] = local[merged.keys[at]];
+        }
+        table.dictionaries.push_back(move(dictionary));
+    }
+
+    table.values = move(merged.values);
+    for (size_t a = 0; a < table.aggregateCount; a++) {
+        const GroupBy::Aggregate& aggregate = query.aggregates[a];
+        for (size_t g = 0; g < table.groups; g++) {
+            int64_t& value = table.values[g * table.aggregateCount + a];
+            if (aggregate.kind == AggregateKind::Distinct) {
+                value = static_cast<int64_t>(
+                    merged.distinct[g * merged.distinctCount + merged.distinctSlot[a]].size());
+            }
+        }
+    }
+
+    // Порядок групп по ключам
+    vector<size_t> order(table.groups);
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&table](size_t a, size_t b) {
+        return lexicographical_compare(
+            table.keyCodes.begin() + a * table.keyCount, table.keyCodes.begin() + (a + 1) * table.keyCount,
+            table.keyCodes.begin() + b * table.keyCount, table.keyCodes.begin() + (b + 1) * table.keyCount);
+    });
+    table.permute(order);
+
+    return table;
+}
+
+// ==================== GroupTable ====================
+
+void GroupTable::permute(const vector<size_t>& order) {
+    vector<uint32_t> sortedKeys;
+    vector<int64_t> sortedValues;
+    sortedKeys.reserve(order.size() * keyCount);
+    sortedValues.reserve(order.size() * aggregateCount);
+    for (size_t g : order) {
+        sortedKeys.insert(sortedKeys.end(), keyCodes.begin() + g * keyCount,
+            keyCodes.begin() + (g + 1) * keyCount);
+        sortedValues.insert(sortedValues.end(), values.begin() + g * aggregateCount,
+            values.begin() + (g + 1) * aggregateCount);
+    }
+    keyCodes = move(sortedKeys);
+    values = move(sortedValues);
+    groups = order.size();
+}
+
+string GroupTable::cell(size_t group, size_t column) const {
+    if (column < keyCount) {
+        return key(group, column);
+    }
+    size_t aggregate = column - keyCount;
+    int64_t v = value(group, aggregate);
+    return timeColumns[aggregate] ? TimeUtils::fromEpochSeconds(v) : to_string(v);
+}
+
+void GroupTable::sortBy(size_t column, bool descending) {
+    vector<size_t> order(groups);
+    iota(order.begin(), order.end(), 0);
+
+    if (column < keyCount) {
+        stable_sort(order.begin(), order.end(), [this, column, descending](size_t a, size_t b) {
+            uint32_t x = keyCodes[a * keyCount + column];
+            uint32_t y = keyCodes[b * keyCount + column];
+            return descending ? y < x : x < y;
+        });
+    }
+    else if (column < keyCount + aggregateCount) {
+        size_t aggregate = column - keyCount;
+        stable_sort(order.begin(), order.end(), [this, aggregate, descending](size_t a, size_t b) {
+            int64_t x = value(a, aggregate);
+            int64_t y = value(b, aggregate);
+            return descending ? y < x : x < y;
+        });
+    }
+    permute(order);
+}
+
+void GroupTable::truncate(size_t limit) {
+    if (limit < groups) {
+        groups = limit;
+        keyCodes.resize(groups * keyCount);
+        values.resize(groups * aggregateCount);
+    }
+}
+
+vector<vector<string>> GroupTable::toRows(size_t maxRows) const {
+    size_t n = groups < maxRows ? groups : maxRows;
+    vector<vector<string>> rows;
+    rows.reserve(n);
+    for (size_t g = 0; g < n; g++) {
+        vector<string> row;
+        row.reserve(headers.size());
+        for (size_t column = 0; column < headers.size(); column++) {
+            row.push_back(cell(g, column));
+        }
+        rows.push_back(move(row));
+    }
+    return rows;
+}
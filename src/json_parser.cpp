@@ -260,8 +260,8 @@ JsonValue JsonParser::parseKeyword(const string& jsonStr, size_t& pos) {
     }
 }
 
-// Загрузка JSON из файла с обработкой BOM для Windows
-JsonValue JsonParser::loadFromFile(const string& filename) {
+// Чтение файла с обработкой BOM для Windows
+string JsonParser::readFile(const string& filename, size_t& bomBytes) {
     ifstream file(filename, ios::binary);
     if (!file.is_open()) {
         throw JsonFileException("Не удалось открыть файл: " + filename);
@@ -278,20 +278,79 @@ JsonValue JsonParser::loadFromFile(const string& filename) {
     buffer[fileSize] = '\0';
 
     // Проверяем BOM для UTF-8
-    string content;
+    bomBytes = 0;
     if (fileSize >= 3 &&
         static_cast<unsigned char>(buffer[0]) == 0xEF &&
         static_cast<unsigned char>(buffer[1]) == 0xBB &&
         static_cast<unsigned char>(buffer[2]) == 0xBF) {
         // Пропускаем BOM
-        content = string(buffer.data() + 3, fileSize - 3);
+        bomBytes = 3;
+    }
+
+    file.close();
+    return string(buffer.data() + bomBytes, fileSize - bomBytes);
+}
+
+// Загрузка JSON из файла
+JsonValue JsonParser::loadFromFile(const string& filename) {
+    size_t bomBytes = 0;
+    return parse(readFile(filename, bomBytes));
+}
+
+// Разбор массива записей по одному элементу
+vector<LogEntry> JsonParser::parseLogEntries(const string& jsonStr, vector<RecordSpan>* spans,
+    uint64_t base) {
+    vector<LogEntry> entries;
+    if (spans) spans->clear();
+
+    size_t pos = 0;
+    skipWhitespace(jsonStr, pos);
+    if (pos >= jsonStr.size() || jsonStr[pos] != '[') {
+        throw runtime_error("Не массив");
+    }
+    pos++;
+    skipWhitespace(jsonStr, pos);
+
+    if (pos < jsonStr.size() && jsonStr[pos] == ']') {
+        pos++;
     }
     else {
-        content = string(buffer.data(), fileSize);
+        while (true) {
+            skipWhitespace(jsonStr, pos);
+            size_t start = pos;
+            JsonValue element = parseValue(jsonStr, pos);
+
+            LogEntry entry;
+            if (element.toLogEntry(entry)) {
+                entries.push_back(move(entry));
+                if (spans) spans->push_back({ base + start, pos - start });
+            }
+
+            skipWhitespace(jsonStr, pos);
+            if (pos < jsonStr.size() && jsonStr[pos] == ',') {
+                pos++;
+            }
+            else if (pos < jsonStr.size() && jsonStr[pos] == ']') {
+                pos++;
+                break;
+            }
+            else {
+                throw JsonParseException("Ожидалось ',' или ']'", pos);
+            }
+        }
     }
 
-    file.close();
-    return parse(content);
+    skipWhitespace(jsonStr, pos);
+    if (pos != jsonStr.size()) {
+        throw JsonParseException("Лишние символы после JSON", pos);
+    }
+    return entries;
+}
+
+vector<LogEntry> JsonParser::loadLogEntries(const string& filename, vector<RecordSpan>* spans) {
+    size_t bomBytes = 0;
+    string content = readFile(filename, bomBytes);
+    return parseLogEntries(content, spans, bomBytes);
 }
 
 // Сохранение JSON в файл
@@ -418,25 +477,34 @@ vector<LogEntry> JsonValue::asLogEntries() const {
     }
 
     for (const auto& val : arrayValue) {
-        if (!val.isObject()) {
-            continue;
+        LogEntry entry;
+        // Пропускаем некорректные записи
+        if (val.toLogEntry(entry)) {
+            entries.push_back(move(entry));
         }
+    }
 
-        try {
-            string timestamp = val.objectValue.at("ts").asString();
-            string ip = val.objectValue.at("ip").asString();
-            string method = val.objectValue.at("method").asString();
-            string url = val.objectValue.at("url").asString();
-            int status = static_cast<int>(val.objectValue.at("status").asNumber());
+    return entries;
+}
 
-            entries.push_back(LogEntry(timestamp, ip, method, url, status));
-        }
-        catch (const exception&) {
-            // Пропускаем некорректные записи
-        }
+bool JsonValue::toLogEntry(LogEntry& entry) const {
+    if (!isObject()) {
+        return false;
     }
 
-    return entries;
+    try {
+        string timestamp = objectValue.at("ts").asString();
+        string ip = objectValue.at("ip").asString();
+        string method = objectValue.at("method").asString();
+        string url = objectValue.at("url").asString();
+        int status = static_cast<int>(objectValue.at("status").asNumber());
+
+        entry = LogEntry(timestamp, ip, method, url, status);
+        return true;
+    }
+    catch (const exception&) {
+        return false;
+    }
 }
 
 JsonValue& JsonValue::operator[](const string& key) {
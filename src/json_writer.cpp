@@ -0,0 +1,152 @@
+﻿#include "json_writer.h"
+#include "export_pipeline.h"
+#include <charconv>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LOG_ANALYZER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace JsonWriter {
+
+    static bool needsEscape(unsigned char c) {
+        return c == '"' || c == '\\' || c < 0x20;
+    }
+
+    // Позиция первого символа, требующего экранирования (или size)
+    static size_t findEscape(string_view value, size_t from) {
+        const char* data = value.data();
+        size_t size = value.size();
+        size_t i = from;
+
+#ifdef LOG_ANALYZER_SSE2
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i controlBits = _mm_set1_epi8(static_cast<char>(0xE0));
+        const __m128i zero = _mm_setzero_si128();
+
+        for (; i + 16 <= size; i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            // Управляющие символы 0x00-0x1F - байты без старших трёх битов
+            __m128i special = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)),
+                _mm_cmpeq_epi8(_mm_and_si128(block, controlBits), zero));
+            int mask = _mm_movemask_epi8(special);
+            if (mask) {
+                size_t offset = 0;
+                while (!(mask & 1)) {
+                    mask >>= 1;
+                    offset++;
+                }
+                return i + offset;
+            }
+        }
+#endif
+
+        for (; i < size; i++) {
+            if (needsEscape(static_cast<unsigned char>(data[i]))) {
+                return i;
+            }
+        }
+        return size;
+    }
+
+    void appendString(string& out, string_view value) {
+        static const char HEX[] = "0123456789abcdef";
+
+        out.push_back('"');
+        size_t start = 0;
+        for (size_t pos = findEscape(value, 0); pos < value.size(); pos = findEscape(value, start)) {
+            out.append(value.data() + start, pos - start);
+            unsigned char c = static_cast<unsigned char>(value[pos]);
+            switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                out += "\\u00";
+                out.push_back(HEX[c >> 4]);
+                out.push_back(HEX[c & 0xF]);
+                break;
+            }
+            start = pos + 1;
+        }
+        out.append(value.data() + start, value.size() - start);
+        out.push_back('"');
+    }
+
+    void appendRecord(string& out, const LogEntry& entry, const JsonExportOptions& options) {
+        bool multiline = options.pretty && options.layout == JsonLayout::Array;
+        const char* open = multiline ? "{\n    \"ts\": " : (options.pretty ? "{\"ts\": " : "{\"ts\":");
+        const char* next = multiline ? ",\n    \"" : (options.pretty ? ", \"" : ",\"");
+        const char* colon = options.pretty ? "\": " : "\":";
+
+        out += open;
+        appendString(out, entry.timestamp);
+        out += next;
+        out += "ip";
+        out += colon;
+        appendString(out, entry.ip);
+        out += next;
+        out += "method";
+        out += colon;
+        appendString(out, entry.method);
+        out += next;
+        out += "url";
+        out += colon;
+        appendString(out, entry.url);
+        out += next;
+        out += "status";
+        out += colon;
+
+        char number[16];
+        auto result = to_chars(number, number + sizeof(number), entry.status);
+        out.append(number, result.ptr);
+        out += multiline ? "\n  }" : "}";
+    }
+
+    bool write(const string& filename, const vector<LogEntry>& logs,
+        const vector<RowId>* rows, const JsonExportOptions& options) {
+        ofstream file(filename, ios::binary | ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        bool array = options.layout == JsonLayout::Array;
+        size_t count = rows ? rows->size() : logs.size();
+        if (array) {
+            file.put('[');
+        }
+
+        // Разделитель стоит перед записью, поэтому блоки не зависят друг от друга
+        auto format = [&](size_t begin, size_t end, string& buffer) {
+            buffer.reserve((end - begin) * (options.pretty ? 130 : 100));
+            for (size_t i = begin; i < end; i++) {
+                if (array) {
+                    if (i > 0) buffer.push_back(',');
+                    if (options.pretty) buffer += "\n  ";
+                }
+                appendRecord(buffer, logs[rows ? (*rows)[i] : i], options);
+                if (!array) buffer.push_back('\n');
+            }
+        };
+        auto output = [&file](const string& block) {
+            file.write(block.data(), static_cast<streamsize>(block.size()));
+            return static_cast<bool>(file);
+        };
+
+        bool ok = ExportPipeline::formatInOrder(count, format, output, options.threads);
+        if (array) {
+            file << (options.pretty && count > 0 ? "\n]\n" : "]\n");
+        }
+        file.close();
+        return ok && !file.fail();
+    }
+}
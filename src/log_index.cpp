@@ -0,0 +1,430 @@
+﻿#include "log_index.h"
+#include "time_utils.h"
+#include <algorithm>
+#include <thread>
+#include <cstdint>
+
+using namespace std;
+
+// Минимальное число записей на поток: на меньших объёмах
+// накладные расходы на запуск потоков превышают выигрыш
+static const size_t MIN_ROWS_PER_THREAD = 65536;
+
+unsigned chooseThreadCount(size_t rows, unsigned requested) {
+    unsigned hw = requested ? requested : thread::hardware_concurrency();
+    if (hw == 0) hw = 1;
+    size_t byRows = rows / MIN_ROWS_PER_THREAD;
+    if (byRows < 1) byRows = 1;
+    return static_cast<unsigned>(min<size_t>(hw, byRows));
+}
+
+// ==================== PostingList ====================
+
+void PostingList::appendVarint(uint32_t value) {
+    while (value >= 0x80) {
+        data.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    data.push_back(static_cast<uint8_t>(value));
+}
+
+void PostingList::add(RowId row) {
+    if (count == 0) {
+        first = row;
+        appendVarint(row);
+    }
+    else {
+        appendVarint(row - last);
+    }
+    last = row;
+    count++;
+}
+
+void PostingList::append(const PostingList& tail) {
+    if (tail.empty()) return;
+    if (empty()) {
+        *this = tail;
+        return;
+    }
+
+    // Первый элемент хвоста закодирован абсолютным значением:
+    // перекодируем его как разность, остальные байты копируем как есть
+    size_t pos = 0;
+    while (tail.data[pos] & 0x80) pos++;
+    pos++;
+
+    appendVarint(tail.first - last);
+    data.insert(data.end(), tail.data.begin() + pos, tail.data.end());
+    count += tail.count;
+    last = tail.last;
+}
+
+vector<RowId> PostingList::decode() const {
+    vector<RowId> rows;
+    decodeInto(rows);
+    return rows;
+}
+
+void PostingList::decodeInto(vector<RowId>& out) const {
+    out.reserve(out.size() + count);
+    forEach([&out](RowId row) { out.push_back(row); });
+}
+
+void PostingList::clear() {
+    data.clear();
+    count = 0;
+    first = 0;
+    last = 0;
+}
+
+// ==================== HashIndex ====================
+
+void HashIndex::build(const vector<LogEntry>& logs,
+    string LogEntry::* column,
+    unsigned threads) {
+    postings.clear();
+
+    size_t rows = logs.size();
+    unsigned threadCount = chooseThreadCount(rows, threads);
+
+    if (threadCount <= 1) {
+        for (size_t i = 0; i < rows; i++) {
+            postings[logs[i].*column].add(static_cast<RowId>(i));
+        }
+        return;
+    }
+
+    // Каждый поток индексирует свой непрерывный диапазон записей
+    vector<Map> partial(threadCount);
+    vector<thread> workers;
+    size_t chunk = (rows + threadCount - 1) / threadCount;
+
+    for (unsigned t = 0; t < threadCount; t++) {
+        workers.emplace_back([&, t]() {
+            size_t begin = t * chunk;
+            size_t end = min(rows, begin + chunk);
+            Map& local = partial[t];
+            for (size_t i = begin; i < end; i++) {
+                local[logs[i].*column].add(static_cast<RowId>(i));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // Диапазоны упорядочены, поэтому списки просто склеиваются
+    postings = move(partial[0]);
+    for (unsigned t = 1; t < threadCount; t++) {
+        for (auto& [key, list] : partial[t]) {
+            postings[key].append(list);
+        }
+        Map().swap(partial[t]);
+    }
+}
+
+const PostingList* HashIndex::find(const string& key) const {
+    auto it = postings.find(key);
+    if (it == postings.end()) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+size_t HashIndex::memoryBytes() const {
+    size_t total = 0;
+    for (const auto& [key, list] : postings) {
+        total += key.capacity() + list.bytes() + sizeof(PostingList);
+    }
+    return total;
+}
+
+// ==================== TimeIndex ====================
+
+void TimeIndex::build(const vector<LogEntry>& logs, unsigned threads) {
+    size_t rows = logs.size();
+    epochs.resize(rows);
+    order.clear();
+
+    // Разбор времени и проверка упорядоченности за один проход
+    unsigned threadCount = chooseThreadCount(rows, threads);
+    size_t chunk = threadCount > 0 ? (rows + threadCount - 1) / threadCount : rows;
+    vector<char> chunkSorted(threadCount, 1);
+
+    auto parseRange = [&](unsigned t) {
+        size_t begin = t * chunk;
+        size_t end = min(rows, begin + chunk);
+        for (size_t i = begin; i < end; i++) {
+            epochs[i] = TimeUtils::toEpochSeconds(logs[i].timestamp);
+            if (i > begin && epochs[i] < epochs[i - 1]) {
+                chunkSorted[t] = 0;
+            }
+        }
+    };
+
+    if (threadCount <= 1) {
+        parseRange(0);
+    }
+    else {
+        vector<thread> workers;
+        for (unsigned t = 0; t < threadCount; t++) {
+            workers.emplace_back(parseRange, t);
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    sorted = true;
+    for (unsigned t = 0; t < threadCount && sorted; t++) {
+        size_t begin = t * chunk;
+        if (!chunkSorted[t] || (t > 0 && begin < rows && epochs[begin] < epochs[begin - 1])) {
+            sorted = false;
+        }
+    }
+
+    if (!sorted) {
+        sortOrder();
+    }
+}
+
+void TimeIndex::assign(vector<int64_t> epochColumn) {
+    epochs = move(epochColumn);
+    order.clear();
+    sorted = is_sorted(epochs.begin(), epochs.end());
+    if (!sorted) {
+        sortOrder();
+    }
+}
+
+// Упорядочиваем номера записей по времени (при равном времени - по номеру)
+void TimeIndex::sortOrder() {
+    order.resize(epochs.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = static_cast<RowId>(i);
+    }
+    const vector<int64_t>& ep = epochs;
+    sort(order.begin(), order.end(), [&ep](RowId a, RowId b) {
+        return ep[a] < ep[b] || (ep[a] == ep[b] && a < b);
+    });
+}
+
+void TimeIndex::add(int64_t epoch) {
+    RowId row = static_cast<RowId>(epochs.size());
+
+    if (sorted) {
+        if (epochs.empty() || epoch >= epochs.back()) {
+            epochs.push_back(epoch);
+            return;
+        }
+
+        // Первая запись не по порядку: до неё порядок совпадал с номерами
+        order.resize(row);
+        for (RowId i = 0; i < row; i++) {
+            order[i] = i;
+        }
+        sorted = false;
+    }
+
+    epochs.push_back(epoch);
+
+    // Место после всех записей с тем же временем (их номера меньше)
+    const vector<int64_t>& ep = epochs;
+    auto pos = upper_bound(order.begin(), order.end(), epoch,
+        [&ep](int64_t value, RowId r) { return value < ep[r]; });
+    order.insert(pos, row);
+}
+
+TimeIndex::Span TimeIndex::range(int64_t from, int64_t to) const {
+    Span span;
+    if (from > to || epochs.empty()) {
+        return span;
+    }
+
+    if (sorted) {
+        span.begin = lower_bound(epochs.begin(), epochs.end(), from) - epochs.begin();
+        span.end = upper_bound(epochs.begin(), epochs.end(), to) - epochs.begin();
+    }
+    else {
+        const vector<int64_t>& ep = epochs;
+        span.begin = lower_bound(order.begin(), order.end(), from,
+            [&ep](RowId row, int64_t value) { return ep[row] < value; }) - order.begin();
+        span.end = upper_bound(order.begin(), order.end(), to,
+            [&ep](int64_t value, RowId row) { return value < ep[row]; }) - order.begin();
+    }
+
+    return span;
+}
+
+void TimeIndex::clear() {
+    epochs.clear();
+    order.clear();
+    sorted = true;
+}
+
+// ==================== BitmapIndex ====================
+
+// Верхний регистр вычисляется один раз на каждое написание метода
+const string& BitmapIndex::canonicalMethod(const string& method) {
+    auto it = upperCache.find(method);
+    if (it == upperCache.end()) {
+        string upper = method;
+        transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        it = upperCache.emplace(method, move(upper)).first;
+    }
+    return it->second;
+}
+
+void BitmapIndex::build(const vector<LogEntry>& logs) {
+    clear();
+    for (size_t i = 0; i < logs.size(); i++) {
+        add(logs[i], static_cast<RowId>(i));
+    }
+}
+
+void BitmapIndex::add(const LogEntry& entry, RowId row) {
+    statuses[entry.status].add(row);
+    statusClasses[classOf(entry.status)].add(row);
+    methods[canonicalMethod(entry.method)].add(row);
+    rows = max<size_t>(rows, static_cast<size_t>(row) + 1);
+}
+
+RoaringBitmap BitmapIndex::status(int code) const {
+    auto it = statuses.find(code);
+    return it != statuses.end() ? it->second : RoaringBitmap();
+}
+
+RoaringBitmap BitmapIndex::statusRange(int minStatus, int maxStatus) const {
+    RoaringBitmap result;
+    for (int cls = 1; cls <= 5; cls++) {
+        // Класс целиком внутри диапазона - берём готовую карту класса
+        if (minStatus <= cls * 100 && maxStatus >= cls * 100 + 99) {
+            result |= statusClasses[cls];
+        }
+    }
+    for (auto it = statuses.lower_bound(minStatus);
+        it != statuses.end() && it->first <= maxStatus; ++it) {
+        int cls = classOf(it->first);
+        if (cls != 0 && minStatus <= cls * 100 && maxStatus >= cls * 100 + 99) {
+            continue;
+        }
+        result |= it->second;
+    }
+    return result;
+}
+
+RoaringBitmap BitmapIndex::statusClass(int cls) const {
+    if (cls < 0 || cls > 5) return RoaringBitmap();
+    return statusClasses[cls];
+}
+
+RoaringBitmap BitmapIndex::method(const string& name) const {
+    string upper = name;
+    transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+    auto it = methods.find(upper);
+    return it != methods.end() ? it->second : RoaringBitmap();
+}
+
+size_t BitmapIndex::memoryBytes() const {
+    size_t total = 0;
+    for (const auto& [code, bitmap] : statuses) total += bitmap.memoryBytes();
+    for (const auto& bitmap : statusClasses) total += bitmap.memoryBytes();
+    for (const auto& [name, bitmap] : methods) total += bitmap.memoryBytes();
+    return total;
+}
+
+void BitmapIndex::clear() {
+    statuses.clear();
+    for (auto& bitmap : statusClasses) bitmap.clear();
+    methods.clear();
+    upperCache.clear();
+    rows = 0;
+}
+
+// ==================== TopKCache ====================
+
+bool TopKCache::get(int n, vector<pair<string, int>>& out) const {
+    if (limit == 0) {
+        return false;
+    }
+
+    if (n <= 0 || static_cast<size_t>(n) > items.size()) {
+        // Нужны все значения или больше, чем сохранено
+        if (!complete) return false;
+        out = items;
+        return true;
+    }
+
+    out.assign(items.begin(), items.begin() + n);
+    return true;
+}
+
+void TopKCache::store(int n, const vector<pair<string, int>>& sorted) {
+    items = sorted;
+    complete = n <= 0 || sorted.size() < static_cast<size_t>(n);
+    limit = complete ? SIZE_MAX : static_cast<size_t>(n);
+
+    positions.clear();
+    positions.reserve(items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        positions.emplace(items[i].first, i);
+    }
+}
+
+void TopKCache::swapItems(size_t a, size_t b) {
+    swap(items[a], items[b]);
+    positions[items[a].first] = a;
+    positions[items[b].first] = b;
+}
+
+void TopKCache::update(const string& key, int count) {
+    if (limit == 0) {
+        return;
+    }
+
+    size_t pos;
+    auto found = positions.find(key);
+    if (found == positions.end()) {
+        if (complete || items.size() < limit) {
+            // Новый ключ (список полный) - добавляется в конец
+            items.emplace_back(key, count);
+        }
+        else if (count > items.back().second) {
+            // Ключ обогнал последний элемент; остальные ключи вне списка
+            // не больше последнего, поэтому список остаётся верным
+            positions.erase(items.back().first);
+            items.back() = { key, count };
+        }
+        else {
+            return;
+        }
+        pos = items.size() - 1;
+        positions[key] = pos;
+    }
+    else {
+        pos = found->second;
+        items[pos].second = count;
+    }
+
+    // Ключи выше со счётчиком меньше нового: если у них один и тот же
+    // счётчик (ключ вырос на 1), достаточно обмена с первым из них
+    size_t first = partition_point(items.begin(), items.begin() + pos,
+        [count](const pair<string, int>& item) { return item.second >= count; }) - items.begin();
+    if (first < pos && items[first].second == items[pos - 1].second) {
+        swapItems(first, pos);
+        return;
+    }
+
+    // Иначе поднимаем ключ на своё место
+    while (pos > 0 && items[pos - 1].second < items[pos].second) {
+        swapItems(pos - 1, pos);
+        pos--;
+    }
+}
+
+void TopKCache::clear() {
+    items.clear();
+    positions.clear();
+    limit = 0;
+    complete = false;
+}
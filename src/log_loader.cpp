@@ -0,0 +1,186 @@
+﻿#include "log_loader.h"
+#include "log_index.h"
+#include "time_utils.h"
+#include "json_parser.h"
+#include "windows_utils.h"
+#include <algorithm>
+#include <numeric>
+#include <iterator>
+#include <atomic>
+#include <thread>
+
+using namespace std;
+
+namespace LogLoader {
+
+    // Выполнение fn(0..count-1) на нескольких потоках; задания раздаются по одному
+    template<typename Fn>
+    static void parallelFor(size_t count, unsigned threads, Fn&& fn) {
+        size_t workerCount = threads < count ? threads : count;
+        if (workerCount <= 1) {
+            for (size_t i = 0; i < count; i++) fn(i);
+            return;
+        }
+
+        atomic<size_t> next(0);
+        vector<thread> workers;
+        for (size_t w = 0; w < workerCount; w++) {
+            workers.emplace_back([&next, count, &fn]() {
+                for (size_t i = next++; i < count; i = next++) {
+                    fn(i);
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Устойчивая сортировка части по времени
+    static void sortByTime(vector<LogEntry>& rows, vector<int64_t>& epochs) {
+        vector<uint32_t> order(rows.size());
+        iota(order.begin(), order.end(), 0);
+        stable_sort(order.begin(), order.end(), [&epochs](uint32_t a, uint32_t b) {
+            return epochs[a] < epochs[b];
+        });
+
+        vector<LogEntry> sortedRows;
+        vector<int64_t> sortedEpochs;
+        sortedRows.reserve(rows.size());
+        sortedEpochs.reserve(rows.size());
+        for (uint32_t i : order) {
+            sortedRows.push_back(move(rows[i]));
+            sortedEpochs.push_back(epochs[i]);
+        }
+        rows = move(sortedRows);
+        epochs = move(sortedEpochs);
+    }
+
+    vector<string> expandInputs(const string& pathOrPattern) {
+        if (WindowsUtils::directoryExists(pathOrPattern)) {
+            return WindowsUtils::listFiles(pathOrPattern, "*.json");
+        }
+
+        if (pathOrPattern.find_first_of("*?") != string::npos) {
+            size_t slash = pathOrPattern.find_last_of("\\/");
+            if (slash == string::npos) {
+                return WindowsUtils::listFiles("", pathOrPattern);
+            }
+            return WindowsUtils::listFiles(pathOrPattern.substr(0, slash),
+                pathOrPattern.substr(slash + 1));
+        }
+
+        return { pathOrPattern };
+    }
+
+    vector<LogEntry> mergeByTime(vector<vector<LogEntry>>& parts,
+        const vector<vector<int64_t>>& epochs) {
+        size_t k = parts.size();
+        size_t total = 0;
+        for (const auto& part : parts) {
+            total += part.size();
+        }
+
+        vector<LogEntry> result;
+        if (k == 1) {
+            result = move(parts[0]);
+            return result;
+        }
+        result.reserve(total);
+
+        vector<int64_t> first(k, 0);
+        vector<bool> empty(k, true);
+        for (size_t i = 0; i < k; i++) {
+            if (!parts[i].empty()) {
+                first[i] = epochs[i][0];
+                empty[i] = false;
+            }
+        }
+
+        LoserTree<int64_t> tree(move(first), move(empty));
+        vector<size_t> position(k, 0);
+        while (!tree.empty()) {
+            size_t source = tree.top();
+            size_t& pos = position[source];
+            result.push_back(move(parts[source][pos]));
+            if (++pos < parts[source].size()) {
+                tree.replaceTop(epochs[source][pos]);
+            }
+            else {
+                tree.popTop();
+                vector<LogEntry>().swap(parts[source]);
+            }
+        }
+
+        return result;
+    }
+
+    MultiFileLoad loadFiles(const vector<string>& files, unsigned threads) {
+        MultiFileLoad load;
+        unsigned workers = threads ? threads : thread::hardware_concurrency();
+        if (workers == 0) workers = 1;
+
+        // Разбор файлов: по файлу на задание
+        size_t k = files.size();
+        vector<vector<LogEntry>> parts(k);
+        vector<vector<int64_t>> epochs(k);
+        vector<string> errors(k);
+        vector<char> sorted(k, 0);
+
+        parallelFor(k, workers, [&](size_t i) {
+            try {
+                parts[i] = JsonParser::loadLogEntries(files[i]);
+            }
+            catch (const exception& e) {
+                errors[i] = files[i] + ": " + e.what();
+                return;
+            }
+
+            epochs[i].reserve(parts[i].size());
+            for (const auto& entry : parts[i]) {
+                epochs[i].push_back(TimeUtils::toEpochSeconds(entry.timestamp));
+            }
+            sorted[i] = is_sorted(epochs[i].begin(), epochs[i].end());
+        });
+
+        // Упорядоченный файл - готовая последовательность слияния;
+        // неупорядоченный делится на куски, которые сортируются параллельно
+        vector<vector<LogEntry>> runs;
+        vector<vector<int64_t>> runEpochs;
+        vector<size_t> unsortedRuns;
+
+        for (size_t i = 0; i < k; i++) {
+            if (!errors[i].empty()) {
+                load.errors.push_back(move(errors[i]));
+                continue;
+            }
+            load.files++;
+
+            if (sorted[i]) {
+                load.sortedFiles++;
+                runs.push_back(move(parts[i]));
+                runEpochs.push_back(move(epochs[i]));
+                continue;
+            }
+
+            size_t n = parts[i].size();
+            size_t chunks = chooseThreadCount(n, workers);
+            size_t step = (n + chunks - 1) / chunks;
+            for (size_t begin = 0; begin < n; begin += step) {
+                size_t end = begin + step < n ? begin + step : n;
+                runs.emplace_back(make_move_iterator(parts[i].begin() + begin),
+                    make_move_iterator(parts[i].begin() + end));
+                runEpochs.emplace_back(epochs[i].begin() + begin, epochs[i].begin() + end);
+                unsortedRuns.push_back(runs.size() - 1);
+            }
+            vector<LogEntry>().swap(parts[i]);
+        }
+
+        parallelFor(unsortedRuns.size(), workers, [&](size_t j) {
+            sortByTime(runs[unsortedRuns[j]], runEpochs[unsortedRuns[j]]);
+        });
+
+        load.logs = mergeByTime(runs, runEpochs);
+        return load;
+    }
+}
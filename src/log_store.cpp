@@ -0,0 +1,188 @@
+﻿#include "log_store.h"
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+
+// ==================== LogSegment ====================
+
+// Индексы строятся до публикации, поэтому читатели их не изменяют
+LogSegment::LogSegment(vector<LogEntry> rows, size_t firstRow)
+    : analyzer(move(rows)), first(firstRow) {
+    analyzer.buildIndexes();
+}
+
+// ==================== LogSnapshot ====================
+
+const LogEntry& LogSnapshot::at(size_t row) const {
+    auto it = upper_bound(segments.begin(), segments.end(), row,
+        [](size_t value, const SegmentPtr& segment) { return value < segment->firstRow(); });
+    const LogSegment& segment = **(it - 1);
+    return segment.rows()[row - segment.firstRow()];
+}
+
+vector<LogEntry> LogSnapshot::filterByStatus(int status) const {
+    return collect([status](const LogAnalyzer& segment) { return segment.filterByStatus(status); });
+}
+
+vector<LogEntry> LogSnapshot::filterByMethod(const string& method) const {
+    return collect([&method](const LogAnalyzer& segment) { return segment.filterByMethod(method); });
+}
+
+vector<LogEntry> LogSnapshot::filterByIP(const string& ip) const {
+    return collect([&ip](const LogAnalyzer& segment) { return segment.filterByIP(ip); });
+}
+
+vector<LogEntry> LogSnapshot::filterByURL(const string& urlPattern) const {
+    return collect([&urlPattern](const LogAnalyzer& segment) { return segment.filterByURL(urlPattern); });
+}
+
+vector<LogEntry> LogSnapshot::filterByURLPrefix(const string& prefix) const {
+    return collect([&prefix](const LogAnalyzer& segment) { return segment.filterByURLPrefix(prefix); });
+}
+
+vector<LogEntry> LogSnapshot::filterByCIDR(const string& cidr) const {
+    return collect([&cidr](const LogAnalyzer& segment) { return segment.filterByCIDR(cidr); });
+}
+
+vector<LogEntry> LogSnapshot::filterByTimeRange(const string& startTime,
+    const string& endTime) const {
+    return collect([&startTime, &endTime](const LogAnalyzer& segment) {
+        return segment.filterByTimeRange(startTime, endTime);
+    });
+}
+
+// Сумма счётчиков по индексам сегментов и отбор топа
+static vector<pair<string, int>> mergeTop(const vector<LogSnapshot::SegmentPtr>& segments,
+    const HashIndex& (LogAnalyzer::* index)() const, int n) {
+    unordered_map<string, int, WindowsStringHash> counts;
+    for (const auto& segment : segments) {
+        for (const auto& [key, list] : (segment->data().*index)().entries()) {
+            counts[key] += static_cast<int>(list.size());
+        }
+    }
+
+    vector<pair<string, int>> sorted(counts.begin(), counts.end());
+    auto byCount = [](const pair<string, int>& a, const pair<string, int>& b) {
+        return a.second > b.second;
+    };
+
+    if (n > 0 && static_cast<size_t>(n) < sorted.size()) {
+        partial_sort(sorted.begin(), sorted.begin() + n, sorted.end(), byCount);
+        sorted.resize(n);
+    }
+    else {
+        sort(sorted.begin(), sorted.end(), byCount);
+    }
+
+    return sorted;
+}
+
+vector<pair<string, int>> LogSnapshot::getTopIPs(int n) const {
+    return mergeTop(segments, &LogAnalyzer::getIPIndex, n);
+}
+
+vector<pair<string, int>> LogSnapshot::getTopURLs(int n) const {
+    return mergeTop(segments, &LogAnalyzer::getURLIndex, n);
+}
+
+map<int, int> LogSnapshot::getStatusDistribution() const {
+    map<int, int> result;
+    for (const auto& segment : segments) {
+        for (const auto& [status, count] : segment->data().getStatusDistribution()) {
+            result[status] += count;
+        }
+    }
+    return result;
+}
+
+map<string, int> LogSnapshot::getMethodDistribution() const {
+    map<string, int> result;
+    for (const auto& segment : segments) {
+        for (const auto& [method, count] : segment->data().getMethodDistribution()) {
+            result[method] += count;
+        }
+    }
+    return result;
+}
+
+pair<string, string> LogSnapshot::getTimeRange() const {
+    pair<string, string> result;
+    int64_t earliest = 0, latest = 0;
+
+    for (const auto& segment : segments) {
+        auto range = segment->data().getTimeRange();
+        int64_t from = TimeUtils::toEpochSeconds(range.first);
+        int64_t to = TimeUtils::toEpochSeconds(range.second);
+
+        if (result.first.empty() || from < earliest) {
+            result.first = range.first;
+            earliest = from;
+        }
+        if (result.second.empty() || to > latest) {
+            result.second = range.second;
+            latest = to;
+        }
+    }
+
+    return result;
+}
+
+// ==================== LogStore ====================
+
+LogStore::LogStore(size_t capacity)
+    : current(make_shared<const LogSnapshot>()),
+    segmentCapacity(capacity > 0 ? capacity : static_cast<size_t>(DEFAULT_SEGMENT_CAPACITY)) {
+}
+
+void LogStore::append(const LogEntry& entry) {
+    pending.push_back(entry);
+    appended++;
+}
+
+void LogStore::append(const vector<LogEntry>& entries) {
+    pending.insert(pending.end(), entries.begin(), entries.end());
+    appended += entries.size();
+}
+
+void LogStore::publish() {
+    if (pending.empty()) {
+        return;
+    }
+
+    // Снимок меняет только этот поток, поэтому old - последняя версия
+    shared_ptr<const LogSnapshot> old = snapshot();
+    auto next = make_shared<LogSnapshot>();
+    next->segments = old->segments;
+    next->rows = old->rows + pending.size();
+    next->version = old->version + 1;
+
+    // Неполный последний сегмент собирается заново вместе с новыми записями
+    vector<LogEntry> rows;
+    size_t firstRow = old->rows;
+    if (!next->segments.empty() && next->segments.back()->size() < segmentCapacity) {
+        rows = next->segments.back()->rows();
+        firstRow = next->segments.back()->firstRow();
+        next->segments.pop_back();
+    }
+
+    size_t pos = 0;
+    while (pos < pending.size()) {
+        size_t take = min(segmentCapacity - rows.size(), pending.size() - pos);
+        rows.insert(rows.end(), make_move_iterator(pending.begin() + pos),
+            make_move_iterator(pending.begin() + pos + take));
+        pos += take;
+
+        size_t count = rows.size();
+        next->segments.push_back(make_shared<const LogSegment>(move(rows), firstRow));
+        firstRow += count;
+        rows.clear();
+    }
+    pending.clear();
+
+    atomic_store(&current, shared_ptr<const LogSnapshot>(move(next)));
+}
+
+shared_ptr<const LogSnapshot> LogStore::snapshot() const {
+    return atomic_load(&current);
+}
@@ -2,12 +2,16 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <charconv>
 #include <windows.h>
 #include "log_entry.h"
 #include "json_parser.h"
 #include "analyzer.h"
 #include "formatter.h"
 #include "windows_utils.h"
+#include "log_loader.h"
+#include "shard_driver.h"
+#include "etl_pipeline.h"
 
 using namespace std;
 
@@ -67,8 +71,29 @@ bool loadLogs(const string& filename) {
         WindowsUtils::HighResolutionTimer timer;
         timer.start();
 
-        JsonValue jsonData = JsonParser::loadFromFile(filename);
-        vector<LogEntry> logs = jsonData.asLogEntries();
+        // Директория или маска - несколько файлов, слитых по времени
+        vector<string> files = LogLoader::expandInputs(filename);
+        bool multipleFiles = files.size() != 1 || files[0] != filename;
+
+        vector<LogEntry> logs;
+        vector<RecordSpan> spans;
+        long long totalBytes = 0;
+        if (multipleFiles) {
+            MultiFileLoad load = LogLoader::loadFiles(files);
+            logs = move(load.logs);
+            for (const auto& error : load.errors) {
+                cout << "✗ " << error << "\n";
+            }
+            cout << "✓ Прочитано файлов: " << load.files << " из " << files.size()
+                << " (упорядоченных по времени: " << load.sortedFiles << ")\n";
+        }
+        else {
+            // Положения записей - для сохранения выборок исходным текстом
+            logs = JsonParser::loadLogEntries(filename, &spans);
+        }
+        for (const auto& file : files) {
+            totalBytes += WindowsUtils::getFileSize(file);
+        }
 
         double loadTime = timer.elapsedMilliseconds();
 
@@ -81,12 +106,15 @@ bool loadLogs(const string& filename) {
         currentLogs = logs;
         if (analyzer) delete analyzer;
         analyzer = new LogAnalyzer(currentLogs);
+        if (!multipleFiles) {
+            analyzer->attachSourceSpans(filename, move(spans));
+        }
         currentFileName = filename;
 
         cout << "✓ Успешно загружено " << logs.size() << " записей логов\n";
         cout << "✓ Время загрузки: " << loadTime << " мс\n";
         cout << "✓ Средняя скорость: "
-            << (WindowsUtils::getFileSize(filename) / 1024.0 / 1024.0) / (loadTime / 1000.0)
+            << (totalBytes / 1024.0 / 1024.0) / (loadTime / 1000.0)
             << " МБ/с\n\n";
 
         // Показываем краткую статистику
@@ -325,10 +353,22 @@ void filterByStatus() {
             cout << "\nЭкспортировать результаты в файл? (y/n): ";
             getline(cin, input);
             if (input == "y" || input == "Y") {
-                cout << "Введите имя файла (например, status_" << status << ".csv): ";
+                cout << "Введите имя файла (например, status_" << status << ".csv; "
+                    << ".json - записи в исходном виде): ";
                 getline(cin, input);
                 if (!input.empty()) {
-                    if (analyzer->exportToCSV(input)) {
+                    Selection rows = analyzer->select(LogQuery().status(status));
+                    bool saved = false;
+                    if (!input.ends_with(".json")) {
+                        saved = analyzer->exportToCSV(input, rows);
+                    }
+                    else if (analyzer->hasSourceSpans()) {
+                        saved = analyzer->exportOriginal(input, rows);
+                    }
+                    else {
+                        saved = analyzer->exportToJson(input, rows);
+                    }
+                    if (saved) {
                         cout << "Результаты сохранены в " << input << "\n";
                     }
                     else {
@@ -432,6 +472,90 @@ void filterByMethod() {
     waitForKey();
 }
 
+// Составной фильтр: все условия выполняются одним запросом
+void combinedFilter() {
+    clearScreen();
+    cout << "╔════════════════════════════════════════════════════════════════╗\n";
+    cout << "║                    СОСТАВНОЙ ФИЛЬТР                           ║\n";
+    cout << "╚════════════════════════════════════════════════════════════════╝\n\n";
+
+    if (!analyzer || analyzer->getTotalRequests() == 0) {
+        cout << "Нет данных для анализа. Загрузите логи сначала.\n";
+        waitForKey();
+        return;
+    }
+
+    cout << "Оставьте поле пустым, чтобы не использовать условие.\n\n";
+
+    LogQuery query;
+    string input;
+
+    cout << "Статус код (например, 404): ";
+    getline(cin, input);
+    if (!input.empty()) {
+        try {
+            query.status(stoi(input));
+        }
+        catch (...) {
+            cout << "Неверный формат статуса, условие пропущено.\n";
+        }
+    }
+
+    cout << "Минимальный статус (например, 500): ";
+    getline(cin, input);
+    if (!input.empty()) {
+        try {
+            query.minStatus = stoi(input);
+        }
+        catch (...) {
+            cout << "Неверный формат статуса, условие пропущено.\n";
+        }
+    }
+
+    cout << "HTTP метод (например, POST): ";
+    getline(cin, input);
+    if (!input.empty()) query.method(input);
+
+    cout << "IP-адрес: ";
+    getline(cin, input);
+    if (!input.empty()) query.fromIP(input);
+
+    cout << "Подстрока URL (например, /api/): ";
+    getline(cin, input);
+    if (!input.empty()) query.urlContains(input);
+
+    cout << "Начало периода (YYYY-MM-DDTHH:MM:SSZ): ";
+    getline(cin, query.timeStart);
+    cout << "Конец периода (YYYY-MM-DDTHH:MM:SSZ): ";
+    getline(cin, query.timeEnd);
+
+    WindowsUtils::HighResolutionTimer timer;
+    timer.start();
+
+    QueryPlan plan = analyzer->planQuery(query);
+    Selection selection = analyzer->select(query);
+
+    double filterTime = timer.elapsedMilliseconds();
+
+    clearScreen();
+    cout << "Запрос: " << query.toString() << "\n";
+    cout << "План: " << plan.describe() << "\n";
+    cout << "Найдено " << selection.size() << " записей за " << filterTime << " мс\n\n";
+
+    if (!selection.empty()) {
+        cout << LogFormatter::formatLogsTable(selection, 20) << "\n";
+
+        cout << "Распределение по статусам:\n";
+        for (const auto& [status, count] : analyzer->getStatusDistribution(selection)) {
+            double percentage = (count * 100.0) / selection.size();
+            cout << "  Статус " << status << ": " << count << " ("
+                << fixed << setprecision(1) << percentage << "%)\n";
+        }
+    }
+
+    waitForKey();
+}
+
 // Экспорт результатов
 void exportResults() {
     clearScreen();
@@ -449,6 +573,8 @@ void exportResults() {
     cout << "2. Экспортировать все логи в JSON\n";
     cout << "3. Экспортировать топ IP-адресов\n";
     cout << "4. Экспортировать топ URL\n";
+    cout << "5. Экспортировать все логи в NDJSON (запись на строку)\n";
+    cout << "6. Экспортировать все логи в Arrow/Feather (pandas, polars, DuckDB)\n";
     cout << "0. Отмена\n\n";
 
     cout << "Выберите опцию: ";
@@ -497,12 +623,24 @@ void exportResults() {
         if (file.is_open()) {
             file << "URL,Requests\n";
             for (const auto& [url, count] : topURLs) {
-                file << "\"" << url << "\"," << count << "\n";
+                string field;
+                CsvWriter::appendField(field, url);
+                file << field << "," << count << "\n";
             }
             file.close();
             success = true;
         }
     }
+    else if (choice == "5") {
+        JsonExportOptions options;
+        options.layout = JsonLayout::Lines;
+        options.pretty = false;
+        success = analyzer->exportToJson(filename, options);
+    }
+    else if (choice == "6") {
+        if (!filename.ends_with(".arrow") && !filename.ends_with(".feather")) filename += ".arrow";
+        success = analyzer->exportToArrow(filename);
+    }
 
     double exportTime = timer.elapsedMilliseconds();
 
@@ -549,10 +687,11 @@ void showMainMenu() {
         cout << "│ 6 - Фильтр по методу                                        │\n";
         cout << "│ 7 - Экспорт результатов                                     │\n";
         cout << "│ 8 - Бенчмарк производительности                             │\n";
+        cout << "│ 9 - Составной фильтр                                        │\n";
         cout << "│ 0 - Выход                                                   │\n";
         cout << "└──────────────────────────────────────────────────────────────┘\n\n";
 
-        cout << "Выберите пункт (0-8): ";
+        cout << "Выберите пункт (0-9): ";
         string choice;
         getline(cin, choice);
 
@@ -560,7 +699,7 @@ void showMainMenu() {
             break;
         }
         else if (choice == "1") {
-            cout << "Введите имя файла: ";
+            cout << "Введите имя файла, директорию или маску (logs\\*.json): ";
             string filename;
             getline(cin, filename);
             if (!filename.empty()) {
@@ -647,20 +786,181 @@ void showMainMenu() {
 
             waitForKey();
         }
+        else if (choice == "9") {
+            combinedFilter();
+        }
+    }
+}
+
+// Целое число из аргумента командной строки (вся строка - число)
+static bool parseNumber(const string& text, int& value) {
+    auto result = from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == errc() && result.ptr == text.data() + text.size();
+}
+
+// Анализ по частям в нескольких процессах (без меню):
+// program --sharded <файл, директория или маска> [число процессов]
+int runShardedAnalysis(const vector<string>& arguments) {
+    int processes = 0;
+    if (arguments.size() < 2 || arguments.size() > 3 ||
+        (arguments.size() == 3 && (!parseNumber(arguments[2], processes) || processes < 0))) {
+        cout << "Использование: --sharded <файл, директория или маска> [число процессов]\n";
+        return 1;
+    }
+
+    vector<string> files = LogLoader::expandInputs(arguments[1]);
+    WindowsUtils::HighResolutionTimer timer;
+    timer.start();
+    ShardDriver::ShardedRun run = ShardDriver::analyzeSharded(files, static_cast<unsigned>(processes));
+    double elapsed = timer.elapsedMilliseconds();
+
+    for (const auto& error : run.errors) {
+        cout << "✗ " << error << "\n";
+    }
+    const PartialAggregate& total = run.total;
+    if (total.rows == 0) {
+        cout << "Нет записей для анализа.\n";
+        return 1;
     }
+
+    cout << "✓ Файлов: " << files.size() << ", процессов: " << run.processes
+        << ", время: " << elapsed << " мс\n\n";
+    cout << "• Всего записей: " << total.rows << "\n";
+    cout << "• Временной диапазон: " << TimeUtils::fromEpochSeconds(total.firstEpoch)
+        << " - " << TimeUtils::fromEpochSeconds(total.lastEpoch) << "\n";
+    cout << "• Уникальных IP (оценка): " << total.uniqueIPs.estimate() << "\n";
+    cout << "• Уникальных URL (оценка): " << total.uniqueURLs.estimate() << "\n\n";
+
+    cout << "Статусы:\n";
+    for (const auto& [status, count] : total.statuses) {
+        cout << "  " << status << ": " << count << "\n";
+    }
+    cout << "Методы:\n";
+    for (const auto& [method, count] : total.methods) {
+        cout << "  " << method << ": " << count << "\n";
+    }
+
+    // Счётчики сводки занижены не больше чем на errorBound
+    auto printTop = [](const char* title, const TopKSketch& sketch) {
+        cout << title << " (погрешность до " << sketch.errorBound() << "):\n";
+        for (const auto& [key, count] : sketch.top(10)) {
+            cout << "  " << key << ": " << count << "\n";
+        }
+    };
+    printTop("Топ IP", total.topIPs);
+    printTop("Топ URL", total.topURLs);
+    return run.errors.empty() ? 0 : 2;
+}
+
+// Преобразование формата без загрузки в анализатор (без меню):
+// program --convert <csv|json|ndjson|arrow> <выходной файл> <входы...> [условия]
+// Условия: --status N, --min-status N, --max-status N, --method M, --ip A,
+// --url S, --from T, --to T. Вход - файл, директория или маска
+int runConversion(const vector<string>& arguments) {
+    auto usage = []() {
+        cout << "Использование: --convert <csv|json|ndjson|arrow> <выходной файл> <входы...>"
+            << " [--status N] [--min-status N] [--max-status N] [--method M]"
+            << " [--ip A] [--url S] [--from T] [--to T]\n";
+        return 1;
+    };
+
+    EtlOptions options;
+    if (arguments.size() < 4 || !EtlPipeline::parseFormat(arguments[1], options.format)) {
+        return usage();
+    }
+
+    vector<string> inputs;
+    LogQuery& filter = options.filter;
+    for (size_t i = 3; i < arguments.size(); i++) {
+        const string& argument = arguments[i];
+        if (!argument.starts_with("--")) {
+            vector<string> files = LogLoader::expandInputs(argument);
+            inputs.insert(inputs.end(), files.begin(), files.end());
+            continue;
+        }
+        if (i + 1 >= arguments.size()) {
+            cout << "✗ Нет значения для " << argument << "\n";
+            return usage();
+        }
+
+        const string& value = arguments[++i];
+        int number = 0;
+        bool numeric = argument == "--status" || argument == "--min-status" || argument == "--max-status";
+        if (numeric && !parseNumber(value, number)) {
+            cout << "✗ Не число: " << argument << " " << value << "\n";
+            return usage();
+        }
+
+        if (argument == "--status") filter.status(number);
+        else if (argument == "--min-status") filter.minStatus = number;
+        else if (argument == "--max-status") filter.maxStatus = number;
+        else if (argument == "--method") filter.method(value);
+        else if (argument == "--ip") filter.fromIP(value);
+        else if (argument == "--url") filter.urlContains(value);
+        else if (argument == "--from") filter.timeStart = value;
+        else if (argument == "--to") filter.timeEnd = value;
+        else {
+            cout << "✗ Неизвестный параметр: " << argument << "\n";
+            return usage();
+        }
+    }
+    if (inputs.empty()) {
+        cout << "✗ Нет входных файлов\n";
+        return 1;
+    }
+
+    WindowsUtils::HighResolutionTimer timer;
+    timer.start();
+    EtlStats stats;
+    bool ok = EtlPipeline::run(inputs, arguments[2], options, stats);
+    double elapsed = timer.elapsedMilliseconds();
+
+    if (!ok) {
+        cout << "✗ " << stats.error << "\n";
+    }
+    cout << (ok ? "✓ " : "  ") << "Файлов: " << inputs.size()
+        << ", прочитано: " << stats.bytesRead << " байт, время: " << elapsed << " мс\n";
+    cout << "• Записей: " << stats.records << ", записано: " << stats.written
+        << ", пропущено: " << stats.skipped << "\n";
+    if (!filter.isEmpty()) {
+        cout << "• Условия: " << filter.toString() << "\n";
+    }
+    return ok ? 0 : 2;
 }
 
 // Точка входа
-int main() {
+int main(int argc, char* argv[]) {
+    vector<string> arguments(argv + 1, argv + argc);
+
+    // Обработчик части данных для координатора (см. shard_driver.h)
+    if (!arguments.empty() && arguments[0] == ShardDriver::WORKER_FLAG) {
+        return ShardDriver::runWorker(vector<string>(arguments.begin() + 1, arguments.end()));
+    }
+
     // Настройка консоли
     setupConsole();
 
+    int exitCode = 0;
+    bool interactive = false;
     try {
-        showMainMenu();
+        if (!arguments.empty() && arguments[0] == "--sharded") {
+            exitCode = runShardedAnalysis(arguments);
+        }
+        else if (!arguments.empty() && arguments[0] == "--convert") {
+            exitCode = runConversion(arguments);
+        }
+        else {
+            interactive = true;
+            showMainMenu();
+        }
     }
     catch (const exception& e) {
         cerr << "Критическая ошибка: " << e.what() << endl;
-        waitForKey();
+        // Режимы командной строки не ждут нажатия клавиши
+        if (interactive) {
+            waitForKey();
+        }
+        exitCode = 1;
     }
 
     // Очистка ресурсов
@@ -672,5 +972,5 @@ int main() {
     // Восстановление консоли
     restoreConsole();
 
-    return 0;
+    return exitCode;
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+﻿#include "ngram_index.h"
+#include "bitmap.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LOG_ANALYZER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// ==================== Поиск подстроки ====================
+
+size_t findSubstring(const char* text, size_t textLength,
+    const char* pattern, size_t patternLength) {
+    if (patternLength == 0) return 0;
+    if (patternLength > textLength) return string::npos;
+
+    if (patternLength == 1) {
+        const void* found = memchr(text, pattern[0], textLength);
+        return found ? static_cast<const char*>(found) - text : string::npos;
+    }
+
+    const size_t lastOffset = patternLength - 1;
+    const size_t positions = textLength - lastOffset;  // допустимые начала
+    size_t i = 0;
+
+#ifdef LOG_ANALYZER_SSE2
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[lastOffset]);
+
+    for (; i + 16 <= positions; i += 16) {
+        __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + lastOffset));
+        __m128i equal = _mm_and_si128(_mm_cmpeq_epi8(first, blockFirst),
+            _mm_cmpeq_epi8(last, blockLast));
+
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(equal));
+        while (mask) {
+            size_t pos = i + RoaringBitmap::countTrailingZeros(mask);
+            if (memcmp(text + pos + 1, pattern + 1, patternLength - 2) == 0) {
+                return pos;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    // Хвост (или весь текст без SSE2)
+    for (; i < positions; i++) {
+        if (text[i] == pattern[0] && text[i + lastOffset] == pattern[lastOffset] &&
+            memcmp(text + i + 1, pattern + 1, patternLength - 2) == 0) {
+            return i;
+        }
+    }
+
+    return string::npos;
+}
+
+// ==================== NGramIndex ====================
+
+void NGramIndex::build(const HashIndex& dictionary) {
+    clear();
+    terms.reserve(dictionary.distinctKeys());
+
+    for (const auto& entry : dictionary.entries()) {
+        add(entry);
+    }
+}
+
+void NGramIndex::add(const Term& term) {
+    uint32_t id = static_cast<uint32_t>(terms.size());
+    terms.push_back(&term);
+
+    // Каждая триграмма значения учитывается один раз
+    const string& value = term.first;
+    vector<uint32_t> local;
+    for (size_t pos = 0; pos + GRAM <= value.size(); pos++) {
+        local.push_back(gramAt(value, pos));
+    }
+    sort(local.begin(), local.end());
+    local.erase(unique(local.begin(), local.end()), local.end());
+
+    for (uint32_t gram : local) {
+        grams[gram].add(id);
+    }
+}
+
+vector<uint32_t> NGramIndex::candidates(const string& pattern) const {
+    vector<uint32_t> result;
+
+    // Короткий образец не сужает поиск - проверяются все значения
+    if (pattern.size() < GRAM) {
+        result.resize(terms.size());
+        for (size_t i = 0; i < result.size(); i++) {
+            result[i] = static_cast<uint32_t>(i);
+        }
+        return result;
+    }
+
+    vector<const PostingList*> lists;
+    for (size_t pos = 0; pos + GRAM <= pattern.size(); pos++) {
+        auto it = grams.find(gramAt(pattern, pos));
+        if (it == grams.end()) {
+            return result;  // триграммы нет ни в одном значении
+        }
+        lists.push_back(&it->second);
+    }
+
+    // Пересечение начинается с самого короткого списка
+    sort(lists.begin(), lists.end(),
+        [](const PostingList* a, const PostingList* b) { return a->size() < b->size(); });
+    lists.erase(unique(lists.begin(), lists.end()), lists.end());
+
+    lists[0]->decodeInto(result);
+    vector<uint32_t> next;
+    for (size_t l = 1; l < lists.size() && !result.empty(); l++) {
+        next.clear();
+        size_t k = 0;
+        lists[l]->forEach([&](uint32_t id) {
+            while (k < result.size() && result[k] < id) k++;
+            if (k < result.size() && result[k] == id) next.push_back(id);
+        });
+        result.swap(next);
+    }
+
+    return result;
+}
+
+size_t NGramIndex::memoryBytes() const {
+    size_t total = terms.capacity() * sizeof(const Term*);
+    for (const auto& [gram, list] : grams) {
+        total += sizeof(gram) + sizeof(PostingList) + list.bytes();
+    }
+    return total;
+}
+
+void NGramIndex::clear() {
+    terms.clear();
+    grams.clear();
+}
@@ -0,0 +1,343 @@
+﻿#include "partial_aggregate.h"
+#include "time_utils.h"
+#include "columns.h"
+#include "varint.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// Формат частичного агрегата: "LPA1", затем поля по порядку объявления
+static const char MAGIC[4] = { 'L', 'P', 'A', '1' };
+
+// ==================== TopKSketch ====================
+
+TopKSketch::TopKSketch(size_t k) : capacity(k > 0 ? k : 1) {
+}
+
+void TopKSketch::prune(size_t keep) {
+    if (counters.size() <= keep) return;
+
+    vector<uint64_t> values;
+    values.reserve(counters.size());
+    for (const auto& counter : counters) {
+        values.push_back(counter.second);
+    }
+    nth_element(values.begin(), values.begin() + keep, values.end(), greater<uint64_t>());
+    uint64_t cut = values[keep];
+
+    for (auto it = counters.begin(); it != counters.end();) {
+        if (it->second <= cut) {
+            it = counters.erase(it);
+        }
+        else {
+            it->second -= cut;
+            ++it;
+        }
+    }
+    error += cut;
+}
+
+void TopKSketch::add(const string& key, uint64_t count) {
+    counters[key] += count;
+    // Запас до 2k: вычитание раз в k новых значений, амортизированно O(1)
+    if (counters.size() > 2 * capacity) {
+        prune(capacity);
+    }
+}
+
+void TopKSketch::assign(vector<pair<string, uint64_t>> counts) {
+    clear();
+    if (counts.size() > capacity) {
+        nth_element(counts.begin(), counts.begin() + capacity, counts.end(),
+            [](const pair<string, uint64_t>& a, const pair<string, uint64_t>& b) {
+                return a.second > b.second;
+            });
+        error = counts[capacity].second;
+        counts.resize(capacity);
+    }
+    for (auto& [key, count] : counts) {
+        counters.emplace(move(key), count);
+    }
+}
+
+void TopKSketch::merge(const TopKSketch& other) {
+    for (const auto& [key, count] : other.counters) {
+        counters[key] += count;
+    }
+    error += other.error;
+    prune(capacity);
+}
+
+vector<pair<string, uint64_t>> TopKSketch::top(size_t n) const {
+    vector<pair<string, uint64_t>> sorted(counters.begin(), counters.end());
+    auto byCount = [](const pair<string, uint64_t>& a, const pair<string, uint64_t>& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    };
+    if (n < sorted.size()) {
+        partial_sort(sorted.begin(), sorted.begin() + n, sorted.end(), byCount);
+        sorted.resize(n);
+    }
+    else {
+        sort(sorted.begin(), sorted.end(), byCount);
+    }
+    return sorted;
+}
+
+uint64_t TopKSketch::estimate(const string& key) const {
+    auto it = counters.find(key);
+    return it != counters.end() ? it->second : 0;
+}
+
+void TopKSketch::serialize(string& out) const {
+    vector<pair<string, uint64_t>> sorted(counters.begin(), counters.end());
+    sort(sorted.begin(), sorted.end());
+
+    appendVarint(out, capacity);
+    appendVarint(out, error);
+    appendVarint(out, sorted.size());
+    for (const auto& [key, count] : sorted) {
+        appendString(out, key);
+        appendVarint(out, count);
+    }
+}
+
+bool TopKSketch::deserialize(string_view data, size_t& pos) {
+    clear();
+    uint64_t k, count;
+    if (!readVarint(data, pos, k) || k == 0 || !readVarint(data, pos, error) ||
+        !readVarint(data, pos, count)) {
+        return false;
+    }
+    capacity = static_cast<size_t>(k);
+
+    for (uint64_t i = 0; i < count; i++) {
+        string key;
+        uint64_t value;
+        if (!readString(data, pos, key) || !readVarint(data, pos, value)) {
+            clear();
+            return false;
+        }
+        counters[move(key)] += value;
+    }
+    return true;
+}
+
+void TopKSketch::clear() {
+    counters.clear();
+    error = 0;
+}
+
+// ==================== HyperLogLog ====================
+
+// FNV-1a и перемешивание splitmix64: у FNV старшие биты коротких
+// строк распределены плохо, а номер регистра берётся из них
+uint64_t HyperLogLog::hash(string_view value) {
+    uint64_t h = 14695981039346656037ULL;
+    for (char c : value) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+void HyperLogLog::add(string_view value) {
+    uint64_t h = hash(value);
+    size_t index = static_cast<size_t>(h >> (64 - PRECISION));
+
+    // Ранг - позиция первой единицы в оставшихся битах
+    uint64_t rest = h << PRECISION;
+    uint8_t rank = 1;
+    while (rank <= 64 - PRECISION && !(rest & (1ULL << 63))) {
+        rest <<= 1;
+        rank++;
+    }
+    if (registers[index] < rank) {
+        registers[index] = rank;
+    }
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    for (size_t i = 0; i < REGISTERS; i++) {
+        if (registers[i] < other.registers[i]) {
+            registers[i] = other.registers[i];
+        }
+    }
+}
+
+uint64_t HyperLogLog::estimate() const {
+    double m = static_cast<double>(REGISTERS);
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (uint8_t rank : registers) {
+        sum += ldexp(1.0, -rank);
+        if (rank == 0) zeros++;
+    }
+
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * log(m / static_cast<double>(zeros));
+    }
+    return static_cast<uint64_t>(estimate + 0.5);
+}
+
+void HyperLogLog::serialize(string& out) const {
+    size_t filled = static_cast<size_t>(count_if(registers.begin(), registers.end(),
+        [](uint8_t rank) { return rank != 0; }));
+
+    // Пара (разность номеров, значение) занимает 2-3 байта
+    if (filled < REGISTERS / 3) {
+        out.push_back(0);
+        appendVarint(out, filled);
+        size_t previous = 0;
+        for (size_t i = 0; i < REGISTERS; i++) {
+            if (!registers[i]) continue;
+            appendVarint(out, i - previous);
+            out.push_back(static_cast<char>(registers[i]));
+            previous = i;
+        }
+        return;
+    }
+
+    out.push_back(1);
+    out.append(reinterpret_cast<const char*>(registers.data()), REGISTERS);
+}
+
+bool HyperLogLog::deserialize(string_view data, size_t& pos) {
+    clear();
+    if (pos >= data.size()) return false;
+    char layout = data[pos++];
+
+    if (layout == 1) {
+        if (data.size() - pos < REGISTERS) return false;
+        copy(data.begin() + pos, data.begin() + pos + REGISTERS, registers.begin());
+        pos += REGISTERS;
+        return true;
+    }
+    if (layout != 0) return false;
+
+    uint64_t filled;
+    if (!readVarint(data, pos, filled) || filled > REGISTERS) return false;
+    size_t index = 0;
+    for (uint64_t i = 0; i < filled; i++) {
+        uint64_t delta;
+        if (!readVarint(data, pos, delta) || pos >= data.size() || delta >= REGISTERS - index) {
+            clear();
+            return false;
+        }
+        index += static_cast<size_t>(delta);
+        registers[index] = static_cast<uint8_t>(data[pos++]);
+    }
+    return true;
+}
+
+void HyperLogLog::clear() {
+    fill(registers.begin(), registers.end(), static_cast<uint8_t>(0));
+}
+
+// ==================== PartialAggregate ====================
+
+void PartialAggregate::add(const LogEntry& entry) {
+    int64_t epoch = TimeUtils::toEpochSeconds(entry.timestamp);
+    if (rows == 0 || epoch < firstEpoch) firstEpoch = epoch;
+    if (rows == 0 || epoch > lastEpoch) lastEpoch = epoch;
+    rows++;
+
+    statuses[entry.status]++;
+    methods[entry.method]++;
+    topIPs.add(entry.ip);
+    topURLs.add(entry.url);
+    uniqueIPs.add(entry.ip);
+    uniqueURLs.add(entry.url);
+    rollup.add(epoch, entry.status, methodCode(entry.method));
+}
+
+void PartialAggregate::merge(const PartialAggregate& other) {
+    if (other.rows > 0) {
+        if (rows == 0 || other.firstEpoch < firstEpoch) firstEpoch = other.firstEpoch;
+        if (rows == 0 || other.lastEpoch > lastEpoch) lastEpoch = other.lastEpoch;
+    }
+    rows += other.rows;
+
+    for (const auto& [status, count] : other.statuses) {
+        statuses[status] += count;
+    }
+    for (const auto& [method, count] : other.methods) {
+        methods[method] += count;
+    }
+    topIPs.merge(other.topIPs);
+    topURLs.merge(other.topURLs);
+    uniqueIPs.merge(other.uniqueIPs);
+    uniqueURLs.merge(other.uniqueURLs);
+    rollup.merge(other.rollup);
+}
+
+string PartialAggregate::serialize() const {
+    string out(MAGIC, sizeof(MAGIC));
+    appendVarint(out, rows);
+    appendVarint(out, zigzag(firstEpoch));
+    appendVarint(out, zigzag(lastEpoch));
+
+    appendVarint(out, statuses.size());
+    for (const auto& [status, count] : statuses) {
+        appendVarint(out, zigzag(status));
+        appendVarint(out, count);
+    }
+    appendVarint(out, methods.size());
+    for (const auto& [method, count] : methods) {
+        appendString(out, method);
+        appendVarint(out, count);
+    }
+
+    topIPs.serialize(out);
+    topURLs.serialize(out);
+    uniqueIPs.serialize(out);
+    uniqueURLs.serialize(out);
+    appendString(out, rollup.serialize());
+    return out;
+}
+
+bool PartialAggregate::deserialize(string_view data) {
+    statuses.clear();
+    methods.clear();
+    if (data.size() < sizeof(MAGIC) || data.substr(0, sizeof(MAGIC)) != string_view(MAGIC, sizeof(MAGIC))) {
+        return false;
+    }
+
+    size_t pos = sizeof(MAGIC);
+    uint64_t first, last, count;
+    if (!readVarint(data, pos, rows) || !readVarint(data, pos, first) ||
+        !readVarint(data, pos, last) || !readVarint(data, pos, count)) {
+        return false;
+    }
+    firstEpoch = unzigzag(first);
+    lastEpoch = unzigzag(last);
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t status, value;
+        if (!readVarint(data, pos, status) || !readVarint(data, pos, value)) return false;
+        statuses[static_cast<int>(unzigzag(status))] += value;
+    }
+
+    if (!readVarint(data, pos, count)) return false;
+    for (uint64_t i = 0; i < count; i++) {
+        string method;
+        uint64_t value;
+        if (!readString(data, pos, method) || !readVarint(data, pos, value)) return false;
+        methods[move(method)] += value;
+    }
+
+    string cube;
+    if (!topIPs.deserialize(data, pos) || !topURLs.deserialize(data, pos) ||
+        !uniqueIPs.deserialize(data, pos) || !uniqueURLs.deserialize(data, pos) ||
+        !readString(data, pos, cube) || !rollup.deserialize(cube)) {
+        return false;
+    }
+    return pos == data.size();
+}
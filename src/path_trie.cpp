@@ -0,0 +1,252 @@
+﻿#include "path_trie.h"
+#include <algorithm>
+
+using namespace std;
+
+// ==================== Разбор URL ====================
+
+// Начало части после схемы ("http://")
+static size_t afterScheme(string_view url) {
+    size_t start = url.find("://");
+    return start == string_view::npos ? 0 : start + 3;
+}
+
+string_view urlDomainView(string_view url) {
+    size_t start = afterScheme(url);
+
+    size_t end = url.find('/', start);
+    if (end == string_view::npos) {
+        end = url.length();
+    }
+
+    return url.substr(start, end - start);
+}
+
+string_view urlPathView(string_view url) {
+    size_t slashPos = url.find('/', afterScheme(url));
+    if (slashPos == string_view::npos) {
+        return "/";
+    }
+
+    size_t queryPos = url.find('?', slashPos);
+    if (queryPos == string_view::npos) {
+        return url.substr(slashPos);
+    }
+
+    return url.substr(slashPos, queryPos - slashPos);
+}
+
+// Обход непустых сегментов пути; fn возвращает false, чтобы прервать обход
+template<typename Fn>
+static bool forEachSegment(string_view path, Fn&& fn) {
+    size_t pos = 0;
+    while (pos < path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == string_view::npos) {
+            end = path.size();
+        }
+        if (end > pos && !fn(path.substr(pos, end - pos))) {
+            return false;
+        }
+        pos = end + 1;
+    }
+    return true;
+}
+
+// ==================== PathTrie ====================
+
+void PathTrie::build(const vector<LogEntry>& logs) {
+    clear();
+    for (size_t i = 0; i < logs.size(); i++) {
+        add(logs[i], static_cast<RowId>(i));
+    }
+}
+
+void PathTrie::add(const LogEntry& entry, RowId row) {
+    NodeId node;
+    auto cached = urlNodes.find(entry.url);
+    if (cached != urlNodes.end()) {
+        node = cached->second;
+    }
+    else {
+        node = insertPath(urlPathView(entry.url));
+        urlNodes.emplace(entry.url, node);
+    }
+
+    nodes[node].rows.add(row);
+
+    // Счётчики поддеревьев всех предков, включая корень
+    int cls = BitmapIndex::classOf(entry.status);
+    for (NodeId n = node; n != NONE; n = nodes[n].parent) {
+        nodes[n].counts.requests++;
+        nodes[n].counts.statusClasses[cls]++;
+    }
+}
+
+PathTrie::NodeId PathTrie::insertPath(string_view path) {
+    NodeId node = ROOT;
+
+    forEachSegment(path, [this, &node](string_view segment) {
+        uint32_t id;
+        auto found = segmentIds.find(segment);
+        if (found != segmentIds.end()) {
+            id = found->second;
+        }
+        else {
+            id = static_cast<uint32_t>(segments.size());
+            segments.emplace_back(segment);
+            segmentIds.emplace(segments.back(), id);
+        }
+
+        auto edge = edges.find(edgeKey(node, id));
+        if (edge != edges.end()) {
+            node = edge->second;
+            return true;
+        }
+
+        NodeId created = static_cast<NodeId>(nodes.size());
+        Node next;
+        next.segment = id;
+        next.parent = node;
+        next.nextSibling = nodes[node].firstChild;
+        next.depth = nodes[node].depth + 1;
+        nodes.push_back(move(next));
+        nodes[node].firstChild = created;
+        edges.emplace(edgeKey(node, id), created);
+
+        node = created;
+        return true;
+    });
+
+    return node;
+}
+
+PathTrie::NodeId PathTrie::child(NodeId parent, string_view segment) const {
+    auto id = segmentIds.find(segment);
+    if (id == segmentIds.end()) {
+        return NONE;
+    }
+
+    auto edge = edges.find(edgeKey(parent, id->second));
+    return edge == edges.end() ? NONE : edge->second;
+}
+
+PathTrie::NodeId PathTrie::find(string_view prefix) const {
+    NodeId node = ROOT;
+
+    bool found = forEachSegment(prefix, [this, &node](string_view segment) {
+        node = child(node, segment);
+        return node != NONE;
+    });
+
+    return found ? node : NONE;
+}
+
+PathTrie::Counts PathTrie::prefixCounts(string_view prefix) const {
+    NodeId node = find(prefix);
+    return node == NONE ? Counts() : nodes[node].counts;
+}
+
+vector<PathTrie::Child> PathTrie::children(string_view prefix) const {
+    vector<Child> result;
+
+    NodeId parent = find(prefix);
+    if (parent == NONE) {
+        return result;
+    }
+
+    string base = pathOf(parent);
+    if (base.back() != '/') {
+        base += '/';
+    }
+
+    for (NodeId node = nodes[parent].firstChild; node != NONE; node = nodes[node].nextSibling) {
+        Child item;
+        item.path = base + segments[nodes[node].segment];
+        item.node = node;
+        item.counts = nodes[node].counts;
+        result.push_back(move(item));
+    }
+
+    sort(result.begin(), result.end(), [](const Child& a, const Child& b) {
+        if (a.counts.requests != b.counts.requests) {
+            return a.counts.requests > b.counts.requests;
+        }
+        return a.path < b.path;
+    });
+
+    return result;
+}
+
+vector<RowId> PathTrie::rowsUnder(NodeId node) const {
+    vector<RowId> rows;
+    if (node == NONE) {
+        return rows;
+    }
+    rows.reserve(nodes[node].counts.requests);
+
+    // Обход поддерева без рекурсии
+    size_t lists = 0;
+    vector<NodeId> stack = { node };
+    while (!stack.empty()) {
+        NodeId current = stack.back();
+        stack.pop_back();
+
+        if (!nodes[current].rows.empty()) {
+            nodes[current].rows.decodeInto(rows);
+            lists++;
+        }
+        for (NodeId c = nodes[current].firstChild; c != NONE; c = nodes[c].nextSibling) {
+            stack.push_back(c);
+        }
+    }
+
+    // Списки разных узлов перемежаются - восстанавливаем порядок записей
+    if (lists > 1) {
+        sort(rows.begin(), rows.end());
+    }
+
+    return rows;
+}
+
+string PathTrie::pathOf(NodeId node) const {
+    if (node == ROOT) {
+        return "/";
+    }
+
+    vector<uint32_t> chain;
+    for (NodeId n = node; n != ROOT; n = nodes[n].parent) {
+        chain.push_back(nodes[n].segment);
+    }
+
+    string path;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        path += '/';
+        path += segments[*it];
+    }
+    return path;
+}
+
+size_t PathTrie::memoryBytes() const {
+    size_t total = nodes.capacity() * sizeof(Node);
+    for (const auto& node : nodes) {
+        total += node.rows.bytes();
+    }
+    for (const auto& segment : segments) {
+        total += sizeof(string) + segment.capacity();
+    }
+    total += segmentIds.size() * (sizeof(string_view) + sizeof(uint32_t));
+    total += edges.size() * (sizeof(uint64_t) + sizeof(NodeId));
+    for (const auto& [url, node] : urlNodes) {
+        total += url.capacity() + sizeof(NodeId);
+    }
+    return total;
+}
+
+void PathTrie::clear() {
+    nodes.assign(1, Node());  // корень "/"
+    segments.clear();
+    segmentIds.clear();
+    edges.clear();
+    urlNodes.clear();
+}
@@ -0,0 +1,148 @@
+﻿#include "query.h"
+#include "time_utils.h"
+#include "ngram_index.h"
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+
+// Копирование записей выборки
+vector<LogEntry> Selection::materialize() const {
+    vector<LogEntry> result;
+    result.reserve(rows.size());
+
+    for (RowId row : rows) {
+        result.push_back((*source)[row]);
+    }
+
+    return result;
+}
+
+// Текстовое описание запроса
+string LogQuery::toString() const {
+    ostringstream oss;
+    string separator;
+
+    if (!statuses.empty()) {
+        oss << separator << "status IN (";
+        for (size_t i = 0; i < statuses.size(); i++) {
+            oss << (i ? ", " : "") << statuses[i];
+        }
+        oss << ")";
+        separator = " AND ";
+    }
+    if (minStatus > 0) {
+        oss << separator << "status >= " << minStatus;
+        separator = " AND ";
+    }
+    if (maxStatus > 0) {
+        oss << separator << "status <= " << maxStatus;
+        separator = " AND ";
+    }
+    if (!methods.empty()) {
+        oss << separator << "method IN (";
+        for (size_t i = 0; i < methods.size(); i++) {
+            oss << (i ? ", " : "") << methods[i];
+        }
+        oss << ")";
+        separator = " AND ";
+    }
+    if (!ip.empty()) {
+        oss << separator << "ip = " << ip;
+        separator = " AND ";
+    }
+    if (!urlSubstring.empty()) {
+        oss << separator << "url LIKE %" << urlSubstring << "%";
+        separator = " AND ";
+    }
+    if (hasTimeFilter()) {
+        oss << separator << "ts IN [" << (timeStart.empty() ? "-" : timeStart)
+            << ", " << (timeEnd.empty() ? "-" : timeEnd) << "]";
+    }
+
+    string result = oss.str();
+    return result.empty() ? "все записи" : result;
+}
+
+QueryFilter::QueryFilter(const LogQuery& q) : query(q) {
+    for (const auto& method : q.methods) {
+        string upper = method;
+        transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        upperMethods.push_back(upper);
+    }
+
+    epochBounds = (q.timeStart.empty() || TimeUtils::isFullTimestamp(q.timeStart)) &&
+        (q.timeEnd.empty() || TimeUtils::isFullTimestamp(q.timeEnd));
+    if (!q.timeStart.empty()) from = TimeUtils::toEpochSeconds(q.timeStart);
+    if (!q.timeEnd.empty()) to = TimeUtils::toEpochSeconds(q.timeEnd);
+}
+
+bool QueryFilter::statusMatches(int status) const {
+    if (query.minStatus > 0 && status < query.minStatus) return false;
+    if (query.maxStatus > 0 && status > query.maxStatus) return false;
+    return query.statuses.empty() ||
+        find(query.statuses.begin(), query.statuses.end(), status) != query.statuses.end();
+}
+
+// Сравнение без учёта регистра без копирования строки записи
+bool QueryFilter::methodMatches(const string& method) const {
+    for (const auto& upper : upperMethods) {
+        if (upper.size() == method.size() &&
+            equal(upper.begin(), upper.end(), method.begin(),
+                [](char a, char b) { return a == toupper(static_cast<unsigned char>(b)); })) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool QueryFilter::timeMatches(const string& timestamp) const {
+    if (epochBounds) {
+        int64_t epoch = TimeUtils::toEpochSeconds(timestamp);
+        return epoch >= from && epoch <= to;
+    }
+    if (!query.timeStart.empty() && timestamp < query.timeStart) return false;
+    if (!query.timeEnd.empty() && timestamp > query.timeEnd) return false;
+    return true;
+}
+
+bool QueryFilter::matches(const LogEntry& entry) const {
+    if (query.hasStatusFilter() && !statusMatches(entry.status)) return false;
+    if (!query.methods.empty() && !methodMatches(entry.method)) return false;
+    if (!query.ip.empty() && entry.ip != query.ip) return false;
+    if (query.hasTimeFilter() && !timeMatches(entry.timestamp)) return false;
+    if (!query.urlSubstring.empty() && !containsSubstring(entry.url, query.urlSubstring)) return false;
+    return true;
+}
+
+// Текстовое описание плана (для отладки и вывода в меню)
+string QueryPlan::describe() const {
+    ostringstream oss;
+
+    switch (source) {
+    case Source::Empty:     oss << "пустой результат"; break;
+    case Source::FullScan:  oss << "полный просмотр"; break;
+    case Source::IPIndex:   oss << "хэш-индекс IP"; break;
+    case Source::TimeIndex: oss << "индекс времени"; break;
+    case Source::Bitmap:    oss << "битовые карты статуса/метода"; break;
+    case Source::URLIndex:  oss << "индекс URL"; break;
+    }
+    oss << ", кандидатов: " << candidates;
+
+    vector<string> checks;
+    if (checkStatus) checks.push_back("статус");
+    if (checkMethod) checks.push_back("метод");
+    if (checkIP) checks.push_back("IP");
+    if (checkURL) checks.push_back("URL");
+    if (checkTime) checks.push_back("время");
+
+    if (!checks.empty()) {
+        oss << ", проверка:";
+        for (const auto& check : checks) {
+            oss << " " << check;
+        }
+    }
+
+    return oss.str();
+}
@@ -0,0 +1,114 @@
+﻿#include "rate_detector.h"
+#include "cidr_tree.h"
+#include <algorithm>
+
+using namespace std;
+
+// Перемешивание битов ключа (finalizer из MurmurHash3)
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+RateDetector::RateDetector(uint32_t maxRequests, int64_t windowSeconds, size_t memoryBudget)
+    : maxRequests(maxRequests), window(windowSeconds > 0 ? windowSeconds : 1) {
+    // Наибольшая степень двойки, помещающаяся в бюджет (не меньше группы проб)
+    size_t count = PROBES;
+    while (count * 2 * sizeof(Slot) <= memoryBudget) {
+        count *= 2;
+    }
+    slots.assign(count, Slot());
+    mask = count - 1;
+}
+
+uint64_t RateDetector::packIP(const string& ip) {
+    IPAddress address;
+    if (parseIPAddress(ip, address)) {
+        if (!address.v6) {
+            return (address.hi >> 32) | (1ULL << 32);
+        }
+        return mix64(address.hi ^ mix64(address.lo)) | (1ULL << 63);
+    }
+
+    // Не адрес - FNV-1a строки
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : ip) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    return hash | (1ULL << 62);
+}
+
+bool RateDetector::observe(uint64_t key, int64_t epoch) {
+    size_t home = static_cast<size_t>(mix64(key)) & mask;
+    Slot* slot = nullptr;
+    Slot* victim = nullptr;  // свободный, затем устаревший, затем самый давний
+
+    for (size_t i = 0; i < PROBES; i++) {
+        Slot& candidate = slots[(home + i) & mask];
+        if (candidate.key == key) {
+            slot = &candidate;
+            break;
+        }
+        if (candidate.key == 0) {
+            if (!victim || victim->key != 0) {
+                victim = &candidate;
+            }
+        }
+        else if (!victim || (victim->key != 0 && candidate.windowStart < victim->windowStart)) {
+            victim = &candidate;
+        }
+    }
+
+    if (!slot) {
+        // IP без запросов за 2W секунд уже не попадут ни в одно окно
+        slot = victim;
+        if (slot->key == 0) {
+            used++;
+        }
+        else if (epoch - slot->windowStart < 2 * window) {
+            evicted++;  // вытеснен активный IP - его счётчики потеряны
+        }
+        slot->key = key;
+        slot->windowStart = epoch;
+        slot->previous = 0;
+        slot->current = 0;
+    }
+    else if (epoch >= slot->windowStart + window) {
+        // Переход к следующему интервалу
+        if (epoch < slot->windowStart + 2 * window) {
+            slot->previous = slot->current;
+            slot->windowStart += window;
+        }
+        else {
+            slot->previous = 0;
+            slot->windowStart = epoch;
+        }
+        slot->current = 0;
+    }
+    // Запрос из прошлого (epoch < windowStart) учитывается в текущем интервале:
+    // сумма остаётся верхней оценкой
+
+    slot->current++;
+    return static_cast<uint64_t>(slot->previous) + slot->current > maxRequests;
+}
+
+uint32_t maxRequestsInWindow(vector<int64_t> epochs, int64_t windowSeconds) {
+    if (!is_sorted(epochs.begin(), epochs.end())) {
+        sort(epochs.begin(), epochs.end());
+    }
+
+    // Два указателя: окно [epochs[begin], epochs[begin] + W)
+    uint32_t best = 0;
+    size_t begin = 0;
+    for (size_t end = 0; end < epochs.size(); end++) {
+        while (epochs[end] - epochs[begin] >= windowSeconds) {
+            begin++;
+        }
+        best = max(best, static_cast<uint32_t>(end - begin + 1));
+    }
+    return best;
+}
@@ -0,0 +1,134 @@
+﻿#include "result_cache.h"
+
+using namespace std;
+
+// Служебная память записи: узел списка, ячейка таблицы и ключ
+static size_t entryOverhead(const string& key) {
+    return 8 * sizeof(void*) + sizeof(string) + key.capacity();
+}
+
+ResultCache::ResultCache(size_t budgetBytes) : budget(budgetBytes) {
+}
+
+ResultCache::ResultCache(const ResultCache& other) : budget(other.budgetBytes()) {
+}
+
+ResultCache& ResultCache::operator=(const ResultCache& other) {
+    if (this != &other) {
+        size_t otherBudget = other.budgetBytes();
+        lock_guard<std::mutex> lock(mutex);
+        dropAll();
+        budget = otherBudget;
+        version = 0;
+    }
+    return *this;
+}
+
+// Новая версия данных делает все записи устаревшими
+bool ResultCache::switchVersion(uint64_t dataVersion) {
+    if (dataVersion == version) return true;
+    if (dataVersion < version) return false;  // запрос к уже изменённым данным
+
+    dropAll();
+    version = dataVersion;
+    return true;
+}
+
+void ResultCache::evictTo(size_t limit) {
+    while (used > limit && !entries.empty()) {
+        Entry& last = entries.back();
+        used -= last.bytes;
+        lookup.erase(last.key);
+        entries.pop_back();
+        evictionCount++;
+    }
+}
+
+void ResultCache::dropAll() {
+    entries.clear();
+    lookup.clear();
+    used = 0;
+}
+
+shared_ptr<const void> ResultCache::findEntry(const string& key, type_index type,
+    uint64_t dataVersion) {
+    lock_guard<std::mutex> lock(mutex);
+
+    if (switchVersion(dataVersion)) {
+        auto it = lookup.find(key);
+        if (it != lookup.end() && it->second->type == type) {
+            // Использованная запись становится самой свежей
+            entries.splice(entries.begin(), entries, it->second);
+            hitCount++;
+            return it->second->value;
+        }
+    }
+
+    missCount++;
+    return nullptr;
+}
+
+void ResultCache::storeEntry(const string& key, type_index type,
+    shared_ptr<const void> value, size_t bytes, uint64_t dataVersion) {
+    lock_guard<std::mutex> lock(mutex);
+
+    if (!switchVersion(dataVersion)) return;
+
+    bytes += entryOverhead(key);
+
+    auto it = lookup.find(key);
+    if (it != lookup.end()) {
+        used -= it->second->bytes;
+        entries.erase(it->second);
+        lookup.erase(it);
+    }
+
+    // Результат больше всего бюджета не кэшируется
+    if (bytes > budget) return;
+
+    evictTo(budget - bytes);
+    entries.push_front(Entry{ key, type, move(value), bytes });
+    lookup[key] = entries.begin();
+    used += bytes;
+}
+
+void ResultCache::clear() {
+    lock_guard<std::mutex> lock(mutex);
+    dropAll();
+}
+
+void ResultCache::setBudget(size_t budgetBytes) {
+    lock_guard<std::mutex> lock(mutex);
+    budget = budgetBytes;
+    evictTo(budget);
+}
+
+size_t ResultCache::budgetBytes() const {
+    lock_guard<std::mutex> lock(mutex);
+    return budget;
+}
+
+size_t ResultCache::memoryBytes() const {
+    lock_guard<std::mutex> lock(mutex);
+    return used;
+}
+
+size_t ResultCache::size() const {
+    lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+uint64_t ResultCache::hits() const {
+    lock_guard<std::mutex> lock(mutex);
+    return hitCount;
+}
+
+uint64_t ResultCache::misses() const {
+    lock_guard<std::mutex> lock(mutex);
+    return missCount;
+}
+
+uint64_t ResultCache::evictions() const {
+    lock_guard<std::mutex> lock(mutex);
+    return evictionCount;
+}
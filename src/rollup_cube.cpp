@@ -0,0 +1,289 @@
+﻿#include "rollup_cube.h"
+#include "varint.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+using namespace std;
+
+static const int64_t MINUTE = 60;
+static const int64_t HOUR = 3600;
+static const int64_t DAY = 86400;
+
+// Формат файла: "LRC1", затем число минут и сами минуты
+static const char MAGIC[4] = { 'L', 'R', 'C', '1' };
+
+// Деление с округлением вниз (для времени до 1970 года)
+static int64_t floorTo(int64_t value, int64_t step) {
+    int64_t q = value / step;
+    if (value % step != 0 && value < 0) q--;
+    return q * step;
+}
+
+static int64_t ceilTo(int64_t value, int64_t step) {
+    int64_t floor = floorTo(value, step);
+    return floor == value ? value : floor + step;
+}
+
+// ==================== Counts ====================
+
+uint64_t RollupCube::Counts::total() const {
+    uint64_t sum = 0;
+    for (uint64_t value : cells) sum += value;
+    return sum;
+}
+
+uint64_t RollupCube::Counts::statusClass(int cls) const {
+    uint64_t sum = 0;
+    for (int m = 0; m < METHODS; m++) sum += cells[cls * METHODS + m];
+    return sum;
+}
+
+uint64_t RollupCube::Counts::method(HttpMethod method) const {
+    uint64_t sum = 0;
+    for (int cls = 0; cls < STATUS_CLASSES; cls++) sum += cells[cellOf(cls, method)];
+    return sum;
+}
+
+// ==================== RollupCube ====================
+
+template<typename Counter>
+RollupCube::Bucket<Counter>& RollupCube::bucketAt(vector<Bucket<Counter>>& level, int64_t start) {
+    if (level.empty() || level.back().start < start) {
+        level.emplace_back();
+        level.back().start = start;
+        return level.back();
+    }
+    if (level.back().start == start) {
+        return level.back();
+    }
+
+    auto pos = lower_bound(level.begin(), level.end(), start,
+        [](const Bucket<Counter>& bucket, int64_t value) { return bucket.start < value; });
+    if (pos == level.end() || pos->start != start) {
+        pos = level.emplace(pos);
+        pos->start = start;
+    }
+    return *pos;
+}
+
+template<typename Counter>
+void RollupCube::mergeLevel(vector<Bucket<Counter>>& level, const vector<Bucket<Counter>>& other) {
+    vector<Bucket<Counter>> merged;
+    merged.reserve(level.size() + other.size());
+
+    size_t i = 0;
+    size_t j = 0;
+    while (i < level.size() || j < other.size()) {
+        if (j == other.size() || (i < level.size() && level[i].start < other[j].start)) {
+            merged.push_back(level[i++]);
+        }
+        else if (i == level.size() || other[j].start < level[i].start) {
+            merged.push_back(other[j++]);
+        }
+        else {
+            merged.push_back(level[i++]);
+            for (int c = 0; c < CELLS; c++) {
+                merged.back().cells[c] += other[j].cells[c];
+            }
+            j++;
+        }
+    }
+    level = move(merged);
+}
+
+void RollupCube::build(const TimeIndex& time, const LogColumns& columns) {
+    clear();
+    for (size_t pos = 0; pos < time.size(); pos++) {
+        RowId row = time.rowAt(pos);
+        add(time.epochOf(row), columns.status[row], static_cast<HttpMethod>(columns.method[row]));
+    }
+}
+
+void RollupCube::add(int64_t epoch, int status, HttpMethod method) {
+    int cell = cellOf(BitmapIndex::classOf(status), method);
+    bucketAt(minutes, floorTo(epoch, MINUTE)).cells[cell]++;
+    bucketAt(hours, floorTo(epoch, HOUR)).cells[cell]++;
+    bucketAt(days, floorTo(epoch, DAY)).cells[cell]++;
+    rows++;
+}
+
+void RollupCube::merge(const RollupCube& other) {
+    mergeLevel(minutes, other.minutes);
+    mergeLevel(hours, other.hours);
+    mergeLevel(days, other.days);
+    rows += other.rows;
+}
+
+void RollupCube::sumLevel(Level level, int64_t from, int64_t to, Counts& out) const {
+    auto sum = [from, to, &out](const auto& buckets) {
+        auto pos = lower_bound(buckets.begin(), buckets.end(), from,
+            [](const auto& bucket, int64_t value) { return bucket.start < value; });
+        for (; pos != buckets.end() && pos->start < to; ++pos) {
+            for (int c = 0; c < CELLS; c++) {
+                out.cells[c] += pos->cells[c];
+            }
+        }
+    };
+
+    switch (level) {
+    case Level::Minute: sum(minutes); break;
+    case Level::Hour: sum(hours); break;
+    case Level::Day: sum(days); break;
+    }
+}
+
+// [from, to): середина - целыми интервалами уровня, края - уровнем ниже
+void RollupCube::accumulate(Level level, int64_t from, int64_t to, Counts& out) const {
+    if (from >= to) return;
+    if (level == Level::Minute) {
+        sumLevel(level, from, to, out);
+        return;
+    }
+
+    int64_t step = level == Level::Day ? DAY : HOUR;
+    Level lower = level == Level::Day ? Level::Hour : Level::Minute;
+    int64_t lo = ceilTo(from, step);
+    int64_t hi = floorTo(to, step);
+
+    if (lo >= hi) {
+        accumulate(lower, from, to, out);
+        return;
+    }
+
+    accumulate(lower, from, lo, out);
+    sumLevel(level, lo, hi, out);
+    accumulate(lower, hi, to, out);
+}
+
+RollupCube::Counts RollupCube::query(int64_t from, int64_t to) const {
+    Counts counts;
+    if (from > to || rows == 0) {
+        return counts;
+    }
+
+    // Границы - по минутам, которые реально есть в кубе
+    from = floorTo(max(from, minutes.front().start), MINUTE);
+    int64_t end = floorTo(min(to, minutes.back().start), MINUTE) + MINUTE;
+    accumulate(Level::Day, from, end, counts);
+    return counts;
+}
+
+vector<pair<int64_t, RollupCube::Counts>> RollupCube::series(int64_t from, int64_t to,
+    Level level) const {
+    vector<pair<int64_t, Counts>> result;
+
+    auto collect = [from, to, &result](const auto& buckets, int64_t step) {
+        if (buckets.empty()) return;
+        int64_t first = floorTo(max(from, buckets.front().start), step);
+        auto pos = lower_bound(buckets.begin(), buckets.end(), first,
+            [](const auto& bucket, int64_t value) { return bucket.start < value; });
+        for (; pos != buckets.end() && pos->start <= to; ++pos) {
+            Counts counts;
+            copy(begin(pos->cells), end(pos->cells), counts.cells);
+            result.emplace_back(pos->start, counts);
+        }
+    };
+
+    switch (level) {
+    case Level::Minute: collect(minutes, MINUTE); break;
+    case Level::Hour: collect(hours, HOUR); break;
+    case Level::Day: collect(days, DAY); break;
+    }
+    return result;
+}
+
+// ==================== Сериализация ====================
+
+string RollupCube::serialize() const {
+    string out(MAGIC, sizeof(MAGIC));
+    appendVarint(out, minutes.size());
+
+    int64_t previous = 0;
+    for (const auto& bucket : minutes) {
+        int64_t minute = bucket.start / MINUTE;
+        appendVarint(out, zigzag(minute - previous));
+        previous = minute;
+
+        uint64_t mask = 0;
+        for (int c = 0; c < CELLS; c++) {
+            if (bucket.cells[c]) mask |= 1ULL << c;
+        }
+        appendVarint(out, mask);
+        for (int c = 0; c < CELLS; c++) {
+            if (bucket.cells[c]) appendVarint(out, bucket.cells[c]);
+        }
+    }
+    return out;
+}
+
+bool RollupCube::deserialize(string_view data) {
+    clear();
+    if (data.size() < sizeof(MAGIC) || data.substr(0, sizeof(MAGIC)) != string_view(MAGIC, sizeof(MAGIC))) {
+        return false;
+    }
+
+    size_t pos = sizeof(MAGIC);
+    uint64_t count;
+    if (!readVarint(data, pos, count)) return false;
+
+    int64_t minute = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t delta, mask;
+        if (!readVarint(data, pos, delta) || !readVarint(data, pos, mask)) {
+            clear();
+            return false;
+        }
+        minute += unzigzag(delta);
+        int64_t start = minute * MINUTE;
+
+        for (int c = 0; c < CELLS; c++) {
+            if (!(mask & (1ULL << c))) continue;
+            uint64_t value;
+            if (!readVarint(data, pos, value) || value > UINT32_MAX) {
+                clear();
+                return false;
+            }
+            bucketAt(minutes, start).cells[c] += static_cast<uint32_t>(value);
+            bucketAt(hours, floorTo(start, HOUR)).cells[c] += value;
+            bucketAt(days, floorTo(start, DAY)).cells[c] += value;
+            rows += value;
+        }
+    }
+    if (pos != data.size()) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool RollupCube::saveToFile(const string& filename) const {
+    ofstream file(filename, ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    string data = serialize();
+    file.write(data.data(), static_cast<streamsize>(data.size()));
+    return static_cast<bool>(file);
+}
+
+bool RollupCube::loadFromFile(const string& filename) {
+    ifstream file(filename, ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    return deserialize(data);
+}
+
+size_t RollupCube::memoryBytes() const {
+    return minutes.capacity() * sizeof(Bucket<uint32_t>) +
+        (hours.capacity() + days.capacity()) * sizeof(Bucket<uint64_t>);
+}
+
+void RollupCube::clear() {
+    minutes.clear();
+    hours.clear();
+    days.clear();
+    rows = 0;
+}
@@ -0,0 +1,156 @@
+﻿#include "sampler.h"
+#include <cmath>
+
+using namespace std;
+
+// Квантиль z: P(|Z| < z) = confidence (деление пополам по erf)
+static double normalQuantile(double confidence) {
+    double low = 0.0;
+    double high = 10.0;
+    for (int i = 0; i < 100; i++) {
+        double mid = (low + high) / 2.0;
+        if (erf(mid / sqrt(2.0)) < confidence) {
+            low = mid;
+        }
+        else {
+            high = mid;
+        }
+    }
+    return (low + high) / 2.0;
+}
+
+LogSampler::LogSampler(size_t capacityRows, bool stratify, double confidenceLevel, uint64_t randomSeed)
+    : capacity(capacityRows > 0 ? capacityRows : 1), stratified(stratify),
+    confidence(confidenceLevel > 0.0 && confidenceLevel < 1.0 ? confidenceLevel : 0.95),
+    seed(randomSeed), rng(randomSeed) {
+    z = normalQuantile(confidence);
+}
+
+// Равномерное число из (0, 1)
+double LogSampler::randomUnit() {
+    return (static_cast<double>(rng() >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+// Алгоритм L: пропуск до следующей записи, заменяющей элемент резервуара
+void LogSampler::scheduleNext(Reservoir& reservoir) {
+    reservoir.w *= exp(log(randomUnit()) / static_cast<double>(capacity));
+    double skip = floor(log(randomUnit()) / log1p(-reservoir.w));
+    reservoir.nextPick = reservoir.seen +
+        (skip < 1e18 ? static_cast<uint64_t>(skip) : static_cast<uint64_t>(1e18));
+}
+
+void LogSampler::offer(Reservoir& reservoir, RowId row) {
+    if (reservoir.rows.size() < capacity) {
+        reservoir.rows.push_back(row);
+        reservoir.seen++;
+        if (reservoir.rows.size() == capacity) {
+            scheduleNext(reservoir);
+        }
+        return;
+    }
+
+    if (reservoir.seen == reservoir.nextPick) {
+        reservoir.rows[rng() % capacity] = row;
+        reservoir.seen++;
+        scheduleNext(reservoir);
+        return;
+    }
+
+    reservoir.seen++;
+}
+
+void LogSampler::clear() {
+    rng.seed(seed);
+    uniform = Reservoir();
+    for (auto& stratum : strata) {
+        stratum = Reservoir();
+    }
+}
+
+void LogSampler::build(const vector<LogEntry>& logs) {
+    clear();
+
+    uint64_t total = logs.size();
+    size_t fill = total < capacity ? static_cast<size_t>(total) : capacity;
+    for (size_t row = 0; row < fill; row++) {
+        offer(uniform, static_cast<RowId>(row));
+    }
+
+    // Дальше - только записи, выбранные алгоритмом L
+    while (uniform.nextPick < total && uniform.rows.size() == capacity) {
+        uniform.seen = uniform.nextPick;
+        offer(uniform, static_cast<RowId>(uniform.nextPick));
+    }
+    uniform.seen = total;
+
+    // Страты требуют класса каждой записи - один проход по статусам
+    if (stratified) {
+        for (size_t row = 0; row < logs.size(); row++) {
+            offer(strata[BitmapIndex::classOf(logs[row].status)], static_cast<RowId>(row));
+        }
+    }
+}
+
+void LogSampler::add(RowId row, int status) {
+    offer(uniform, row);
+    if (stratified) {
+        offer(strata[BitmapIndex::classOf(status)], row);
+    }
+}
+
+size_t LogSampler::memoryBytes() const {
+    size_t bytes = sizeof(*this) + uniform.rows.capacity() * sizeof(RowId);
+    for (const auto& stratum : strata) {
+        bytes += stratum.rows.capacity() * sizeof(RowId);
+    }
+    return bytes;
+}
+
+vector<const LogSampler::Reservoir*> LogSampler::estimationStrata() const {
+    vector<const Reservoir*> parts;
+    if (!stratified) {
+        parts.push_back(&uniform);
+        return parts;
+    }
+    for (const auto& stratum : strata) {
+        if (stratum.seen > 0) parts.push_back(&stratum);
+    }
+    return parts;
+}
+
+// Сумма N_h * m_h / n_h по стратам; дисперсия доли - по Агрести-Коуллу
+// (m + z^2/2) / (n + z^2), чтобы нулевое число попаданий давало
+// ненулевую ширину интервала
+Estimate LogSampler::combine(const vector<const Reservoir*>& parts,
+    const vector<uint64_t>& hits) const {
+    Estimate estimate;
+    estimate.exact = true;
+
+    double variance = 0.0;
+    double sampledHits = 0.0;
+    double total = 0.0;
+    double z2 = z * z;
+
+    for (size_t h = 0; h < parts.size(); h++) {
+        double n = static_cast<double>(parts[h]->rows.size());
+        double population = static_cast<double>(parts[h]->seen);
+        double m = static_cast<double>(hits[h]);
+        total += population;
+        sampledHits += m;
+        if (n == 0.0) continue;
+
+        estimate.value += population * m / n;
+
+        if (n < population) {
+            estimate.exact = false;
+            double p = (m + z2 / 2.0) / (n + z2);
+            double finite = (population - n) / (population - 1.0);
+            variance += population * population * finite * p * (1.0 - p) / (n + z2);
+        }
+    }
+
+    double margin = z * sqrt(variance);
+    estimate.low = estimate.value - margin > sampledHits ? estimate.value - margin : sampledHits;
+    estimate.high = estimate.value + margin < total ? estimate.value + margin : total;
+    return estimate;
+}
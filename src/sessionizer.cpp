@@ -0,0 +1,222 @@
+﻿#include "sessionizer.h"
+#include "rate_detector.h"
+#include <algorithm>
+
+using namespace std;
+
+// Перемешивание битов ключа перед выбором ячейки
+static size_t slotHash(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return static_cast<size_t>(key);
+}
+
+// Деление с округлением вниз
+static int64_t floorDiv(int64_t value, int64_t step) {
+    int64_t q = value / step;
+    return (value % step != 0 && value < 0) ? q - 1 : q;
+}
+
+Sessionizer::Sessionizer(int64_t gapSeconds, Sink sessionSink)
+    : gap(gapSeconds > 0 ? gapSeconds : 0), sink(move(sessionSink)) {
+    // Колесо охватывает не меньше двух пауз: перенесённая сессия
+    // попадает в ячейку, которая ещё не пройдена в этом обороте
+    tick = (2 * gap + WHEEL_SLOTS - 1) / WHEEL_SLOTS;
+    if (tick < 1) tick = 1;
+    wheel.assign(static_cast<size_t>(WHEEL_SLOTS), static_cast<uint32_t>(NONE));
+    index.assign(64, 0);
+    mask = index.size() - 1;
+}
+
+// ==================== Индекс открытых сессий ====================
+
+size_t Sessionizer::findSlot(uint64_t key) const {
+    size_t pos = slotHash(key) & mask;
+    while (index[pos] != 0 && sessions[index[pos] - 1].key != key) {
+        pos = (pos + 1) & mask;
+    }
+    return pos;
+}
+
+void Sessionizer::insertIndex(uint64_t key, uint32_t id) {
+    // Заполнение не больше половины
+    if ((openCount + 1) * 2 > index.size()) {
+        index.assign(index.size() * 2, 0);
+        mask = index.size() - 1;
+        for (uint32_t i = 0; i < sessions.size(); i++) {
+            if (sessions[i].open) {
+                index[findSlot(sessions[i].key)] = i + 1;
+            }
+        }
+    }
+    index[findSlot(key)] = id + 1;
+}
+
+// Удаление со сдвигом следующих элементов цепочки назад (без пометок)
+void Sessionizer::eraseIndex(uint64_t key) {
+    size_t hole = findSlot(key);
+    if (index[hole] == 0) return;
+    index[hole] = 0;
+
+    size_t pos = (hole + 1) & mask;
+    while (index[pos] != 0) {
+        size_t home = slotHash(sessions[index[pos] - 1].key) & mask;
+        // Элемент можно перенести в дыру, если его место не между дырой и ним
+        bool movable = hole <= pos ? (home <= hole || home > pos) : (home <= hole && home > pos);
+        if (movable) {
+            index[hole] = index[pos];
+            index[pos] = 0;
+            hole = pos;
+        }
+        pos = (pos + 1) & mask;
+    }
+}
+
+// ==================== Колесо таймеров ====================
+
+void Sessionizer::schedule(uint32_t id) {
+    int64_t expireTick = floorDiv(sessions[id].session.end + gap, tick);
+    size_t slot = static_cast<size_t>(((expireTick % WHEEL_SLOTS) + WHEEL_SLOTS) % WHEEL_SLOTS);
+    sessions[id].next = wheel[slot];
+    wheel[slot] = id;
+}
+
+void Sessionizer::close(uint32_t id) {
+    OpenSession& open = sessions[id];
+    sink(open.session);
+
+    eraseIndex(open.key);
+    open.open = false;
+    open.session = Session();
+    freeList.push_back(id);
+    openCount--;
+}
+
+// Проход по ячейкам, время которых целиком прошло к моменту epoch
+void Sessionizer::advance(int64_t epoch) {
+    if (!started) {
+        started = true;
+        now = epoch;
+        currentTick = floorDiv(epoch, tick);
+        return;
+    }
+    if (epoch <= now) return;
+    now = epoch;
+
+    int64_t nowTick = floorDiv(epoch, tick);
+    int64_t steps = nowTick - currentTick;
+    if (steps > WHEEL_SLOTS) steps = WHEEL_SLOTS;
+
+    for (int64_t t = currentTick; t < currentTick + steps; t++) {
+        size_t slot = static_cast<size_t>(((t % WHEEL_SLOTS) + WHEEL_SLOTS) % WHEEL_SLOTS);
+        uint32_t id = wheel[slot];
+        wheel[slot] = NONE;
+
+        while (id != NONE) {
+            uint32_t next = sessions[id].next;
+            if (now - sessions[id].session.end > gap) {
+                close(id);
+            }
+            else {
+                schedule(id);  // сессию продлили после постановки в колесо
+            }
+            id = next;
+        }
+    }
+    currentTick = nowTick;
+}
+
+// ==================== Sessionizer ====================
+
+void Sessionizer::add(const string& ip, int64_t epoch, int status) {
+    advance(epoch);
+    if (epoch < now) epoch = now;
+
+    uint64_t key = RateDetector::packIP(ip);
+    size_t slot = findSlot(key);
+
+    if (index[slot] != 0) {
+        OpenSession& open = sessions[index[slot] - 1];
+        // Колесо ещё не дошло до ячейки, но пауза уже превышена
+        if (epoch - open.session.end > gap) {
+            sink(open.session);
+            open.session.start = epoch;
+            open.session.requests = 0;
+            open.session.errors = 0;
+        }
+        open.session.end = epoch;
+        open.session.requests++;
+        if (status >= 400) open.session.errors++;
+        return;
+    }
+
+    uint32_t id;
+    if (!freeList.empty()) {
+        id = freeList.back();
+        freeList.pop_back();
+    }
+    else {
+        id = static_cast<uint32_t>(sessions.size());
+        sessions.emplace_back();
+    }
+
+    OpenSession& open = sessions[id];
+    open.key = key;
+    open.open = true;
+    open.session.ip = ip;
+    open.session.start = epoch;
+    open.session.end = epoch;
+    open.session.requests = 1;
+    open.session.errors = status >= 400 ? 1 : 0;
+
+    insertIndex(key, id);
+    openCount++;
+    if (openCount > peakOpen) peakOpen = openCount;
+    schedule(id);
+}
+
+void Sessionizer::finish() {
+    // Оставшиеся сессии - по времени начала
+    vector<uint32_t> remaining;
+    for (uint32_t id = 0; id < sessions.size(); id++) {
+        if (sessions[id].open) remaining.push_back(id);
+    }
+    sort(remaining.begin(), remaining.end(), [this](uint32_t a, uint32_t b) {
+        return sessions[a].session.start < sessions[b].session.start;
+    });
+    for (uint32_t id : remaining) {
+        sink(sessions[id].session);
+    }
+
+    sessions.clear();
+    freeList.clear();
+    index.assign(64, 0);
+    mask = index.size() - 1;
+    wheel.assign(static_cast<size_t>(WHEEL_SLOTS), static_cast<uint32_t>(NONE));
+    openCount = 0;
+    started = false;
+}
+
+// ==================== SessionStats ====================
+
+void SessionStats::add(const Session& session) {
+    sessions++;
+    requests += session.requests;
+    totalDuration += session.duration();
+    if (session.duration() > maxDuration) maxDuration = session.duration();
+    if (session.requests > maxRequests) maxRequests = session.requests;
+    sessionsPerIP[session.ip]++;
+}
+
+vector<pair<string, int>> SessionStats::topIPs(size_t n) const {
+    vector<pair<string, int>> sorted(sessionsPerIP.begin(), sessionsPerIP.end());
+    size_t count = n < sorted.size() ? n : sorted.size();
+    partial_sort(sorted.begin(), sorted.begin() + count, sorted.end(),
+        [](const pair<string, int>& a, const pair<string, int>& b) {
+            if (a.second != b.second) return a.second > b.second;
+            return a.first < b.first;
+        });
+    sorted.resize(count);
+    return sorted;
+}
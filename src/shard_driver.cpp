@@ -0,0 +1,240 @@
+﻿#include "shard_driver.h"
+#include "analyzer.h"
+#include "log_loader.h"
+#include "windows_utils.h"
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <cstdio>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+using namespace std;
+
+namespace ShardDriver {
+
+    // Запущенный обработчик: процесс и конец канала для чтения
+    struct Worker {
+        PROCESS_INFORMATION process = {};
+        HANDLE output = nullptr;
+        string data;
+    };
+
+    // Распределение файлов: по убыванию размера, каждый - наименее загруженному
+    static vector<vector<string>> splitFiles(const vector<string>& files, size_t shards) {
+        vector<long long> sizes(files.size());
+        vector<size_t> order(files.size());
+        iota(order.begin(), order.end(), 0);
+        for (size_t i = 0; i < files.size(); i++) {
+            sizes[i] = WindowsUtils::getFileSize(files[i]);
+        }
+        stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) {
+            return sizes[a] > sizes[b];
+        });
+
+        vector<vector<string>> parts(shards);
+        vector<long long> load(shards, 0);
+        for (size_t i : order) {
+            size_t lightest = static_cast<size_t>(min_element(load.begin(), load.end()) - load.begin());
+            parts[lightest].push_back(files[i]);
+            load[lightest] += sizes[i] > 0 ? sizes[i] : 1;
+        }
+        return parts;
+    }
+
+    // Запуск копии программы: список файлов - в канал stdin, stdout - в
+    // другой анонимный канал
+    static bool startWorker(const string& program, const vector<string>& files, size_t sketchSize,
+        Worker& worker) {
+        string commandLine = "\"" + program + "\" " + WORKER_FLAG + " " + to_string(sketchSize);
+        string fileList;
+        for (const auto& file : files) {
+            fileList += file + "\n";
+        }
+
+        SECURITY_ATTRIBUTES security = {};
+        security.nLength = sizeof(security);
+        security.bInheritHandle = TRUE;
+
+        HANDLE readEnd = nullptr;
+        HANDLE writeEnd = nullptr;
+        if (!CreatePipe(&readEnd, &writeEnd, &security, 0)) {
+            return false;
+        }
+        HANDLE inputRead = nullptr;
+        HANDLE inputWrite = nullptr;
+        if (!CreatePipe(&inputRead, &inputWrite, &security, 0)) {
+            CloseHandle(readEnd);
+            CloseHandle(writeEnd);
+            return false;
+        }
+        // Обработчик наследует только свои концы каналов
+        SetHandleInformation(readEnd, HANDLE_FLAG_INHERIT, 0);
+        SetHandleInformation(inputWrite, HANDLE_FLAG_INHERIT, 0);
+
+        STARTUPINFOA startup = {};
+        startup.cb = sizeof(startup);
+        startup.dwFlags = STARTF_USESTDHANDLES;
+        startup.hStdInput = inputRead;
+        startup.hStdOutput = writeEnd;
+        startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+        vector<char> mutableLine(commandLine.begin(), commandLine.end());
+        mutableLine.push_back('\0');
+        BOOL started = CreateProcessA(program.c_str(), mutableLine.data(), nullptr, nullptr,
+            TRUE, 0, nullptr, nullptr, &startup, &worker.process);
+
+        // Иначе следующий обработчик унаследует эти концы, и чтение
+        // не дождётся конца данных
+        CloseHandle(writeEnd);
+        CloseHandle(inputRead);
+        if (!started) {
+            CloseHandle(inputWrite);
+            CloseHandle(readEnd);
+            return false;
+        }
+
+        // Обработчик читает весь список до записи в stdout, поэтому
+        // запись не блокируется надолго; закрытие канала - конец списка
+        size_t written = 0;
+        while (written < fileList.size()) {
+            size_t left = fileList.size() - written;
+            DWORD chunk = 0;
+            if (!WriteFile(inputWrite, fileList.data() + written,
+                static_cast<DWORD>(left < 65536 ? left : 65536), &chunk, nullptr)) {
+                break;
+            }
+            written += chunk;
+        }
+        CloseHandle(inputWrite);
+        worker.output = readEnd;
+        return true;
+    }
+
+    static void readAll(Worker& worker) {
+        char buffer[65536];
+        DWORD bytesRead = 0;
+        while (ReadFile(worker.output, buffer, sizeof(buffer), &bytesRead, nullptr) && bytesRead > 0) {
+            worker.data.append(buffer, bytesRead);
+        }
+        CloseHandle(worker.output);
+    }
+
+    ShardedRun analyzeSharded(const vector<string>& files, unsigned processes, size_t sketchSize) {
+        ShardedRun run;
+        run.total = PartialAggregate(sketchSize);
+        if (files.empty()) {
+            return run;
+        }
+
+        unsigned shards = processes ? processes : thread::hardware_concurrency();
+        if (shards == 0) shards = 1;
+        if (shards > files.size()) shards = static_cast<unsigned>(files.size());
+
+        char program[MAX_PATH];
+        DWORD length = GetModuleFileNameA(nullptr, program, MAX_PATH);
+        if (length == 0 || length == MAX_PATH) {
+            run.errors.push_back("не удалось определить путь к программе");
+            return run;
+        }
+
+        vector<vector<string>> parts = splitFiles(files, shards);
+        vector<Worker> workers(parts.size());
+        vector<char> started(parts.size(), 0);
+        for (size_t i = 0; i < parts.size(); i++) {
+            if (parts[i].empty()) continue;
+            started[i] = startWorker(program, parts[i], sketchSize, workers[i]);
+            if (started[i]) {
+                run.processes++;
+            }
+            else {
+                run.errors.push_back("обработчик " + to_string(i + 1) + ": не запущен (код " +
+                    to_string(GetLastError()) + ")");
+            }
+        }
+
+        // Каналы читаются одновременно: иначе обработчик с заполненным
+        // буфером канала ждал бы, пока координатор читает другие
+        vector<thread> readers;
+        for (size_t i = 0; i < workers.size(); i++) {
+            if (started[i]) {
+                readers.emplace_back(readAll, ref(workers[i]));
+            }
+        }
+        for (auto& reader : readers) {
+            reader.join();
+        }
+
+        for (size_t i = 0; i < workers.size(); i++) {
+            if (!started[i]) continue;
+            Worker& worker = workers[i];
+            WaitForSingleObject(worker.process.hProcess, INFINITE);
+            DWORD exitCode = 1;
+            GetExitCodeProcess(worker.process.hProcess, &exitCode);
+            CloseHandle(worker.process.hProcess);
+            CloseHandle(worker.process.hThread);
+
+            string name = "обработчик " + to_string(i + 1);
+            PartialAggregate partial(sketchSize);
+            if (exitCode == 1 || !partial.deserialize(worker.data)) {
+                run.errors.push_back(name + ": нет корректного результата (код " +
+                    to_string(exitCode) + ")");
+                continue;
+            }
+            if (exitCode != 0) {
+                run.errors.push_back(name + ": часть файлов не прочитана");
+            }
+            run.total.merge(partial);
+        }
+        return run;
+    }
+
+    int runWorker(const vector<string>& arguments) {
+        if (arguments.empty()) {
+            cerr << "Использование: " << WORKER_FLAG << " <размер сводки> [<файл>...]\n";
+            return 1;
+        }
+
+        size_t sketchSize = 0;
+        try {
+            sketchSize = static_cast<size_t>(stoul(arguments[0]));
+        }
+        catch (const exception&) {
+            cerr << "Некорректный размер сводки: " << arguments[0] << "\n";
+            return 1;
+        }
+
+        vector<string> files(arguments.begin() + 1, arguments.end());
+        if (files.empty()) {
+            string line;
+            while (getline(cin, line)) {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (!line.empty()) files.push_back(line);
+            }
+        }
+        if (files.empty()) {
+            cerr << "Нет файлов для обработки\n";
+            return 1;
+        }
+
+        MultiFileLoad load = LogLoader::loadFiles(files);
+        for (const auto& error : load.errors) {
+            cerr << error << "\n";
+        }
+        if (load.files == 0) {
+            return 1;
+        }
+
+        LogAnalyzer analyzer(move(load.logs));
+        string data = analyzer.getPartialAggregate(sketchSize).serialize();
+
+        // stdout в текстовом режиме заменил бы \n на \r\n
+        _setmode(_fileno(stdout), _O_BINARY);
+        if (fwrite(data.data(), 1, data.size(), stdout) != data.size() || fflush(stdout) != 0) {
+            return 1;
+        }
+        return load.errors.empty() ? 0 : 2;
+    }
+}
@@ -0,0 +1,342 @@
+﻿#include "snapshot_file.h"
+#include "time_utils.h"
+#include "log_index.h"
+#include <fstream>
+#include <cstring>
+#include <unordered_map>
+
+using namespace std;
+
+static const char MAGIC[4] = { 'L', 'S', 'N', 'P' };
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t rows;
+    uint32_t sections;
+    uint32_t reserved;
+    uint64_t tableChecksum;     // контрольная сумма таблицы разделов
+};
+
+struct SectionEntry {
+    uint32_t kind;              // SnapshotSection
+    uint32_t reserved;
+    uint64_t offset;            // от начала файла, кратно 8
+    uint64_t size;
+    uint64_t checksum;
+};
+
+// Контрольная сумма по 8 байт за шаг (FNV-1a над словами и перемешивание)
+static uint64_t checksum(const char* data, size_t size) {
+    uint64_t h = 14695981039346656037ULL ^ size;
+    size_t pos = 0;
+    for (; pos + 8 <= size; pos += 8) {
+        uint64_t word;
+        memcpy(&word, data + pos, 8);
+        h = (h ^ word) * 1099511628211ULL;
+        h ^= h >> 29;
+    }
+    for (; pos < size; pos++) {
+        h = (h ^ static_cast<unsigned char>(data[pos])) * 1099511628211ULL;
+    }
+    h ^= h >> 32;
+    h *= 0xd6e8feb86659fd93ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+// ==================== Запись ====================
+
+// Словарь значений колонки в порядке первого появления
+class DictionaryBuilder {
+private:
+    unordered_map<string_view, uint32_t, WindowsStringHash> ids;
+    vector<string_view> values;
+
+public:
+    uint32_t idOf(string_view value) {
+        auto inserted = ids.try_emplace(value, static_cast<uint32_t>(values.size()));
+        if (inserted.second) {
+            values.push_back(value);
+        }
+        return inserted.first->second;
+    }
+
+    // Число строк, смещения и байты строк
+    string encode() const {
+        size_t bytes = 0;
+        for (string_view value : values) bytes += value.size();
+
+        vector<uint64_t> offsets;
+        offsets.reserve(values.size() + 2);
+        offsets.push_back(values.size());
+        uint64_t offset = 0;
+        for (string_view value : values) {
+            offsets.push_back(offset);
+            offset += value.size();
+        }
+        offsets.push_back(offset);
+
+        string out(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        out.reserve(out.size() + bytes);
+        for (string_view value : values) {
+            out.append(value.data(), value.size());
+        }
+        return out;
+    }
+};
+
+static void writeSection(ofstream& out, vector<SectionEntry>& table, SnapshotSection kind,
+    const void* data, size_t size) {
+    SectionEntry entry = {};
+    entry.kind = static_cast<uint32_t>(kind);
+    entry.offset = static_cast<uint64_t>(out.tellp());
+    entry.size = size;
+    entry.checksum = checksum(static_cast<const char*>(data), size);
+    table.push_back(entry);
+
+    out.write(static_cast<const char*>(data), static_cast<streamsize>(size));
+    static const char padding[8] = {};
+    out.write(padding, static_cast<streamsize>((8 - size % 8) % 8));
+}
+
+template<typename T>
+static void writeColumn(ofstream& out, vector<SectionEntry>& table, SnapshotSection kind,
+    const vector<T>& column) {
+    writeSection(out, table, kind, column.data(), column.size() * sizeof(T));
+}
+
+static void writeDictionary(ofstream& out, vector<SectionEntry>& table, SnapshotSection kind,
+    const DictionaryBuilder& dictionary) {
+    string data = dictionary.encode();
+    writeSection(out, table, kind, data.data(), data.size());
+}
+
+bool SnapshotFile::save(const string& filename, const vector<LogEntry>& logs,
+    const RollupCube* rollupCube) {
+    ofstream out(filename, ios::binary | ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    // Место под заголовок и таблицу (не больше 12 разделов)
+    const size_t MAX_SECTIONS = 12;
+    size_t tableBytes = MAX_SECTIONS * sizeof(SectionEntry);
+    vector<char> placeholder(sizeof(SnapshotHeader) + tableBytes, 0);
+    out.write(placeholder.data(), static_cast<streamsize>(placeholder.size()));
+
+    vector<SectionEntry> table;
+    size_t n = logs.size();
+
+    // Время и проверка, что строки восстанавливаются из чисел
+    vector<int64_t> epochs(n);
+    bool canonicalTime = true;
+    for (size_t i = 0; i < n; i++) {
+        epochs[i] = TimeUtils::toEpochSeconds(logs[i].timestamp);
+        if (canonicalTime && TimeUtils::fromEpochSeconds(epochs[i]) != logs[i].timestamp) {
+            canonicalTime = false;
+        }
+    }
+    writeColumn(out, table, SnapshotSection::Epochs, epochs);
+    vector<int64_t>().swap(epochs);
+
+    vector<uint16_t> statuses(n);
+    vector<uint8_t> methodCodes(n);
+    for (size_t i = 0; i < n; i++) {
+        statuses[i] = static_cast<uint16_t>(logs[i].status);
+        methodCodes[i] = static_cast<uint8_t>(methodCode(logs[i].method));
+    }
+    writeColumn(out, table, SnapshotSection::Statuses, statuses);
+    writeColumn(out, table, SnapshotSection::MethodCodes, methodCodes);
+
+    // Строковые колонки: номера в словарях
+    auto encodeColumn = [&](string LogEntry::* column, SnapshotSection idsKind,
+        SnapshotSection dictionaryKind) {
+        DictionaryBuilder dictionary;
+        vector<uint32_t> ids(n);
+        for (size_t i = 0; i < n; i++) {
+            ids[i] = dictionary.idOf(logs[i].*column);
+        }
+        writeColumn(out, table, idsKind, ids);
+        writeDictionary(out, table, dictionaryKind, dictionary);
+    };
+    encodeColumn(&LogEntry::ip, SnapshotSection::IPIds, SnapshotSection::IPDictionary);
+    encodeColumn(&LogEntry::url, SnapshotSection::URLIds, SnapshotSection::URLDictionary);
+    encodeColumn(&LogEntry::method, SnapshotSection::MethodIds, SnapshotSection::MethodDictionary);
+    if (!canonicalTime) {
+        encodeColumn(&LogEntry::timestamp, SnapshotSection::TimestampIds,
+            SnapshotSection::TimestampDictionary);
+    }
+
+    if (rollupCube && !rollupCube->empty()) {
+        string data = rollupCube->serialize();
+        writeSection(out, table, SnapshotSection::Rollup, data.data(), data.size());
+    }
+
+    // Заголовок и таблица - в начало файла
+    SnapshotHeader header = {};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.rows = n;
+    header.sections = static_cast<uint32_t>(table.size());
+    header.tableChecksum = checksum(reinterpret_cast<const char*>(table.data()),
+        table.size() * sizeof(SectionEntry));
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(table.data()),
+        static_cast<streamsize>(table.size() * sizeof(SectionEntry)));
+    return static_cast<bool>(out);
+}
+
+// ==================== Чтение ====================
+
+// Разбор словаря раздела; смещения должны расти и не выходить за раздел
+static bool openDictionary(const char* data, uint64_t size, SnapshotDictionary& dictionary) {
+    uint64_t words = size / sizeof(uint64_t);
+    if (words < 2) return false;
+    uint64_t count = reinterpret_cast<const uint64_t*>(data)[0];
+    if (count > words - 2) return false;
+
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(data) + 1;
+    uint64_t tableBytes = (count + 2) * sizeof(uint64_t);
+    uint64_t bytes = size - tableBytes;
+    if (offsets[0] != 0 || offsets[count] > bytes) return false;
+    for (uint64_t i = 0; i < count; i++) {
+        if (offsets[i] > offsets[i + 1]) return false;
+    }
+
+    dictionary = SnapshotDictionary(offsets, data + tableBytes, static_cast<size_t>(count));
+    return true;
+}
+
+static bool idsInRange(const uint32_t* ids, size_t rows, size_t limit) {
+    for (size_t i = 0; i < rows; i++) {
+        if (ids[i] >= limit) return false;
+    }
+    return true;
+}
+
+bool SnapshotFile::open(const string& filename, bool verify) {
+    close();
+    if (!file.open(filename) || file.size() < sizeof(SnapshotHeader)) {
+        close();
+        return false;
+    }
+
+    const char* base = file.data();
+    uint64_t fileSize = file.size();
+    SnapshotHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.sections > (fileSize - sizeof(header)) / sizeof(SectionEntry)) {
+        close();
+        return false;
+    }
+
+    const SectionEntry* table = reinterpret_cast<const SectionEntry*>(base + sizeof(header));
+    if (checksum(reinterpret_cast<const char*>(table), header.sections * sizeof(SectionEntry)) !=
+        header.tableChecksum) {
+        close();
+        return false;
+    }
+    rows = static_cast<size_t>(header.rows);
+
+    // Раздел нужного размера (expected = 0 - любой длины)
+    auto section = [&](SnapshotSection kind, uint64_t expected, uint64_t& size) -> const char* {
+        for (uint32_t i = 0; i < header.sections; i++) {
+            const SectionEntry& entry = table[i];
+            if (entry.kind != static_cast<uint32_t>(kind)) continue;
+            if (entry.offset % 8 != 0 || entry.offset > fileSize || entry.size > fileSize - entry.offset ||
+                (expected && entry.size != expected)) {
+                return nullptr;
+            }
+            if (verify && checksum(base + entry.offset, static_cast<size_t>(entry.size)) != entry.checksum) {
+                return nullptr;
+            }
+            size = entry.size;
+            return base + entry.offset;
+        }
+        return nullptr;
+    };
+
+    uint64_t size = 0;
+    uint64_t n = header.rows;
+    const char* epochData = section(SnapshotSection::Epochs, n * sizeof(int64_t), size);
+    const char* statusData = section(SnapshotSection::Statuses, n * sizeof(uint16_t), size);
+    const char* methodCodeData = section(SnapshotSection::MethodCodes, n, size);
+    const char* ipData = section(SnapshotSection::IPIds, n * sizeof(uint32_t), size);
+    const char* urlData = section(SnapshotSection::URLIds, n * sizeof(uint32_t), size);
+    const char* methodData = section(SnapshotSection::MethodIds, n * sizeof(uint32_t), size);
+    const char* timestampData = section(SnapshotSection::TimestampIds, n * sizeof(uint32_t), size);
+
+    auto dictionary = [&](SnapshotSection kind, SnapshotDictionary& out) {
+        uint64_t bytes = 0;
+        const char* data = section(kind, 0, bytes);
+        return data && openDictionary(data, bytes, out);
+    };
+
+    bool ok = epochData && statusData && methodCodeData && ipData && urlData && methodData &&
+        dictionary(SnapshotSection::IPDictionary, ips) &&
+        dictionary(SnapshotSection::URLDictionary, urls) &&
+        dictionary(SnapshotSection::MethodDictionary, methods) &&
+        (!timestampData || dictionary(SnapshotSection::TimestampDictionary, timestamps));
+    if (!ok) {
+        close();
+        return false;
+    }
+
+    epochs = reinterpret_cast<const int64_t*>(epochData);
+    statuses = reinterpret_cast<const uint16_t*>(statusData);
+    methodCodes = reinterpret_cast<const uint8_t*>(methodCodeData);
+    ipIds = reinterpret_cast<const uint32_t*>(ipData);
+    urlIds = reinterpret_cast<const uint32_t*>(urlData);
+    methodIds = reinterpret_cast<const uint32_t*>(methodData);
+    timestampIds = reinterpret_cast<const uint32_t*>(timestampData);
+
+    if (const char* data = section(SnapshotSection::Rollup, 0, size)) {
+        rollup = string_view(data, static_cast<size_t>(size));
+    }
+
+    if (verify && !(idsInRange(ipIds, rows, ips.size()) && idsInRange(urlIds, rows, urls.size()) &&
+        idsInRange(methodIds, rows, methods.size()) &&
+        (!timestampIds || idsInRange(timestampIds, rows, timestamps.size())))) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SnapshotFile::close() {
+    file.close();
+    rows = 0;
+    epochs = nullptr;
+    statuses = nullptr;
+    methodCodes = nullptr;
+    ipIds = nullptr;
+    urlIds = nullptr;
+    methodIds = nullptr;
+    timestampIds = nullptr;
+    ips = SnapshotDictionary();
+    urls = SnapshotDictionary();
+    methods = SnapshotDictionary();
+    timestamps = SnapshotDictionary();
+    rollup = string_view();
+}
+
+string SnapshotFile::timestamp(size_t row) const {
+    if (timestampIds) {
+        return string(timestamps[timestampIds[row]]);
+    }
+    return TimeUtils::fromEpochSeconds(epochs[row]);
+}
+
+vector<LogEntry> SnapshotFile::toLogEntries() const {
+    vector<LogEntry> logs;
+    logs.reserve(rows);
+    for (size_t row = 0; row < rows; row++) {
+        logs.emplace_back(timestamp(row), string(ip(row)), string(method(row)),
+            string(url(row)), statuses[row]);
+    }
+    return logs;
+}
@@ -0,0 +1,75 @@
+﻿#include "source_export.h"
+#include "windows_utils.h"
+#include <fstream>
+
+using namespace std;
+
+namespace SourceExport {
+
+    bool isRecord(const char* data, size_t size, const RecordSpan& span) {
+        return span.length >= 2 && span.offset <= size && span.length <= size - span.offset &&
+            data[span.offset] == '{' && data[span.offset + span.length - 1] == '}';
+    }
+
+    // Между записями в файле только одна запятая и пробельные символы
+    static bool commaBetween(const char* data, uint64_t begin, uint64_t end) {
+        int commas = 0;
+        for (uint64_t pos = begin; pos < end; pos++) {
+            char c = data[pos];
+            if (c == ',') {
+                commas++;
+            }
+            else if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+                return false;
+            }
+        }
+        return commas == 1;
+    }
+
+    bool writeRecords(const string& filename, const string& sourceFile,
+        const vector<RecordSpan>& spans, const vector<RowId>& rows) {
+        WindowsUtils::MappedFile source;
+        if (!rows.empty() && !source.open(sourceFile)) {
+            return false;
+        }
+        const char* data = source.data();
+        size_t size = source.size();
+
+        // Проверка до записи, чтобы не оставить неполный файл
+        for (RowId row : rows) {
+            if (row >= spans.size() || !isRecord(data, size, spans[row])) {
+                return false;
+            }
+        }
+
+        ofstream out(filename, ios::binary | ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+        out.put('[');
+
+        bool first = true;
+        for (size_t i = 0; i < rows.size(); i++) {
+            uint64_t begin = spans[rows[i]].offset;
+            uint64_t end = begin + spans[rows[i]].length;
+
+            // Продолжение подряд идущими записями
+            while (i + 1 < rows.size() && rows[i + 1] == rows[i] + 1) {
+                const RecordSpan& next = spans[rows[i + 1]];
+                if (next.offset < end || !commaBetween(data, end, next.offset)) {
+                    break;
+                }
+                end = next.offset + next.length;
+                i++;
+            }
+
+            out << (first ? "\n  " : ",\n  ");
+            first = false;
+            out.write(data + begin, static_cast<streamsize>(end - begin));
+        }
+
+        out << (rows.empty() ? "]\n" : "\n]\n");
+        out.close();
+        return !out.fail();
+    }
+}
@@ -0,0 +1,117 @@
+﻿#include "time_utils.h"
+#include <cstdio>
+
+using namespace std;
+
+namespace TimeUtils {
+
+    // Число дней от 1970-01-01 для даты григорианского календаря
+    static int64_t daysFromCivil(int year, int month, int day) {
+        year -= month <= 2;
+        int era = (year >= 0 ? year : year - 399) / 400;
+        int yearOfEra = year - era * 400;
+        int dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return static_cast<int64_t>(era) * 146097 + dayOfEra - 719468;
+    }
+
+    // Разбор числа из фиксированного количества цифр
+    static bool parseDigits(const string& s, size_t pos, size_t count, int& value) {
+        value = 0;
+        for (size_t i = pos; i < pos + count; i++) {
+            if (s[i] < '0' || s[i] > '9') return false;
+            value = value * 10 + (s[i] - '0');
+        }
+        return true;
+    }
+
+    bool isFullTimestamp(const string& timestamp) {
+        return timestamp.size() == 20 &&
+            timestamp[4] == '-' && timestamp[7] == '-' && timestamp[10] == 'T' &&
+            timestamp[13] == ':' && timestamp[16] == ':' && timestamp[19] == 'Z';
+    }
+
+    int64_t toEpochSeconds(const string& timestamp) {
+        if (timestamp.size() < 19) return 0;
+
+        int year, month, day, hour, minute, second;
+        if (!parseDigits(timestamp, 0, 4, year) || !parseDigits(timestamp, 5, 2, month) ||
+            !parseDigits(timestamp, 8, 2, day) || !parseDigits(timestamp, 11, 2, hour) ||
+            !parseDigits(timestamp, 14, 2, minute) || !parseDigits(timestamp, 17, 2, second)) {
+            return 0;
+        }
+
+        return daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    }
+
+    bool boundToEpoch(const string& bound, bool upper, int64_t& epoch) {
+        // Длины неполных форм и разделитель перед следующим полем
+        static const size_t LENGTHS[] = { 4, 7, 10, 13, 16, 19 };
+        static const char SEPARATORS[] = { '-', '-', 'T', ':', ':' };
+
+        size_t size = bound.size();
+        if (size == 20 && bound[19] == 'Z') size = 19;
+        size_t fields = 0;
+        while (fields < 6 && LENGTHS[fields] != size) fields++;
+        if (fields == 6) return false;
+        fields++;
+
+        // Поля: год, месяц, день, час, минута, секунда; недостающие - минимальные
+        int value[6] = { 0, 1, 1, 0, 0, 0 };
+        static const int LIMITS[6][2] = { { 0, 9999 }, { 1, 12 }, { 1, 31 }, { 0, 23 }, { 0, 59 }, { 0, 59 } };
+        for (size_t f = 0; f < fields; f++) {
+            size_t pos = f == 0 ? 0 : LENGTHS[f - 1] + 1;
+            if (f > 0 && bound[pos - 1] != SEPARATORS[f - 1]) return false;
+            if (!parseDigits(bound, pos, f == 0 ? 4 : 2, value[f])) return false;
+            if (value[f] < LIMITS[f][0] || value[f] > LIMITS[f][1]) return false;
+        }
+
+        epoch = daysFromCivil(value[0], value[1], value[2]) * 86400 +
+            value[3] * 3600 + value[4] * 60 + value[5];
+        if (!upper || fields == 6) {
+            return true;
+        }
+
+        // Последняя секунда периода - начало следующего минус одна
+        int64_t next;
+        switch (fields) {
+        case 1: next = daysFromCivil(value[0] + 1, 1, 1) * 86400; break;
+        case 2:
+            next = (value[1] == 12 ? daysFromCivil(value[0] + 1, 1, 1)
+                : daysFromCivil(value[0], value[1] + 1, 1)) * 86400;
+            break;
+        case 3: next = epoch + 86400; break;
+        case 4: next = epoch + 3600; break;
+        default: next = epoch + 60; break;
+        }
+        epoch = next - 1;
+        return true;
+    }
+
+    // Дата григорианского календаря по числу дней от 1970-01-01
+    static void civilFromDays(int64_t days, int& year, int& month, int& day) {
+        days += 719468;
+        int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+        int64_t dayOfEra = days - era * 146097;
+        int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        int64_t mp = (5 * dayOfYear + 2) / 153;
+        day = static_cast<int>(dayOfYear - (153 * mp + 2) / 5 + 1);
+        month = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+        year = static_cast<int>(yearOfEra + era * 400 + (month <= 2));
+    }
+
+    string fromEpochSeconds(int64_t epoch) {
+        int64_t days = epoch >= 0 ? epoch / 86400 : (epoch - 86399) / 86400;
+        int64_t seconds = epoch - days * 86400;
+
+        int year, month, day;
+        civilFromDays(days, year, month, day);
+
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d:%02d:%02dZ",
+            year, month, day, static_cast<int>(seconds / 3600),
+            static_cast<int>(seconds / 60 % 60), static_cast<int>(seconds % 60));
+        return string(buffer);
+    }
+}
@@ -5,6 +5,7 @@
 #include <sstream>
 #include <fstream>
 #include <iomanip>
+#include <algorithm>
 #include <direct.h>
 #include <io.h>
 
@@ -156,6 +157,68 @@ namespace WindowsUtils {
         }
     }
 
+    // Файлы директории по маске (* и ?), полные пути по алфавиту
+    vector<string> listFiles(const string& directory, const string& pattern) {
+        vector<string> files;
+
+        WIN32_FIND_DATAA findData;
+        HANDLE handle = FindFirstFileA(joinPath(directory, pattern).c_str(), &findData);
+        if (handle == INVALID_HANDLE_VALUE) {
+            return files;
+        }
+
+        do {
+            if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+                files.push_back(joinPath(directory, findData.cFileName));
+            }
+        } while (FindNextFileA(handle, &findData));
+
+        FindClose(handle);
+        sort(files.begin(), files.end());
+        return files;
+    }
+
+    bool MappedFile::open(const string& path) {
+        close();
+
+        HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        file = handle;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+            close();
+            return false;
+        }
+
+        mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            close();
+            return false;
+        }
+
+        view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!view) {
+            close();
+            return false;
+        }
+        length = static_cast<size_t>(fileSize.QuadPart);
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (view) UnmapViewOfFile(view);
+        if (mapping) CloseHandle(mapping);
+        if (file) CloseHandle(file);
+        view = nullptr;
+        mapping = nullptr;
+        file = nullptr;
+        length = 0;
+    }
+
     // Настройка консоли
     bool setupConsole() {
         // Устанавливаем UTF-8 кодировку
@@ -0,0 +1,540 @@
+﻿#include <iostream>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <chrono>
+#include <set>
+#include <map>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <iterator>
+#include "log_index.h"
+#include "ngram_index.h"
+#include "path_trie.h"
+#include "cidr_tree.h"
+#include "log_entry.h"
+#include "result_cache.h"
+
+using namespace std;
+using namespace chrono;
+
+// Тестирование сжатого списка записей
+void testPostingList() {
+    cout << "Тестирование PostingList...\n";
+
+    PostingList list;
+    assert(list.empty());
+
+    vector<RowId> rows = { 0, 1, 2, 127, 128, 300, 16384, 2000000, 4000000000U };
+    for (RowId row : rows) {
+        list.add(row);
+    }
+
+    assert(list.size() == rows.size());
+    assert(list.front() == 0);
+    assert(list.back() == 4000000000U);
+    assert(list.decode() == rows);
+
+    // Плотный список занимает ~1 байт на запись
+    PostingList dense;
+    for (RowId i = 0; i < 10000; i++) {
+        dense.add(i * 3);
+    }
+    assert(dense.bytes() < 10000 * 2);
+
+    cout << "✓ Кодирование и распаковка корректны\n";
+    cout << "✓ 10000 записей занимают " << dense.bytes() << " байт\n\n";
+}
+
+// Тестирование склейки списков
+void testPostingListAppend() {
+    cout << "Тестирование склейки PostingList...\n";
+
+    PostingList head, tail, expected;
+    for (RowId i = 0; i < 100; i++) {
+        head.add(i * 2);
+        expected.add(i * 2);
+    }
+    for (RowId i = 500; i < 700; i += 7) {
+        tail.add(i);
+        expected.add(i);
+    }
+
+    head.append(tail);
+    assert(head.size() == expected.size());
+    assert(head.decode() == expected.decode());
+
+    PostingList empty;
+    empty.append(tail);
+    assert(empty.decode() == tail.decode());
+
+    cout << "✓ Склейка списков корректна\n\n";
+}
+
+// Тестирование хэш-индекса (в том числе параллельного построения)
+void testHashIndex() {
+    cout << "Тестирование HashIndex...\n";
+
+    vector<string> ips = { "192.168.1.1", "10.0.0.1", "172.16.0.1", "203.0.113.7" };
+    vector<LogEntry> logs;
+    for (int i = 0; i < 300000; i++) {
+        logs.emplace_back("2025-03-14T08:00:00Z", ips[i % ips.size()], "GET", "/", 200);
+    }
+
+    HashIndex single, parallel;
+
+    auto start = high_resolution_clock::now();
+    single.build(logs, &LogEntry::ip, 1);
+    auto end = high_resolution_clock::now();
+    cout << "✓ Построение в 1 поток: "
+        << duration_cast<milliseconds>(end - start).count() << " мс\n";
+
+    start = high_resolution_clock::now();
+    parallel.build(logs, &LogEntry::ip, 4);
+    end = high_resolution_clock::now();
+    cout << "✓ Построение в 4 потока: "
+        << duration_cast<milliseconds>(end - start).count() << " мс\n";
+
+    assert(single.distinctKeys() == ips.size());
+    assert(parallel.distinctKeys() == ips.size());
+
+    for (const auto& ip : ips) {
+        const PostingList* a = single.find(ip);
+        const PostingList* b = parallel.find(ip);
+        assert(a && b);
+        assert(a->size() == logs.size() / ips.size());
+        assert(a->decode() == b->decode());
+    }
+    assert(single.find("8.8.8.8") == nullptr);
+
+    // Точечный поиск не зависит от объёма данных
+    start = high_resolution_clock::now();
+    const PostingList* hit = parallel.find("10.0.0.1");
+    end = high_resolution_clock::now();
+    assert(hit && hit->front() == 1);
+
+    cout << "✓ Точечный поиск: "
+        << duration_cast<microseconds>(end - start).count() << " мкс\n";
+    cout << "✓ Размер индекса: " << parallel.memoryBytes() << " байт\n\n";
+}
+
+// Сравнение битовой карты с эталонным множеством
+static bool sameAs(const RoaringBitmap& bitmap, const set<uint32_t>& reference) {
+    vector<uint32_t> values = bitmap.toVector();
+    return bitmap.cardinality() == reference.size() &&
+        equal(values.begin(), values.end(), reference.begin());
+}
+
+// Тестирование Roaring-битовых карт
+void testFindSubstring() {
+    cout << "Тестирование поиска подстроки...\n";
+
+    // Сверка с std::string::find на строках разной длины
+    // (в том числе пересекающих границы 16-байтных блоков)
+    mt19937 rng(7);
+    const string alphabet = "ab/.-";
+    for (int iteration = 0; iteration < 20000; iteration++) {
+        string text, pattern;
+        size_t textLength = rng() % 80;
+        size_t patternLength = rng() % 6;
+        for (size_t i = 0; i < textLength; i++) text += alphabet[rng() % alphabet.size()];
+        for (size_t i = 0; i < patternLength; i++) pattern += alphabet[rng() % alphabet.size()];
+
+        assert(findSubstring(text.data(), text.size(), pattern.data(), pattern.size()) ==
+            text.find(pattern));
+    }
+
+    string url = "/static/js/vendor/jquery.min.js?v=3.7.1&cache=../../etc/passwd";
+    assert(containsSubstring(url, "../"));
+    assert(containsSubstring(url, "passwd"));
+    assert(!containsSubstring(url, "/wp-admin"));
+    assert(findSubstring(url.data(), url.size(), "js", 2) == url.find("js"));
+
+    cout << "✓ Результаты совпадают с std::string::find\n\n";
+}
+
+void testNGramIndex() {
+    cout << "Тестирование триграммного индекса...\n";
+
+    vector<string> urls = {
+        "/index.php", "/wp-admin/install.php", "/wp-login.php", "/api/v1/users",
+        "/static/../../etc/passwd", "/images/logo.png", "/admin", "/ab", "/"
+    };
+    vector<LogEntry> logs;
+    for (int i = 0; i < 5000; i++) {
+        string url = urls[i % urls.size()];
+        if (i % 7 == 0) url += "?id=" + to_string(i);
+        logs.emplace_back("2025-03-14T08:00:00Z", "10.0.0.1", "GET", url, 200);
+    }
+
+    HashIndex dictionary;
+    dictionary.build(logs, &LogEntry::url);
+    NGramIndex grams;
+    grams.build(dictionary);
+    assert(grams.termCount() == dictionary.distinctKeys());
+
+    vector<string> patterns = { "/wp-admin", ".php", "../", "id=1", "/a", "p", "", "/nothing", "ng" };
+    for (const auto& pattern : patterns) {
+        size_t expectedRows = 0, expectedTerms = 0;
+        for (const auto& [url, list] : dictionary.entries()) {
+            if (url.find(pattern) != string::npos) {
+                expectedRows += list.size();
+                expectedTerms++;
+            }
+        }
+
+        size_t rows = 0, terms = 0;
+        grams.forEachMatch(pattern, [&](const string& url, const PostingList& list) {
+            assert(url.find(pattern) != string::npos);
+            rows += list.size();
+            terms++;
+        });
+        assert(rows == expectedRows && terms == expectedTerms);
+
+        // Триграммы сужают кандидатов, не теряя совпадений
+        assert(grams.candidates(pattern).size() >= expectedTerms);
+        cout << "  \"" << pattern << "\": " << terms << " URL, " << rows << " записей, кандидатов "
+            << grams.candidates(pattern).size() << "\n";
+    }
+    assert(grams.candidates("/nothing").empty());
+    assert(grams.candidates("/wp-admin").size() < grams.termCount());
+
+    cout << "✓ Триграмм: " << grams.gramCount() << ", размер индекса: "
+        << grams.memoryBytes() << " байт\n\n";
+}
+
+void testPathTrie() {
+    cout << "Тестирование дерева путей...\n";
+
+    vector<string> urls = {
+        "/api/v1/users", "/api/v1/users/42", "/api/v1/products?page=2", "/api/v10/users",
+        "/api/v2/orders", "https://shop.example.com/api/v1/cart", "/static/css/site.css",
+        "/index.html", "/", "/api/v1/"
+    };
+    vector<int> statuses = { 200, 404, 500, 200, 301, 200, 200, 503 };
+    vector<LogEntry> logs;
+    for (int i = 0; i < 20000; i++) {
+        logs.emplace_back("2025-03-14T08:00:00Z", "10.0.0.1", "GET",
+            urls[i % urls.size()], statuses[i % statuses.size()]);
+    }
+
+    PathTrie trie;
+    trie.build(logs);
+
+    // Счётчики префикса совпадают с полным перебором
+    auto under = [](const string& url, const string& prefix) {
+        string path(urlPathView(url));
+        return path == prefix || path.compare(0, prefix.size() + 1, prefix + "/") == 0;
+    };
+    vector<string> prefixes = { "/api", "/api/v1", "/api/v1/users", "/api/v10", "/static", "/missing" };
+    for (const auto& prefix : prefixes) {
+        uint64_t requests = 0, errors = 0;
+        vector<RowId> rows;
+        for (size_t i = 0; i < logs.size(); i++) {
+            if (under(logs[i].url, prefix)) {
+                requests++;
+                if (logs[i].status >= 500) errors++;
+                rows.push_back(static_cast<RowId>(i));
+            }
+        }
+
+        PathTrie::Counts counts = trie.prefixCounts(prefix);
+        assert(counts.requests == requests);
+        assert(counts.statusClasses[5] == errors);
+        assert(trie.rowsUnder(trie.find(prefix)) == rows);
+        cout << "  " << prefix << ": " << requests << " запросов, 5xx: " << errors << "\n";
+    }
+
+    // Варианты записи префикса и граница сегмента
+    assert(trie.find("/api/v1/") == trie.find("api/v1"));
+    assert(trie.find("/api/v") == PathTrie::NONE);
+    assert(trie.prefixCounts("/").requests == logs.size());
+    assert(trie.pathOf(trie.find("/api/v1/users/")) == "/api/v1/users");
+    assert(trie.depthOf(trie.find("/api/v1/users")) == 3);
+
+    // Детализация на один уровень вниз
+    auto children = trie.children("/api");
+    assert(children.size() == 3);
+    assert(children[0].path == "/api/v1");
+    uint64_t sum = 0;
+    for (const auto& child : children) {
+        sum += child.counts.requests;
+    }
+    assert(sum == trie.prefixCounts("/api").requests);
+
+    cout << "✓ Узлов: " << trie.nodeCount() << ", сегментов: " << trie.segmentCount()
+        << ", размер: " << trie.memoryBytes() << " байт\n\n";
+}
+
+void testCIDRTree() {
+    cout << "Тестирование дерева подсетей...\n";
+
+    // Разбор и вывод адресов
+    IPAddress a;
+    assert(parseIPAddress("192.168.1.10", a) && !a.v6 && formatIPAddress(a) == "192.168.1.10");
+    assert(parseIPAddress("2001:DB8::1", a) && a.v6 && formatIPAddress(a) == "2001:db8::1");
+    assert(parseIPAddress("::ffff:10.0.0.1", a) && !a.v6 && formatIPAddress(a) == "10.0.0.1");
+    assert(parseIPAddress("fe80:0:0:1::", a) && formatIPAddress(a) == "fe80:0:0:1::");
+    assert(!parseIPAddress("256.1.1.1", a));
+    assert(!parseIPAddress("1.2.3", a));
+    assert(!parseIPAddress("1::2::3", a));
+    assert(!parseIPAddress("unknown", a));
+
+    CIDR net;
+    assert(parseCIDR("10.1.2.3/16", net) && net.toString() == "10.1.0.0/16");
+    assert(parseCIDR("2001:db8:ff::/32", net) && net.toString() == "2001:db8::/32");
+    assert(parseCIDR("::ffff:192.168.0.0/112", net) && net.toString() == "192.168.0.0/16");
+    assert(parseCIDR("8.8.8.8", net) && net.prefix == 32);
+    assert(!parseCIDR("10.0.0.0/33", net));
+    assert(!parseCIDR("10.0.0.0/", net));
+
+    // Случайные адреса из нескольких сетей
+    mt19937 rng(11);
+    vector<LogEntry> logs;
+    for (int i = 0; i < 50000; i++) {
+        string ip;
+        switch (rng() % 4) {
+        case 0: ip = "10.0." + to_string(rng() % 4) + "." + to_string(rng() % 256); break;
+        case 1: ip = "192.168.1." + to_string(rng() % 16); break;
+        case 2: ip = to_string(rng() % 256) + "." + to_string(rng() % 256) + ".7.1"; break;
+        default: ip = "2001:db8:" + to_string(rng() % 3) + "::" + to_string(rng() % 50); break;
+        }
+        if (i % 1000 == 0) ip = "-";
+        logs.emplace_back("2025-03-14T08:00:00Z", ip, "GET", "/", 200);
+    }
+
+    HashIndex ips;
+    ips.build(logs, &LogEntry::ip);
+    SubnetIndex subnets;
+    subnets.build(ips);
+    assert(subnets.invalidCount() == 1);
+
+    vector<string> networks = { "10.0.0.0/8", "10.0.2.0/24", "192.168.1.8/29", "0.0.0.0/0",
+        "2001:db8::/32", "2001:db8:1::/48", "172.16.0.0/12" };
+    for (const auto& text : networks) {
+        assert(parseCIDR(text, net));
+        vector<RowId> expected;
+        for (size_t i = 0; i < logs.size(); i++) {
+            IPAddress address;
+            if (parseIPAddress(logs[i].ip, address) && net.contains(address)) {
+                expected.push_back(static_cast<RowId>(i));
+            }
+        }
+        assert(subnets.rows(net) == expected);
+        assert(subnets.count(net) == expected.size());
+        cout << "  " << text << ": " << expected.size() << " записей\n";
+    }
+
+    // Топ подсетей /24 совпадает с подсчётом по маскированным адресам
+    map<string, uint64_t> expectedTop;
+    for (const auto& log : logs) {
+        IPAddress address;
+        if (!parseIPAddress(log.ip, address)) continue;
+        CIDR subnet;
+        subnet.network = address.masked(address.v6 ? 48 : 24);
+        subnet.prefix = address.v6 ? 48 : 24;
+        expectedTop[subnet.toString()]++;
+    }
+    auto top = subnets.topSubnets(24, 48, 0);
+    assert(top.size() == expectedTop.size());
+    for (size_t i = 0; i < top.size(); i++) {
+        assert(expectedTop[top[i].first.toString()] == top[i].second);
+        if (i > 0) assert(top[i - 1].second >= top[i].second);
+    }
+    assert(subnets.topSubnets(24, 48, 3).size() == 3);
+
+    // Самый длинный префикс среди именованных диапазонов
+    NamedRanges ranges;
+    assert(ranges.add("10.0.0.0/8", "corp"));
+    assert(ranges.add("10.0.2.0/24", "corp-lab"));
+    assert(ranges.add("2001:db8::/32", "docs-v6"));
+    assert(ranges.add("0.0.0.0/0", "internet"));
+    assert(!ranges.add("bad/8", "x"));
+    assert(*ranges.lookup(string("10.0.2.77")) == "corp-lab");
+    assert(*ranges.lookup(string("10.0.3.1")) == "corp");
+    assert(*ranges.lookup(string("8.8.8.8")) == "internet");
+    assert(*ranges.lookup(string("2001:db8:1::5")) == "docs-v6");
+    assert(ranges.lookup(string("2001:db9::1")) == nullptr);
+    assert(ranges.add("10.0.0.0/8", "corporate") && ranges.size() == 4);
+    assert(*ranges.lookup(string("10.1.1.1")) == "corporate");
+
+    cout << "✓ Подсетей /24 и /48: " << top.size() << ", размер индекса: "
+        << subnets.memoryBytes() << " байт\n\n";
+}
+
+void testTopKCache() {
+    cout << "Тестирование кэша топ-N...\n";
+
+    mt19937 rng(5);
+    map<string, int> counts;
+    auto sortedCounts = [&counts]() {
+        vector<pair<string, int>> sorted(counts.begin(), counts.end());
+        sort(sorted.begin(), sorted.end(),
+            [](const pair<string, int>& a, const pair<string, int>& b) { return a.second > b.second; });
+        return sorted;
+    };
+
+    TopKCache cache, all;
+    for (int i = 0; i < 20000; i++) {
+        // Степенное распределение: несколько частых ключей и длинный хвост
+        string key = "k" + to_string(static_cast<int>(pow(rng() % 1000, 2) / 10000));
+        int count = ++counts[key];
+        cache.update(key, count);
+        all.update(key, count);
+
+        // Кэш заполняется после первых записей и дальше только поправляется
+        if (i == 500) {
+            auto sorted = sortedCounts();
+            all.store(0, sorted);
+            sorted.resize(5);
+            cache.store(5, sorted);
+        }
+
+        if (i > 500 && i % 997 == 0) {
+            auto expected = sortedCounts();
+
+            vector<pair<string, int>> top;
+            assert(cache.get(5, top) && top.size() == 5);
+            assert(cache.get(3, top) && top.size() == 3);
+            assert(!cache.get(6, top));
+            assert(cache.get(5, top));
+            for (size_t j = 0; j < top.size(); j++) {
+                assert(top[j].second == expected[j].second);
+                assert(counts[top[j].first] == top[j].second);
+            }
+            assert(all.get(0, top) && top.size() == counts.size());
+            for (size_t j = 0; j < top.size(); j++) {
+                assert(top[j].second == expected[j].second && counts[top[j].first] == top[j].second);
+            }
+        }
+    }
+
+    cout << "✓ Топ-5 совпадает с пересчётом для " << counts.size() << " ключей\n\n";
+}
+
+// Тестирование кэша результатов
+void testResultCache() {
+    cout << "Тестирование кэша результатов...\n";
+
+    ResultCache cache(64 * 1024);
+    vector<int> numbers(1000, 7);
+    size_t bytes = resultBytes(numbers);
+    assert(bytes >= 4000);
+
+    assert(!cache.find<vector<int>>("numbers", 1));
+    cache.store("numbers", 1, numbers, bytes);
+    auto hit = cache.find<vector<int>>("numbers", 1);
+    assert(hit && *hit == numbers);
+    assert(cache.hits() == 1 && cache.misses() == 1);
+
+    // Тот же ключ с другим типом результата - промах
+    assert(!cache.find<string>("numbers", 1));
+
+    // Новая версия данных сбрасывает все записи, старая не сохраняется
+    assert(!cache.find<vector<int>>("numbers", 2));
+    assert(cache.size() == 0 && cache.memoryBytes() == 0);
+    cache.store("numbers", 1, numbers, bytes);
+    assert(cache.size() == 0);
+
+    // Бюджет: вытесняется давно не использованная запись
+    for (int i = 0; i < 20; i++) {
+        cache.store("n" + to_string(i), 2, numbers, bytes);
+        assert(cache.find<vector<int>>("n0", 2));  // n0 всё время свежая
+    }
+    assert(cache.memoryBytes() <= cache.budgetBytes());
+    assert(cache.evictions() > 0 && cache.size() < 20);
+    assert(cache.find<vector<int>>("n0", 2) && cache.find<vector<int>>("n19", 2));
+    assert(!cache.find<vector<int>>("n1", 2));
+
+    // Результат больше бюджета не кэшируется
+    cache.store("huge", 2, vector<int>(100000), resultBytes(vector<int>(100000)));
+    assert(!cache.find<vector<int>>("huge", 2));
+
+    map<string, int> counts = { { "GET", 10 }, { "POST", 2 } };
+    assert(resultBytes(counts) > 2 * sizeof(string));
+    cache.setBudget(0);
+    assert(cache.size() == 0);
+
+    cout << "✓ Вытеснение LRU и сброс по версии работают\n\n";
+}
+
+void testRoaringBitmap() {
+    cout << "Тестирование RoaringBitmap...\n";
+
+    mt19937 rng(42);
+    set<uint32_t> sparseRef, denseRef;
+    RoaringBitmap sparse, dense;
+
+    // Разреженная карта (массивы) и плотная (битовые блоки)
+    for (int i = 0; i < 3000; i++) {
+        uint32_t v = rng() % 1000000;
+        sparse.add(v);
+        sparseRef.insert(v);
+    }
+    for (uint32_t v = 0; v < 300000; v++) {
+        if (v % 3 != 0) {
+            dense.add(v);
+            denseRef.insert(v);
+        }
+    }
+
+    assert(sameAs(sparse, sparseRef));
+    assert(sameAs(dense, denseRef));
+    assert(dense.contains(1) && !dense.contains(3));
+
+    set<uint32_t> expected;
+    set_intersection(sparseRef.begin(), sparseRef.end(), denseRef.begin(), denseRef.end(),
+        inserter(expected, expected.end()));
+    assert(sameAs(sparse & dense, expected));
+    assert((sparse.andCardinality(dense)) == expected.size());
+
+    expected.clear();
+    set_union(sparseRef.begin(), sparseRef.end(), denseRef.begin(), denseRef.end(),
+        inserter(expected, expected.end()));
+    assert(sameAs(sparse | dense, expected));
+
+    expected.clear();
+    set_difference(denseRef.begin(), denseRef.end(), sparseRef.begin(), sparseRef.end(),
+        inserter(expected, expected.end()));
+    assert(sameAs(dense.andNot(sparse), expected));
+
+    // Дополнение до [0, 300000)
+    RoaringBitmap complement = dense.flip(300000);
+    assert(complement.cardinality() == 100000);
+    assert(complement.contains(0) && complement.contains(299997) && !complement.contains(1));
+    assert((complement | dense) == RoaringBitmap::range(300000));
+
+    cout << "✓ Операции AND/OR/NOT совпадают с std::set\n";
+    cout << "✓ Плотная карта на 200000 записей: " << dense.memoryBytes() << " байт\n\n";
+}
+
+// Главная функция тестирования
+int main() {
+    cout << "========================================\n";
+    cout << "     ТЕСТИРОВАНИЕ ИНДЕКСОВ (Windows)    \n";
+    cout << "========================================\n\n";
+
+    try {
+        testPostingList();
+        testPostingListAppend();
+        testHashIndex();
+        testRoaringBitmap();
+        testFindSubstring();
+        testNGramIndex();
+        testPathTrie();
+        testCIDRTree();
+        testTopKCache();
+        testResultCache();
+
+        cout << "========================================\n";
+        cout << "  ВСЕ ТЕСТЫ УСПЕШНО ПРОЙДЕНЫ! 🎉\n";
+        cout << "========================================\n";
+
+        return 0;
+    }
+    catch (const exception& e) {
+        cerr << "\n✗ ОШИБКА ТЕСТИРОВАНИЯ: " << e.what() << endl;
+        return 1;
+    }
+}